@@ -2,6 +2,8 @@
 #include <petscksp.h>
 #include <Variables.h>
 #include <ApplyWeightMats.h>
+#include <StageThreads.h>
+#include <MultiShift.h>
 
 PetscErrorCode AdjointAction(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight)
 {
@@ -9,36 +11,52 @@ PetscErrorCode AdjointAction(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Wei
 		Computes R' \times \hat{F}, where (.)' indicates complex conjugate transpose
 		For a modified resolvent operator, it computes B' * W_f_sqrt_inv' * R' * W_q_sqrt' * C' \times \hat{F} 
 		In the latter case, the weight and input/output matrices are given as inputs
+		All columns are solved at once, so that MUMPS receives the block as distributed right-hand sides
+		The weights bring Y_hat to the conjugate space before the transpose solve and back after it
+		(see ApplyWeightMats), so no separate conjugation pass over Y_hat is needed
+		With the multi-shift solver, the LU of the central frequency of the window preconditions GMRES
 	*/
 
 	PetscErrorCode        ierr;
-	PetscLogDouble        t1, t2, t3, t4;
+	PetscLogDouble        t1, t2;
+	Mat                   X;
+	PetscInt              nv, hh, mm, ss;
+#if !PETSC_VERSION_GE(3,20,0)
 	Vec                   x;
-	PetscInt              j, hh, mm, ss;
+	PetscInt              j;
+#endif
 
 	PetscFunctionBeginUser;
 
 	ierr = ApplyWeightMats(RSVDM, RSVD, Weight, 0, 1);CHKERRQ(ierr);
 
-	ierr = MatConjugate(RSVDM->Y_hat);CHKERRQ(ierr);
-
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_SOLVE);CHKERRQ(ierr);
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
-	for (j=0; j<RSVD->k; j++) {
-		ierr = PetscTime(&t3);CHKERRQ(ierr);
-		ierr = MatDenseGetColumnVecWrite(RSVDM->Y_hat, j, &x);CHKERRQ(ierr);
-		ierr = KSPSolveTranspose(ksp, x, x);CHKERRQ(ierr);
-		ierr = MatDenseRestoreColumnVecWrite(RSVDM->Y_hat, j, &x);CHKERRQ(ierr);
-		ierr = PetscTime(&t4);CHKERRQ(ierr);
-		hh   = (t4-t3)/3600;
-		mm   = (t4-t3-3600*hh)/60;
-		ss   = t4-t3-3600*hh-mm*60;
-		if (RSVD->Display == 2) ierr = PetscPrintf(PETSC_COMM_WORLD,"Solving LU-decomposed system (adjoint) for mode number %d elapsed time = %02d:%02d:%02d ***\n", (int) j+1, (int)hh, (int)mm, (int)ss);CHKERRQ(ierr); 
+	ierr = MatGetSize(RSVDM->Y_hat,NULL,&nv);CHKERRQ(ierr);
+	if (RSVDM->MS) {
+		ierr = MatDuplicate(RSVDM->Y_hat,MAT_DO_NOT_COPY_VALUES,&X);CHKERRQ(ierr);
+		ierr = MultiShiftMatSolve(RSVDM->MS, RSVD, RSVDM->Y_hat, X, PETSC_TRUE);CHKERRQ(ierr);
+		ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
+		RSVDM->Y_hat = X;
+	} else {
+#if PETSC_VERSION_GE(3,20,0)
+		ierr = MatDuplicate(RSVDM->Y_hat,MAT_DO_NOT_COPY_VALUES,&X);CHKERRQ(ierr);
+		ierr = KSPMatSolveTranspose(ksp, RSVDM->Y_hat, X);CHKERRQ(ierr);
+		ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
+		RSVDM->Y_hat = X;
+#else
+		for (j=0; j<nv; j++) {
+			ierr = MatDenseGetColumnVecWrite(RSVDM->Y_hat, j, &x);CHKERRQ(ierr);
+			ierr = KSPSolveTranspose(ksp, x, x);CHKERRQ(ierr);
+			ierr = MatDenseRestoreColumnVecWrite(RSVDM->Y_hat, j, &x);CHKERRQ(ierr);
+		}
+#endif
 	}
 	ierr = PetscTime(&t2);CHKERRQ(ierr);
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Solving LU-decomposed system (adjoint) for all modes elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Solving LU-decomposed system (adjoint) for all %d modes elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)nv, (int)RSVD->Threads[STAGE_SOLVE], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 	ierr = ApplyWeightMats(RSVDM, RSVD, Weight, 0, 0);CHKERRQ(ierr);
 
 	PetscFunctionReturn(0);
@@ -1,11 +1,62 @@
 
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
+#include <StageThreads.h>
+
+static PetscErrorCode ConjugateScale(Mat Y, Vec w, PetscBool conjw)
+{
+	/*
+		Y <- diag(w) conj(Y), or diag(conj(w)) conj(Y) if conjw (conj(Y) if w is NULL), in a single pass over the local block
+		w is only read, so a weight vector shared between processes is never modified
+	*/
+
+	PetscErrorCode        ierr;
+	PetscScalar          *y;
+	const PetscScalar    *wa;
+	PetscInt              m, n, lda, i, j;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatGetLocalSize(Y,&m,NULL);CHKERRQ(ierr);
+	ierr = MatGetSize(Y,NULL,&n);CHKERRQ(ierr);
+	ierr = MatDenseGetLDA(Y,&lda);CHKERRQ(ierr);
+	ierr = MatDenseGetArray(Y,&y);CHKERRQ(ierr);
+	if (w) {
+		ierr = VecGetArrayRead(w,&wa);CHKERRQ(ierr);
+		if (conjw) {
+			#pragma omp parallel for private(i)
+			for (j=0; j<n; j++) {
+				for (i=0; i<m; i++) y[i+j*lda] = PetscConj(wa[i]*y[i+j*lda]);
+			}
+		} else {
+			#pragma omp parallel for private(i)
+			for (j=0; j<n; j++) {
+				for (i=0; i<m; i++) y[i+j*lda] = wa[i]*PetscConj(y[i+j*lda]);
+			}
+		}
+		ierr = VecRestoreArrayRead(w,&wa);CHKERRQ(ierr);
+	} else {
+		#pragma omp parallel for private(i)
+		for (j=0; j<n; j++) {
+			for (i=0; i<m; i++) y[i+j*lda] = PetscConj(y[i+j*lda]);
+		}
+	}
+	ierr = MatDenseRestoreArray(Y,&y);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
 
 PetscErrorCode ApplyWeightMats(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, PetscBool DirAdj, PetscBool before)
 {
 	/*
 		Applies weight, input and output matrices if defined
+		Diagonal weights (stored as vectors) are applied by scaling the rows of Y_hat in place
+		The adjoint is applied in the conjugate space, since the LU factors only give transpose solves:
+		before the solve, Y_hat <- conj(C' W_q_sqrt' Y_hat) = C^T W_q_sqrt^T conj(Y_hat), and after it,
+		Y_hat <- conj(W_f_sqrt_inv^T B^T Y_hat) = W_f_sqrt_inv' B' conj(Y_hat), with (.)' the conjugate transpose
+		Each conjugation is fused with the scaling by a diagonal weight (a single pass over Y_hat), and
+		the transposes are applied by MatTransposeMatMult without transposing the matrices
 	*/
 
 	PetscErrorCode        ierr=0;
@@ -13,9 +64,13 @@ PetscErrorCode ApplyWeightMats(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_mat
 
 	PetscFunctionBeginUser;
 
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_DENSE);CHKERRQ(ierr);
+
 	if (DirAdj) { // direct 
 		if (before) { // forcing 
-			if (Weight->InvInputWeightFlg)  {
+			if (Weight->InvInputWeightFlg && Weight->w_f_sqrt_inv) {
+				ierr = MatDiagonalScale(RSVDM->Y_hat,Weight->w_f_sqrt_inv,NULL);CHKERRQ(ierr);
+			} else if (Weight->InvInputWeightFlg)  {
 				ierr = MatMatMult(Weight->W_f_sqrt_inv,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
 				ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
 				ierr = MatDestroy(&Y);CHKERRQ(ierr);
@@ -33,44 +88,46 @@ PetscErrorCode ApplyWeightMats(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_mat
 				ierr = MatDuplicate(Y,MAT_COPY_VALUES,&RSVDM->Y_hat);CHKERRQ(ierr);
 				ierr = MatDestroy(&Y);CHKERRQ(ierr);
 			}
-			if (Weight->OutputWeightFlg) {
+			if (Weight->OutputWeightFlg && Weight->w_q_sqrt) {
+				ierr = MatDiagonalScale(RSVDM->Y_hat,Weight->w_q_sqrt,NULL);CHKERRQ(ierr);
+			} else if (Weight->OutputWeightFlg) {
 				ierr = MatMatMult(Weight->W_q_sqrt,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
 				ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
 				ierr = MatDestroy(&Y);CHKERRQ(ierr);
 			}		
 		}
-	} else { // adjoint
+	} else { // adjoint, in the conjugate space (see above)
 		if (before) { // forcing
-			if (Weight->OutputWeightFlg) {
-				ierr = MatHermitianTranspose(Weight->W_q_sqrt, MAT_INPLACE_MATRIX, &Weight->W_q_sqrt);CHKERRQ(ierr);
-				ierr = MatMatMult(Weight->W_q_sqrt,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
-				ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
-				ierr = MatDestroy(&Y);CHKERRQ(ierr);
-				ierr = MatHermitianTranspose(Weight->W_q_sqrt, MAT_INPLACE_MATRIX, &Weight->W_q_sqrt);CHKERRQ(ierr);
+			if (Weight->OutputWeightFlg && Weight->w_q_sqrt) {
+				ierr = ConjugateScale(RSVDM->Y_hat,Weight->w_q_sqrt,PETSC_FALSE);CHKERRQ(ierr);
+			} else {
+				ierr = ConjugateScale(RSVDM->Y_hat,NULL,PETSC_FALSE);CHKERRQ(ierr);
+				if (Weight->OutputWeightFlg) {
+					ierr = MatTransposeMatMult(Weight->W_q_sqrt,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
+					ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+					ierr = MatDestroy(&Y);CHKERRQ(ierr);
+				}
 			}
 			if (Weight->OutputMatrixFlg) {
-				ierr = MatHermitianTranspose(Weight->C, MAT_INPLACE_MATRIX, &Weight->C);CHKERRQ(ierr);
-				ierr = MatMatMult(Weight->C,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
-				ierr = MatHermitianTranspose(Weight->C, MAT_INPLACE_MATRIX, &Weight->C);CHKERRQ(ierr);
+				ierr = MatTransposeMatMult(Weight->C,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
 				ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
-				ierr = MatDuplicate(Y,MAT_COPY_VALUES,&RSVDM->Y_hat);CHKERRQ(ierr);
-				ierr = MatDestroy(&Y);CHKERRQ(ierr);
+				RSVDM->Y_hat = Y;
 			}
 		} else { // response
 			if (Weight->InputMatrixFlg)  {
-				ierr = MatHermitianTranspose(Weight->B, MAT_INPLACE_MATRIX, &Weight->B);CHKERRQ(ierr);
-				ierr = MatMatMult(Weight->B,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
-				ierr = MatHermitianTranspose(Weight->B, MAT_INPLACE_MATRIX, &Weight->B);CHKERRQ(ierr);
+				ierr = MatTransposeMatMult(Weight->B,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
 				ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
-				ierr = MatDuplicate(Y,MAT_COPY_VALUES,&RSVDM->Y_hat);CHKERRQ(ierr);
-				ierr = MatDestroy(&Y);CHKERRQ(ierr);
+				RSVDM->Y_hat = Y;
 			}
-			if (Weight->InvInputWeightFlg)  {
-				ierr = MatHermitianTranspose(Weight->W_f_sqrt_inv, MAT_INPLACE_MATRIX, &Weight->W_f_sqrt_inv);CHKERRQ(ierr);
-				ierr = MatMatMult(Weight->W_f_sqrt_inv,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
-				ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
-				ierr = MatDestroy(&Y);CHKERRQ(ierr);	
-				ierr = MatHermitianTranspose(Weight->W_f_sqrt_inv, MAT_INPLACE_MATRIX, &Weight->W_f_sqrt_inv);CHKERRQ(ierr);
+			if (Weight->InvInputWeightFlg && Weight->w_f_sqrt_inv) {
+				ierr = ConjugateScale(RSVDM->Y_hat,Weight->w_f_sqrt_inv,PETSC_TRUE);CHKERRQ(ierr);
+			} else {
+				if (Weight->InvInputWeightFlg)  {
+					ierr = MatTransposeMatMult(Weight->W_f_sqrt_inv,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
+					ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+					ierr = MatDestroy(&Y);CHKERRQ(ierr);
+				}
+				ierr = ConjugateScale(RSVDM->Y_hat,NULL,PETSC_FALSE);CHKERRQ(ierr);
 			}
 		}
 	}
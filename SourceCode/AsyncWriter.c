@@ -0,0 +1,347 @@
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <petscksp.h>
+#include <Variables.h>
+
+#define MODE_FILE_CLASSID 1211290                         /* reduced-precision/compressed modes */
+
+/*
+	Background writer for the dense resolvent modes
+
+	Every rank copies its own rows of a finished N x k matrix into a bounded queue and returns
+	immediately; a POSIX thread per rank then writes them with pwrite() directly at their offset
+	in the PETSc binary file (native dense format, readable with MatLoad or PetscBinaryRead),
+	optionally in single precision, lossy-compressed and/or truncated to the leading modes.
+	The thread never calls MPI or PETSc, hence the plain malloc/free for its buffers.
+*/
+
+typedef struct _AsyncJob {
+	char                  filename[PETSC_MAX_PATH_LEN];   /* output file */
+	char                 *buf;                            /* local rows (row-major, big-endian) */
+	size_t                nbytes;                         /* size of the local rows in bytes */
+	off_t                 offset;                         /* file offset of the local rows */
+	char                 *hbuf;                           /* file header, written at offset 0 (first rank only) */
+	size_t                hbytes;                         /* size of the file header in bytes */
+	struct _AsyncJob     *next;
+} AsyncJob;
+
+struct _p_AsyncWriter {
+	pthread_t             thread;
+	pthread_mutex_t       lock;
+	pthread_cond_t        cond;
+	AsyncJob             *head, *tail;                    /* pending jobs */
+	PetscInt              npending;                       /* number of pending jobs */
+	PetscInt              maxpending;                     /* max number of buffered jobs (bounded memory) */
+	PetscInt              nwritten;                       /* number of completed jobs */
+	PetscInt              nfailed;                        /* number of failed jobs */
+	int                   lasterrno;                      /* errno of the last failure */
+	PetscBool             done;                           /* stops the thread once the queue is empty */
+	PetscInt              nfiles;                         /* files to verify (first rank) */
+	PetscInt              maxfiles;
+	char                (*files)[PETSC_MAX_PATH_LEN];
+	off_t                *sizes;
+};
+
+static void SwapBytes(char *p, size_t n, size_t size)
+{
+	/*
+		PETSc binary files are big-endian
+	*/
+
+#if !defined(PETSC_WORDS_BIGENDIAN)
+	size_t                i, j;
+	char                  c;
+
+	for (i=0; i<n; i++, p+=size) {
+		for (j=0; j<size/2; j++) {
+			c = p[j]; p[j] = p[size-1-j]; p[size-1-j] = c;
+		}
+	}
+#endif
+
+}
+
+static int WriteAll(int fd, const char *buf, size_t nbytes, off_t offset)
+{
+	ssize_t               n;
+
+	while (nbytes > 0) {
+		n = pwrite(fd, buf, nbytes, offset);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) return n < 0 ? errno : EIO;
+		buf    += n;
+		nbytes -= n;
+		offset += n;
+	}
+	return 0;
+
+}
+
+static void *WriterLoop(void *ctx)
+{
+	struct _p_AsyncWriter *w = (struct _p_AsyncWriter*) ctx;
+	AsyncJob              *job;
+	int                    fd, err;
+
+	for (;;) {
+		pthread_mutex_lock(&w->lock);
+		while (!w->head && !w->done) pthread_cond_wait(&w->cond,&w->lock);
+		if (!w->head) {
+			pthread_mutex_unlock(&w->lock);
+			break;
+		}
+		job = w->head;
+		pthread_mutex_unlock(&w->lock);
+
+		err = 0;
+		fd  = open(job->filename, O_WRONLY | O_CREAT, 0644);
+		if (fd < 0) err = errno;
+		if (!err && job->hbuf) err = WriteAll(fd, job->hbuf, job->hbytes, 0);
+		if (!err && job->nbytes) err = WriteAll(fd, job->buf, job->nbytes, job->offset);
+		if (fd >= 0 && close(fd) && !err) err = errno;
+
+		pthread_mutex_lock(&w->lock);
+		w->head = job->next;
+		if (!w->head) w->tail = NULL;
+		w->npending--;
+		w->nwritten++;
+		if (err) {
+			w->nfailed++;
+			w->lasterrno = err;
+		}
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		free(job->hbuf);
+		free(job->buf);
+		free(job);
+	}
+	return NULL;
+
+}
+
+PetscErrorCode AsyncWriterCreate(PetscInt maxpending, AsyncWriter *writer)
+{
+	/*
+		Creates the queue and starts the writer thread
+	*/
+
+	PetscErrorCode        ierr;
+	AsyncWriter           w;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscNew(&w);CHKERRQ(ierr);
+	w->maxpending = PetscMax(maxpending,1);
+	pthread_mutex_init(&w->lock,NULL);
+	pthread_cond_init(&w->cond,NULL);
+	if (pthread_create(&w->thread,NULL,WriterLoop,w)) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_LIB,"Unable to start the background writer thread");
+	*writer = w;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode AsyncWriterPush(AsyncWriter w, RSVD_vars *RSVD, Mat M, const char *filename)
+{
+	/*
+		Copies the leading SaveModesNum columns of the local rows of a dense matrix into the queue
+		(blocks while the queue is full); the matrix can be destroyed or overwritten as soon as this returns
+		Output formats (row-major, big-endian):
+		- double precision: PETSc native dense format {MAT_FILE_CLASSID, N, r, -1}, N x r scalars
+		- single precision: {MODE_FILE_CLASSID, N, r, 0}, N x r scalars stored as floats
+		- lossy compression: {MODE_FILE_CLASSID, N, r, b}, r per-mode scales (double), N x r scalars
+		  stored as b-bit integers q, with x = scale * q / (2^(b-1) - 1)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              Mg, Ng, r, rstart, rend, lda, i, j, l, nc, b;
+	PetscMPIInt           rank;
+	PetscInt              hdr[4];
+	size_t                es;
+	const PetscScalar    *a;
+	const PetscReal      *x;
+	PetscReal            *scale = NULL, Q = 0, v;
+	double                s;
+	float                 f;
+	char                 *p;
+	AsyncJob             *job;
+	char                (*files)[PETSC_MAX_PATH_LEN];
+	off_t                *sizes;
+
+	PetscFunctionBeginUser;
+
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
+	ierr = MatGetSize(M,&Mg,&Ng);CHKERRQ(ierr);
+	ierr = MatGetOwnershipRange(M,&rstart,&rend);CHKERRQ(ierr);
+	ierr = MatDenseGetLDA(M,&lda);CHKERRQ(ierr);
+	r    = PetscMin(RSVD->SaveModesNum,Ng);
+	nc   = sizeof(PetscScalar)/sizeof(PetscReal);
+	b    = RSVD->CompressBits;
+	es   = b ? (size_t)b/8 : (RSVD->SinglePrec ? sizeof(float) : sizeof(PetscReal));
+
+	/*
+		Per-mode scales for the lossy compression (max |x| over all ranks)
+	*/
+
+	if (b) {
+		ierr = PetscMalloc1(Ng,&scale);CHKERRQ(ierr);
+		ierr = MatGetColumnNorms(M,NORM_INFINITY,scale);CHKERRQ(ierr);
+		Q    = (PetscReal)(((PetscInt64)1 << (b-1)) - 1);
+	}
+
+	pthread_mutex_lock(&w->lock);
+	while (w->npending >= w->maxpending) pthread_cond_wait(&w->cond,&w->lock);
+	pthread_mutex_unlock(&w->lock);
+
+	job = (AsyncJob*) calloc(1,sizeof(AsyncJob));
+	if (!job) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_MEM,"Unable to allocate the output buffer");
+	job->hbytes = 4*sizeof(PetscInt) + (b ? r*sizeof(double) : 0);
+	job->nbytes = (size_t)(rend-rstart)*r*nc*es;
+	job->offset = (off_t)job->hbytes + (off_t)rstart*r*nc*es;
+	job->buf    = (char*) malloc(job->nbytes ? job->nbytes : 1);
+	if (!job->buf) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_MEM,"Unable to allocate the output buffer");
+	ierr = PetscStrncpy(job->filename,filename,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+
+	/*
+		Column-major local block --> row-major, converted, big-endian
+	*/
+
+	ierr = MatDenseGetArrayRead(M,&a);CHKERRQ(ierr);
+	p = job->buf;
+	for (i=0; i<rend-rstart; i++) {
+		for (j=0; j<r; j++) {
+			x = (const PetscReal*) &a[i+j*lda];
+			for (l=0; l<nc; l++, p+=es) {
+				if (b) {
+					v = scale[j] > 0 ? PetscFloorReal(x[l]/scale[j]*Q + 0.5) : 0;
+					if (b == 8)       *(int8_t*)  p = (int8_t)  v;
+					else if (b == 16) *(int16_t*) p = (int16_t) v;
+					else              *(int32_t*) p = (int32_t) v;
+				} else if (RSVD->SinglePrec) {
+					f = (float) x[l];
+					memcpy(p,&f,es);
+				} else {
+					memcpy(p,&x[l],es);
+				}
+			}
+		}
+	}
+	ierr = MatDenseRestoreArrayRead(M,&a);CHKERRQ(ierr);
+	SwapBytes(job->buf, job->nbytes/es, es);
+
+	if (!rank) {
+		job->hbuf   = (char*) malloc(job->hbytes);
+		if (!job->hbuf) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_MEM,"Unable to allocate the output buffer");
+		hdr[0] = (b || RSVD->SinglePrec) ? MODE_FILE_CLASSID : MAT_FILE_CLASSID;
+		hdr[1] = Mg;
+		hdr[2] = r;
+		hdr[3] = b ? b : (RSVD->SinglePrec ? 0 : -1);      /* -1: MATRIX_BINARY_FORMAT_DENSE */
+		SwapBytes((char*) hdr, 4, sizeof(PetscInt));
+		memcpy(job->hbuf,hdr,sizeof(hdr));
+		for (j=0; j<(b ? r : 0); j++) {
+			s = (double) scale[j];
+			SwapBytes((char*) &s, 1, sizeof(double));
+			memcpy(job->hbuf+sizeof(hdr)+j*sizeof(double),&s,sizeof(double));
+		}
+		if (w->nfiles == w->maxfiles) {
+			w->maxfiles = PetscMax(2*w->maxfiles,16);
+			ierr = PetscMalloc2(w->maxfiles,&files,w->maxfiles,&sizes);CHKERRQ(ierr);
+			ierr = PetscArraycpy(files,w->files,w->nfiles);CHKERRQ(ierr);
+			ierr = PetscArraycpy(sizes,w->sizes,w->nfiles);CHKERRQ(ierr);
+			ierr = PetscFree2(w->files,w->sizes);CHKERRQ(ierr);
+			w->files = files;
+			w->sizes = sizes;
+		}
+		ierr = PetscStrncpy(w->files[w->nfiles],filename,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+		w->sizes[w->nfiles++] = (off_t)job->hbytes + (off_t)Mg*r*nc*es;
+	}
+	ierr = PetscFree(scale);CHKERRQ(ierr);
+
+	pthread_mutex_lock(&w->lock);
+	if (w->tail) w->tail->next = job;
+	else         w->head = job;
+	w->tail = job;
+	w->npending++;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode AsyncWriterFlush(AsyncWriter w, PetscInt *nfiles)
+{
+	/*
+		Waits for all pending writes, then verifies them on every rank and checks the file sizes
+		Returns the number of files verified since the last flush (on the first rank)
+	*/
+
+	PetscErrorCode        ierr=0;
+	PetscInt              nfailed, nbad = 0, i;
+	PetscMPIInt           rank;
+	int                   lasterrno;
+	struct stat           st;
+
+	PetscFunctionBeginUser;
+
+	pthread_mutex_lock(&w->lock);
+	while (w->npending > 0) pthread_cond_wait(&w->cond,&w->lock);
+	nfailed   = w->nfailed;
+	lasterrno = w->lasterrno;
+	pthread_mutex_unlock(&w->lock);
+
+	if (nfailed) ierr = PetscSynchronizedPrintf(PETSC_COMM_WORLD,"[%d] Background writer: %d failed writes (%s)\n",
+		(int)PetscGlobalRank,(int)nfailed,strerror(lasterrno));CHKERRQ(ierr);
+	ierr = PetscSynchronizedFlush(PETSC_COMM_WORLD,PETSC_STDOUT);CHKERRQ(ierr);
+	ierr = MPI_Allreduce(MPI_IN_PLACE,&nfailed,1,MPIU_INT,MPI_SUM,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	if (nfailed) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_WRITE,"Background writer failed to write %d blocks of resolvent modes",(int)nfailed);
+
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
+	if (!rank) {
+		for (i=0; i<w->nfiles; i++) {
+			if (stat(w->files[i],&st) || st.st_size != w->sizes[i]) {
+				ierr = PetscPrintf(PETSC_COMM_SELF,"Incomplete output file: %s\n",w->files[i]);CHKERRQ(ierr);
+				nbad++;
+			}
+		}
+	}
+	ierr = MPI_Bcast(&nbad,1,MPIU_INT,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	if (nbad) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_WRITE,"%d output files of resolvent modes are incomplete",(int)nbad);
+	if (nfiles) *nfiles = w->nfiles;
+	w->nfiles = 0;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode AsyncWriterDestroy(AsyncWriter *writer)
+{
+	/*
+		Stops the writer thread (after the queue is drained) and frees the queue
+	*/
+
+	PetscErrorCode        ierr;
+	AsyncWriter           w = *writer;
+
+	PetscFunctionBeginUser;
+
+	if (!w) PetscFunctionReturn(0);
+	pthread_mutex_lock(&w->lock);
+	w->done = PETSC_TRUE;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread,NULL);
+	pthread_mutex_destroy(&w->lock);
+	pthread_cond_destroy(&w->cond);
+	ierr = PetscFree2(w->files,w->sizes);CHKERRQ(ierr);
+	ierr = PetscFree(*writer);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
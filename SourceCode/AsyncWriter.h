@@ -0,0 +1,10 @@
+
+#ifndef ASYNCWRITER_H
+#define ASYNCWRITER_H
+
+PetscErrorCode AsyncWriterCreate(PetscInt, AsyncWriter*);
+PetscErrorCode AsyncWriterPush(AsyncWriter, RSVD_vars*, Mat, const char*);
+PetscErrorCode AsyncWriterFlush(AsyncWriter, PetscInt*);
+PetscErrorCode AsyncWriterDestroy(AsyncWriter*);
+
+#endif
\ No newline at end of file
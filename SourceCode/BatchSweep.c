@@ -0,0 +1,153 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <LoadOperator.h>
+#include <ReadWeightMats.h>
+#include <AsyncWriter.h>
+#include <RSVDLU.h>
+#include <SharedMats.h>
+
+PetscErrorCode BatchSweep(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs)
+{
+	/*
+		Batch mode for many small operators (e.g., one per spanwise wavenumber), each with a full frequency sweep
+		The ranks are split into groups of BatchGroupSize ranks, and the NumOps x Nw (operator, frequency) tasks
+		in operator-major order are shared out in contiguous chunks, so that a group reloads its operator and
+		redoes the symbolic factorization only when the operator changes
+		Every module works on PETSC_COMM_WORLD, which is set to the group communicator during the sweep and
+		restored afterwards; groups of one rank thus use sequential matrices and LU without any communication
+		(dense LAPACK LU for N <= BatchDenseMaxN, sequential MUMPS otherwise)
+		The results are indexed as in a parametric sweep, i.e., Operator<iop+1>/S_hat_iw<iw+1>_allK, ...
+		Only the first group prints its progress
+		With BatchShared (groups of one rank), the operators and the weight matrices are placed once per node
+		in shared memory and only the shifted operator and its factors are private to the group
+	*/
+
+	PetscErrorCode        ierr;
+	MPI_Comm              world, group;
+	PetscMPIInt           rank, size, gsize;
+	PetscInt              ngroups, color, ntasks, start, end, it, iop, iw, iop_cur = -1, ic, Display;
+	PetscReal             t, tmin, tmax;
+	PetscLogDouble        t1, t2;
+	char                  FolderDir[PETSC_MAX_PATH_LEN];
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+
+	world   = PETSC_COMM_WORLD;
+	ierr    = MPI_Comm_rank(world,&rank);CHKERRMPI(ierr);
+	ierr    = MPI_Comm_size(world,&size);CHKERRMPI(ierr);
+	ngroups = (size + RSVD->Batch.GroupSize - 1)/RSVD->Batch.GroupSize;
+	color   = rank/RSVD->Batch.GroupSize;
+	ntasks  = RSVD->NumOps*RSVD->Nw;
+	start   = color*ntasks/ngroups;
+	end     = (color+1)*ntasks/ngroups;
+
+	ierr = PetscPrintf(world,"Batch mode: %d tasks (%d operators x %d frequencies) on %d groups of %d ranks\n\n",
+			(int)ntasks, (int)RSVD->NumOps, (int)RSVD->Nw, (int)ngroups, (int)PetscMin(RSVD->Batch.GroupSize,size));CHKERRQ(ierr);
+
+	/*
+		Creates the folders of every operator (and configuration) before the split
+	*/
+
+	if ((int)rank == 0) {
+		for (iop=0; iop<RSVD->NumOps; iop++) {
+			ierr = PetscStrncpy(FolderDir,dirs->MainFolderDir,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+			if (RSVD->NumOps > 1) {
+				ierr = PetscSNPrintf(FolderDir,PETSC_MAX_PATH_LEN,"%sOperator%d/",dirs->MainFolderDir,(int)iop+1);CHKERRQ(ierr);
+				ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"mkdir %s",FolderDir);CHKERRQ(ierr);
+				ierr = system(dirs->IO_dir);CHKERRQ(ierr);
+			}
+			for (ic=0; ic<RSVD->NumConfigs && RSVD->NumConfigs > 1; ic++) {
+				ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"mkdir %s%s/",FolderDir,dirs->ConfigList[ic]);CHKERRQ(ierr);
+				ierr = system(dirs->IO_dir);CHKERRQ(ierr);
+			}
+		}
+	}
+	ierr = MPI_Barrier(world);CHKERRMPI(ierr);
+
+	/*
+		Runs the tasks of this group on the group communicator
+	*/
+
+	ierr = MPI_Comm_split(world,(int)color,(int)rank,&group);CHKERRMPI(ierr);
+	ierr = MPI_Comm_size(group,&gsize);CHKERRMPI(ierr);
+	PETSC_COMM_WORLD = group;
+	Display          = RSVD->Display;
+	if (color > 0) RSVD->Display = 0;
+	RSVD->N          = 0;
+
+	/*
+		Shared mode: the operators of the node and the weight matrices are placed once in shared memory
+	*/
+
+	if (RSVD->Batch.Shared) {
+		ierr = SharedMatsCreate(world, RSVD, Weight, dirs, start/RSVD->Nw, end > start ? (end-1)/RSVD->Nw : -1, &RSVDM->Shared);CHKERRQ(ierr);
+	}
+
+	for (it=start; it<end; it++) {
+
+		iop = it/RSVD->Nw;
+		iw  = it%RSVD->Nw;
+
+		if (iop != iop_cur) {
+
+			/*
+				New operator (any nonzero pattern): the factorization of the previous one is discarded
+				The weight matrices are read once, with the first operator of the group
+			*/
+
+			ierr = KSPDestroy(&RSVDM->ksp);CHKERRQ(ierr);
+			ierr = MatDestroy(&RSVDM->A);CHKERRQ(ierr);
+			ierr = LoadOperator(RSVDM, RSVD, dirs, iop);CHKERRQ(ierr);
+			if (gsize == 1 && RSVD->N <= RSVD->Batch.DenseMaxN) {
+				ierr = MatConvert(RSVDM->A_org,MATSEQDENSE,MAT_INPLACE_MATRIX,&RSVDM->A_org);CHKERRQ(ierr);
+			}
+			if (iop_cur < 0) {
+				for (ic=0; ic<RSVD->NumConfigs; ic++) {
+					if (RSVDM->Shared) {
+						ierr = SharedMatsGetWeights(RSVDM->Shared, RSVD, &Weight[ic], ic);CHKERRQ(ierr);
+					} else {
+						ierr = ReadWeightMats(RSVD, &Weight[ic], dirs);CHKERRQ(ierr);
+					}
+				}
+			}
+			iop_cur = iop;
+		}
+
+		ierr = RSVDLU(RSVDM, RSVD, Weight, Res, dirs, iw);CHKERRQ(ierr);
+
+	}
+
+	/*
+		Waits for the background writer of this group, then destroys the objects of the group communicator
+	*/
+
+	if (Res->Writer && RSVD->AsyncIO) ierr = AsyncWriterFlush(Res->Writer, NULL);CHKERRQ(ierr);
+	ierr = KSPDestroy(&RSVDM->ksp);CHKERRQ(ierr);
+	ierr = MatDestroy(&RSVDM->A);CHKERRQ(ierr);
+	ierr = MatDestroy(&RSVDM->A_org);CHKERRQ(ierr);
+	ierr = VecDestroy(&RSVDM->Diag);CHKERRQ(ierr);
+	for (ic=0; ic<RSVD->NumConfigs && iop_cur >= 0; ic++) {
+		ierr = DestroyWeightMats(&Weight[ic]);CHKERRQ(ierr);
+	}
+	ierr = SharedMatsDestroy(&RSVDM->Shared);CHKERRQ(ierr);
+
+	PETSC_COMM_WORLD = world;
+	ierr = MPI_Comm_free(&group);CHKERRMPI(ierr);
+	RSVD->Display    = Display;
+
+	/*
+		Prints out the elapsed time of the fastest and slowest groups
+	*/
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	t    = t2 - t1;
+	ierr = MPI_Allreduce(&t,&tmin,1,MPIU_REAL,MPIU_MIN,world);CHKERRMPI(ierr);
+	ierr = MPI_Allreduce(&t,&tmax,1,MPIU_REAL,MPIU_MAX,world);CHKERRMPI(ierr);
+	ierr = PetscPrintf(world,"Batch mode: elapsed time per group min = %g s, max = %g s\n\n", tmin, tmax);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
@@ -0,0 +1,7 @@
+
+#ifndef BATCHSWEEP_H
+#define BATCHSWEEP_H
+
+PetscErrorCode BatchSweep(RSVD_matrices*, RSVD_vars*, Weight_matrices*, Resolvent_matrices*, Directories*);
+
+#endif
\ No newline at end of file
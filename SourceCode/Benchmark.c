@@ -0,0 +1,214 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <FactorOperator.h>
+#include <CreateRandomMat.h>
+#include <DirectAction.h>
+#include <AdjointAction.h>
+#include <ApplyWeightMats.h>
+#include <QRDecomposition.h>
+#include <SVD4Response.h>
+#include <SVD4Forcing.h>
+#include <WriteMat.h>
+#include <AsyncWriter.h>
+#include <PowerIteration.h>
+#include <ExactResolvent.h>
+
+#define NUM_BENCH 8
+
+static PetscErrorCode BenchGains(PetscInt iw, PetscReal w, Vec S, void *ctx)
+{
+	/*
+		Copies the k gains of the check (distributed vector S) to the array ctx on every rank
+	*/
+
+	PetscErrorCode        ierr;
+	PetscReal            *gains = (PetscReal*)ctx;
+	PetscInt              i, n;
+	const PetscScalar    *s;
+	Vec                   S_all;
+	VecScatter            scat;
+
+	PetscFunctionBeginUser;
+
+	ierr = VecScatterCreateToAll(S,&scat,&S_all);CHKERRQ(ierr);
+	ierr = VecScatterBegin(scat,S,S_all,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecScatterEnd(scat,S,S_all,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecGetSize(S_all,&n);CHKERRQ(ierr);
+	ierr = VecGetArrayRead(S_all,&s);CHKERRQ(ierr);
+	for (i=0; i<n; i++) gains[i] = PetscRealPart(s[i]);
+	ierr = VecRestoreArrayRead(S_all,&s);CHKERRQ(ierr);
+	ierr = VecScatterDestroy(&scat);CHKERRQ(ierr);
+	ierr = VecDestroy(&S_all);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode Benchmark(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs)
+{
+	/*
+		Times every stage of the RSVD-LU pipeline at the first frequency and configuration, BenchReps times
+		The stages run in the order of RSVDLU() on a random sketch: LU factorization, first action,
+		QR, SVD of the sketch, second action, saving a block of k modes and the final SVD; the weight/input/output
+		matrices are timed again on their own, a subset of the two actions that include them (not additive)
+		Nothing but the timed block of modes is written (the gains are kept in memory)
+		The min/mean/max time of each stage over the repetitions (max over the ranks) is appended to
+		BenchCSV, one row per stage with the process and thread counts, so that the rows of several runs
+		(e.g., mpiexec -n 1, 2, 4, ... for strong scaling, or growing BenchGrid for weak scaling) can be plotted
+		For N <= BenchExactMaxN, the leading min(SaveModesNum, k, Nb, Nc) gains of the randomized algorithm
+		(with q power iterations) are checked against the exact resolvent (dense SVD of R) with the factors of
+		the last repetition, and their max relative error is added to every row (-1 if not checked)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              ir, is, ik, nc, rounds, SaveModesOpt;
+	PetscMPIInt           np;
+	PetscReal             w, err = -1, change, *gains, *gains_exact;
+	PetscReal             tmin[NUM_BENCH], tmax[NUM_BENCH], tsum[NUM_BENCH], t;
+	PetscLogDouble        t1, t2;
+	PetscBool             exists, DirAdj, InMemory;
+	FILE                 *fp;
+	KSP                   ksp = NULL;
+	PetscErrorCode      (*GainsFn)(PetscInt, PetscReal, Vec, void*);
+	void                 *MonitorCtx;
+	const char           *stages[NUM_BENCH] = {"LU", "FirstAction", "QRDecomposition", "SVD4Response", "SecondAction", "ApplyWeightMats_subset", "IO", "SVD4Forcing"};
+
+	PetscFunctionBeginUser;
+
+	ierr = MPI_Comm_size(PETSC_COMM_WORLD,&np);CHKERRMPI(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*******************************************\n"
+			"**************** Benchmark ****************\n*******************************************\n\n");CHKERRQ(ierr);
+
+	w                  = RSVD->w_min;
+	RSVD->Nb           = Weight[0].Nb;
+	RSVD->Nc           = Weight[0].Nc;
+	RSVD->AdjointFirst = Weight[0].AdjointFirst;
+	DirAdj             = (PetscBool) !RSVD->AdjointFirst;
+	SaveModesOpt       = RSVD->SaveModesOpt;
+	InMemory           = RSVD->InMemory;
+	RSVD->SaveModesOpt = 0;
+	RSVD->InMemory     = PETSC_TRUE;
+	for (is=0; is<NUM_BENCH; is++) {
+		tmin[is] = PETSC_MAX_REAL;
+		tmax[is] = 0;
+		tsum[is] = 0;
+	}
+
+	for (ir=0; ir<RSVD->Bench.Reps; ir++) {
+
+		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n******** Benchmark repetition %d/%d *******\n\n",(int)ir+1,(int)RSVD->Bench.Reps);CHKERRQ(ierr);
+		ierr = CreateRandomMat(RSVDM, RSVD, dirs);CHKERRQ(ierr);
+
+		for (is=0; is<NUM_BENCH; is++) {
+
+			ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+			ierr = PetscTime(&t1);CHKERRQ(ierr);
+			switch (is) {
+				case 0:
+					ierr = FactorOperator(RSVDM, RSVD, dirs, w);CHKERRQ(ierr);
+					ksp  = RSVDM->ksp;
+					break;
+				case 1:
+				case 4:
+					if ((is == 1) == DirAdj) {
+						ierr = DirectAction(ksp, RSVDM, RSVD, &Weight[0]);CHKERRQ(ierr);
+					} else {
+						ierr = AdjointAction(ksp, RSVDM, RSVD, &Weight[0]);CHKERRQ(ierr);
+					}
+					break;
+				case 2:
+					ierr = QRDecomposition(RSVD, RSVDM->Y_hat, NULL);CHKERRQ(ierr);
+					break;
+				case 3:
+					ierr = SVD4Response(RSVDM, RSVD, &Weight[0], Res, dirs, 0);CHKERRQ(ierr);
+					break;
+				case 5:
+					ierr = ApplyWeightMats(RSVDM, RSVD, &Weight[0], DirAdj, 1);CHKERRQ(ierr);
+					ierr = ApplyWeightMats(RSVDM, RSVD, &Weight[0], (PetscBool) !DirAdj, 0);CHKERRQ(ierr);
+					break;
+				case 6:
+					ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->FolderDir,"Bench_Y_hat");CHKERRQ(ierr);
+					ierr = WriteMat(RSVD, Res, RSVDM->Y_hat, dirs->IO_dir);CHKERRQ(ierr);
+					if (Res->Writer && RSVD->AsyncIO) ierr = AsyncWriterFlush(Res->Writer, NULL);CHKERRQ(ierr);
+					break;
+				case 7:
+					ierr = SVD4Forcing(RSVDM, RSVD, &Weight[0], Res, dirs, 0);CHKERRQ(ierr);
+					break;
+			}
+			ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+			ierr = PetscTime(&t2);CHKERRQ(ierr);
+			t    = t2 - t1;
+			ierr = MPI_Allreduce(MPI_IN_PLACE,&t,1,MPIU_REAL,MPIU_MAX,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+			tmin[is] = PetscMin(tmin[is],t);
+			tmax[is] = PetscMax(tmax[is],t);
+			tsum[is] += t;
+		}
+
+	}
+
+	/*
+		Gains of the randomized algorithm against the exact resolvent at small N, both with the factors of
+		the last repetition, the gains being handed over by the gains callback
+	*/
+
+	if (RSVD->N <= RSVD->Bench.ExactMaxN) {
+		GainsFn         = Res->GainsFn;
+		MonitorCtx      = Res->MonitorCtx;
+		ierr = PetscCalloc2(RSVD->k,&gains,RSVD->k,&gains_exact);CHKERRQ(ierr);
+		Res->GainsFn    = BenchGains;
+		Res->MonitorCtx = gains;
+		ierr = CreateRandomMat(RSVDM, RSVD, dirs);CHKERRQ(ierr);
+		if (DirAdj) {
+			ierr = DirectAction(ksp, RSVDM, RSVD, &Weight[0]);CHKERRQ(ierr);
+		} else {
+			ierr = AdjointAction(ksp, RSVDM, RSVD, &Weight[0]);CHKERRQ(ierr);
+		}
+		ierr = PowerIteration(ksp, RSVDM, RSVD, &Weight[0], &rounds, &change);CHKERRQ(ierr);
+		ierr = SVD4Response(RSVDM, RSVD, &Weight[0], Res, dirs, 0);CHKERRQ(ierr);
+		if (DirAdj) {
+			ierr = AdjointAction(ksp, RSVDM, RSVD, &Weight[0]);CHKERRQ(ierr);
+		} else {
+			ierr = DirectAction(ksp, RSVDM, RSVD, &Weight[0]);CHKERRQ(ierr);
+		}
+		ierr = SVD4Forcing(RSVDM, RSVD, &Weight[0], Res, dirs, 0);CHKERRQ(ierr);
+		Res->MonitorCtx = gains_exact;
+		ierr = ExactResolvent(ksp, RSVDM, RSVD, &Weight[0], Res, dirs, 0);CHKERRQ(ierr);
+		Res->GainsFn    = GainsFn;
+		Res->MonitorCtx = MonitorCtx;
+
+		nc   = PetscMax(1,PetscMin(PetscMin(RSVD->SaveModesNum,RSVD->k),PetscMin(RSVD->Nb,RSVD->Nc)));
+		err  = 0;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"\nLeading %d gains (randomized, exact, relative error):\n", (int)nc);CHKERRQ(ierr);
+		for (ik=0; ik<nc; ik++) {
+			t    = gains_exact[ik] > 0 ? PetscAbsReal(gains[ik] - gains_exact[ik])/gains_exact[ik] : PetscAbsReal(gains[ik]);
+			err  = PetscMax(err,t);
+			ierr = PetscPrintf(PETSC_COMM_WORLD,"    %3d: %14.8g %14.8g %10.3e\n", (int)ik+1, gains[ik], gains_exact[ik], t);CHKERRQ(ierr);
+		}
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Max relative error of the leading %d gains = %g\n", (int)nc, err);CHKERRQ(ierr);
+		ierr = PetscFree2(gains,gains_exact);CHKERRQ(ierr);
+	}
+	RSVD->SaveModesOpt = SaveModesOpt;
+	RSVD->InMemory     = InMemory;
+
+	/*
+		Prints out the stage timings and appends them to BenchCSV
+	*/
+
+	ierr = PetscTestFile(dirs->BenchCSV,'r',&exists);CHKERRQ(ierr);
+	ierr = MPI_Bcast(&exists,1,MPIU_BOOL,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	ierr = PetscFOpen(PETSC_COMM_WORLD,dirs->BenchCSV,"a",&fp);CHKERRQ(ierr);
+	if (!exists) ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"np,threads_lu,threads_solve,threads_dense,N,Nb,Nc,k,q,stage,reps,min_s,mean_s,max_s,gain_rel_err\n");CHKERRQ(ierr);
+
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\nStage timings with %d ranks (N = %d, k = %d, %d repetitions):\n", (int)np, (int)RSVD->N, (int)RSVD->k, (int)RSVD->Bench.Reps);CHKERRQ(ierr);
+	for (is=0; is<NUM_BENCH; is++) {
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"    %-16s min = %10.4f s, mean = %10.4f s, max = %10.4f s\n", stages[is], tmin[is], tsum[is]/RSVD->Bench.Reps, tmax[is]);CHKERRQ(ierr);
+		ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"%d,%d,%d,%d,%d,%d,%d,%d,%d,%s,%d,%g,%g,%g,%g\n", (int)np, (int)RSVD->Threads[STAGE_LU], (int)RSVD->Threads[STAGE_SOLVE], (int)RSVD->Threads[STAGE_DENSE],
+				(int)RSVD->N, (int)RSVD->Nb, (int)RSVD->Nc, (int)RSVD->k, (int)RSVD->q, stages[is], (int)RSVD->Bench.Reps, tmin[is], tsum[is]/RSVD->Bench.Reps, tmax[is], err);CHKERRQ(ierr);
+	}
+	ierr = PetscFClose(PETSC_COMM_WORLD,fp);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\nBenchmark results appended to %s\n\n", dirs->BenchCSV);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
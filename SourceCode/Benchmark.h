@@ -0,0 +1,7 @@
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+PetscErrorCode Benchmark(RSVD_matrices*, RSVD_vars*, Weight_matrices*, Resolvent_matrices*, Directories*);
+
+#endif
\ No newline at end of file
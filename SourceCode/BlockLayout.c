@@ -0,0 +1,57 @@
+
+#include <petscmat.h>
+#include <Variables.h>
+
+PetscErrorCode GetBlockSize(RSVD_vars *RSVD, PetscInt n, PetscInt *bs)
+{
+	/*
+		Block size of a dimension of size n: BlockSize if n is a multiple of it, otherwise 1
+		Every object of a blocked dimension uses the block size in its layout, so that its parallel
+		distribution (whole blocks per rank) matches the one of the BAIJ operator and matrices
+	*/
+
+	PetscFunctionBeginUser;
+
+	*bs = (RSVD->BlockSize > 1 && n % RSVD->BlockSize == 0) ? RSVD->BlockSize : 1;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode LoadSparseMat(RSVD_vars *RSVD, const char *filename, Mat *A)
+{
+	/*
+		Loads a sparse matrix in block CSR (MATMPIBAIJ) if both of its dimensions are blocked,
+		otherwise in CSR (MATMPIAIJ) with the block layout of its blocked dimension (if any)
+		In batch mode, the sequential formats are used on groups of one rank
+	*/
+
+	PetscErrorCode        ierr;
+	PetscViewer           fd;
+	PetscInt              header[4], rbs, cbs;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&fd);CHKERRQ(ierr);
+	ierr = PetscViewerBinaryRead(fd,header,4,NULL,PETSC_INT);CHKERRQ(ierr);
+	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+	if (header[0] != MAT_FILE_CLASSID) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_FILE_UNEXPECTED,"%s is not a matrix in PETSc binary format", filename);
+
+	ierr = GetBlockSize(RSVD, header[1], &rbs);CHKERRQ(ierr);
+	ierr = GetBlockSize(RSVD, header[2], &cbs);CHKERRQ(ierr);
+
+	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&fd);CHKERRQ(ierr);
+	ierr = MatCreate(PETSC_COMM_WORLD,A);CHKERRQ(ierr);
+	if (RSVD->Batch.Flg) {
+		ierr = MatSetType(*A,(rbs > 1 && rbs == cbs) ? MATBAIJ : MATAIJ);CHKERRQ(ierr);
+	} else {
+		ierr = MatSetType(*A,(rbs > 1 && rbs == cbs) ? MATMPIBAIJ : MATMPIAIJ);CHKERRQ(ierr);
+	}
+	ierr = MatSetBlockSizes(*A,rbs,cbs);CHKERRQ(ierr);
+	ierr = MatLoad(*A,fd);CHKERRQ(ierr);
+	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
@@ -0,0 +1,8 @@
+
+#ifndef BLOCKLAYOUT_H
+#define BLOCKLAYOUT_H
+
+PetscErrorCode GetBlockSize(RSVD_vars*, PetscInt, PetscInt*);
+PetscErrorCode LoadSparseMat(RSVD_vars*, const char*, Mat*);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,139 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+
+PetscErrorCode CapacityPlanner(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight)
+{
+	/*
+		Dry run: predicts the memory and time per frequency without factorizing
+		Only the MUMPS analysis is performed on NumFreqs sample frequencies (evenly spread over the grid),
+		giving the factor memory per rank and the flop count of the factorization; the solve cost follows
+		from the number of entries in the factors and the number of solves for the configured k and q
+		A process count and number of frequency groups are then recommended for the given node memory,
+		ranks per node and wall time (assuming a sustained rate of Gflops per rank)
+	*/
+
+	PetscErrorCode        ierr;
+	Mat                   A, F;
+	MatFactorInfo         info;
+	MatInfo               ainfo;
+	PetscInt              is, iw, ns, nsolves, ic, hh, mm, ss, nodes, np_rec, groups;
+	PetscMPIInt           np;
+	PetscInt              mem_rank, mem_max, mem_sum, entries;
+	PetscReal             w, flops, fact_flops = 0, solve_flops = 0, dense_flops = 0, mem_dense, mem_op, mem_need, mem_rank_max = 0, mem_total = 0, t_freq, t_all;
+	PetscLogDouble        t1, t2;
+
+	PetscFunctionBeginUser;
+
+	ierr = MPI_Comm_size(PETSC_COMM_WORLD,&np);CHKERRMPI(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*******************************************\n"
+			"************* Capacity planner ************\n*******************************************\n\n");CHKERRQ(ierr);
+
+	ns = PetscMin(RSVD->Plan.NumFreqs,RSVD->Nw);
+	for (is=0; is<ns; is++) {
+
+		iw   = ns > 1 ? (is*(RSVD->Nw-1))/(ns-1) : 0;
+		w    = RSVD->w_min + iw * RSVD->dw;
+		ierr = PetscTime(&t1);CHKERRQ(ierr);
+
+		ierr = MatDuplicate(RSVDM->A_org,MAT_COPY_VALUES,&A);CHKERRQ(ierr);
+		ierr = MatScale(A, -1.);CHKERRQ(ierr);
+		ierr = MatShift(A, PETSC_i * w);CHKERRQ(ierr);
+		if (RSVD->Disc.DiscFlg) ierr = MatShift(A,-RSVD->Disc.beta);CHKERRQ(ierr);
+
+		ierr = MatGetFactor(A,MATSOLVERMUMPS,MAT_FACTOR_LU,&F);CHKERRQ(ierr);
+		ierr = MatFactorInfoInitialize(&info);CHKERRQ(ierr);
+		ierr = MatLUFactorSymbolic(F,A,NULL,NULL,&info);CHKERRQ(ierr);
+
+		/*
+			INFO(15): factorization memory of this rank (MB), INFOG(16)/(17): max/sum over the ranks (MB)
+			INFOG(3): entries in the factors (negative: in millions), RINFOG(1): flops of the factorization
+		*/
+
+		ierr = MatMumpsGetInfo(F,15,&mem_rank);CHKERRQ(ierr);
+		ierr = MatMumpsGetInfog(F,16,&mem_max);CHKERRQ(ierr);
+		ierr = MatMumpsGetInfog(F,17,&mem_sum);CHKERRQ(ierr);
+		ierr = MatMumpsGetInfog(F,3,&entries);CHKERRQ(ierr);
+		ierr = MatMumpsGetRinfog(F,1,&flops);CHKERRQ(ierr);
+
+		ierr = PetscTime(&t2);CHKERRQ(ierr);
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Sample iw = %d (w = %g): factor memory max/rank = %d MB, total = %d MB, entries = %g, factorization = %g Gflop (analysis %g s)\n",
+				(int)iw+1, w, (int)mem_max, (int)mem_sum, entries < 0 ? -1e6*entries : (PetscReal)entries, flops/1e9, t2-t1);CHKERRQ(ierr);
+		if (RSVD->Display == 2) ierr = PetscSynchronizedPrintf(PETSC_COMM_WORLD,"    rank %d: %d MB\n",(int)PetscGlobalRank,(int)mem_rank);CHKERRQ(ierr);
+		if (RSVD->Display == 2) ierr = PetscSynchronizedFlush(PETSC_COMM_WORLD,PETSC_STDOUT);CHKERRQ(ierr);
+
+		fact_flops   = PetscMax(fact_flops,flops);
+		solve_flops  = PetscMax(solve_flops,8*(entries < 0 ? -1e6*entries : (PetscReal)entries));
+		mem_rank_max = PetscMax(mem_rank_max,1e6*mem_max);
+		mem_total    = PetscMax(mem_total,1e6*mem_sum);
+
+		ierr = MatDestroy(&F);CHKERRQ(ierr);
+		ierr = MatDestroy(&A);CHKERRQ(ierr);
+	}
+
+	/*
+		Solves and dense work per frequency (worst case over the configurations)
+		Randomized: 2k(q+1) solves, 2(q+1) QRs and 2 SVDs of N x k blocks; exact: min(Nb, Nc) solves
+	*/
+
+	nsolves   = 0;
+	mem_dense = 0;
+	for (ic=0; ic<RSVD->NumConfigs; ic++) {
+		if (RSVD->ExactOpt == 2 || (RSVD->ExactOpt == 1 && PetscMin(Weight[ic].Nb,Weight[ic].Nc) <= RSVD->k*(RSVD->q+1))) {
+			nsolves   = PetscMax(nsolves,PetscMin(Weight[ic].Nb,Weight[ic].Nc));
+			mem_dense = PetscMax(mem_dense,3.*RSVD->N*PetscMin(Weight[ic].Nb,Weight[ic].Nc)*sizeof(PetscScalar));
+		} else {
+			nsolves   = PetscMax(nsolves,2*RSVD->k*(RSVD->q+1));
+			mem_dense = PetscMax(mem_dense,3.*RSVD->N*RSVD->k*sizeof(PetscScalar));
+		}
+	}
+	nsolves    *= RSVD->NumConfigs;
+	dense_flops = RSVD->NumConfigs*8.*RSVD->N*RSVD->k*RSVD->k*(2*(RSVD->q+1)+2);
+	mem_dense  /= np;
+
+	ierr   = MatGetInfo(RSVDM->A_org,MAT_GLOBAL_MAX,&ainfo);CHKERRQ(ierr);
+	mem_op = 2*ainfo.memory;
+	mem_need = mem_rank_max + mem_dense + mem_op;
+
+	t_freq = (fact_flops + nsolves*solve_flops + dense_flops)/(np*RSVD->Plan.Gflops*1e9);
+	t_all  = t_freq*RSVD->Nw*RSVD->NumOps;
+
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\nPrediction with %d ranks (per frequency, worst sample):\n",(int)np);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    memory per rank     = %.3g GB (factors %.3g GB, dense N x k blocks %.3g GB, operators %.3g GB)\n",
+			mem_need/1e9, mem_rank_max/1e9, mem_dense/1e9, mem_op/1e9);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    factorization       = %g Gflop\n", fact_flops/1e9);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    solves              = %d x %g Gflop\n", (int)nsolves, solve_flops/1e9);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    dense (QR/SVD)      = %g Gflop\n", dense_flops/1e9);CHKERRQ(ierr);
+	hh   = t_freq/3600;
+	mm   = (t_freq-3600*hh)/60;
+	ss   = t_freq-3600*hh-mm*60;
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    time per frequency  = %02d:%02d:%02d (at %g Gflop/s per rank)\n", (int)hh, (int)mm, (int)ss, RSVD->Plan.Gflops);CHKERRQ(ierr);
+	hh   = t_all/3600;
+	mm   = (t_all-3600*hh)/60;
+	ss   = t_all-3600*hh-mm*60;
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    time of all %d frequencies = %02d:%02d:%02d\n", (int)(RSVD->Nw*RSVD->NumOps), (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+
+	/*
+		Recommendation: the total factor memory barely depends on the number of ranks, so the nodes
+		are sized from it (80% of the node memory usable), then the frequencies are split into groups
+		(independent runs over sub-ranges of [w_min, w_max]) that fit into the wall time
+	*/
+
+	nodes  = (PetscInt)PetscCeilReal((mem_total + np*(mem_dense + mem_op))/(0.8*RSVD->Plan.NodeMem*1e9));
+	nodes  = PetscMax(nodes,1);
+	np_rec = nodes*RSVD->Plan.RanksPerNode;
+	t_freq = (fact_flops + nsolves*solve_flops + dense_flops)/(np_rec*RSVD->Plan.Gflops*1e9);
+	groups = (PetscInt)PetscCeilReal(t_freq*RSVD->Nw*RSVD->NumOps/(RSVD->Plan.Walltime*3600));
+	groups = PetscMin(PetscMax(groups,1),RSVD->Nw);
+
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\nRecommendation for %g GB nodes with %d ranks per node and %g h wall time:\n",
+			RSVD->Plan.NodeMem, (int)RSVD->Plan.RanksPerNode, RSVD->Plan.Walltime);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"    nodes               = %d\n    ranks               = %d\n    frequency groups    = %d (%d frequencies each)\n\n",
+			(int)nodes, (int)np_rec, (int)groups, (int)((RSVD->Nw+groups-1)/groups));CHKERRQ(ierr);
+	if (mem_need*RSVD->Plan.RanksPerNode > RSVD->Plan.NodeMem*1e9) ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: with the current %d ranks, %d ranks per node would need %.3g GB per node\n\n",
+			(int)np, (int)RSVD->Plan.RanksPerNode, mem_need*RSVD->Plan.RanksPerNode/1e9);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
@@ -0,0 +1,7 @@
+
+#ifndef CAPACITYPLANNER_H
+#define CAPACITYPLANNER_H
+
+PetscErrorCode CapacityPlanner(RSVD_matrices*, RSVD_vars*, Weight_matrices*);
+
+#endif
\ No newline at end of file
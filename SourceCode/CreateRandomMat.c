@@ -1,29 +1,142 @@
 
-#include <petscmat.h>
+#include <stdint.h>
+#include <petscksp.h>
 #include <Variables.h>
+#include <BlockLayout.h>
+
+static uint64_t Mix64(uint64_t x)
+{
+	/*
+		Finalizer of SplitMix64, a bijection of the 64-bit integers with full avalanche
+	*/
+
+	x += 0x9E3779B97F4A7C15ULL;
+	x  = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x  = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+static uint64_t Counter(PetscInt seed, PetscInt stream, PetscInt row, PetscInt col)
+{
+	/*
+		Random 64 bits of the global entry (row, col) of a stream, i.e., independent of the parallel layout
+	*/
+
+	return Mix64(Mix64(Mix64((uint64_t)seed ^ ((uint64_t)stream << 56)) + (uint64_t)row) + (uint64_t)col);
+}
+
+static PetscReal Uniform(uint64_t x)
+{
+	/*
+		Uniform real in (0, 1) from the 53 high bits
+	*/
+
+	return ((PetscReal)(x >> 11) + 0.5) / 9007199254740992.0;
+}
 
 PetscErrorCode CreateRandomMat(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Directories *dirs)
 {
 	/*
-		Generates a random matrix of size N x k
-	*/  
+		Generates a random matrix of size Nb x k, or Nc x k if the sketch starts from the output space
+		Every entry is given by a counter-based generator keyed on RandSeed and its global (row, column)
+		index, so that every rank fills its rows independently and the matrix is bit-identical at any
+		number of ranks (and block layout). SketchOpt selects the test matrix:
+		- 0: Gaussian (complex, independent real and imaginary parts)
+		- 1: Rademacher (random signs)
+		- 2: sparse sign, min(k, 8) random signs per row at random columns
+		- 3: subsampled randomized Fourier transform D F S, with random signs D, the DFT F of size n
+		     and k distinct random frequencies S (entries formed explicitly)
+	*/
 
 	PetscErrorCode        ierr=0;
-	PetscRandom           r;
+	PetscInt              bs, n, rstart, rend, lda, i, j, t, z, tmp, *idx, *freq;
+	PetscScalar          *a;
+	PetscReal             r, theta;
+	PetscBool             dup;
+	const char           *names[4] = {"Gaussian", "Rademacher", "sparse sign", "SRFT"};
 
 	PetscFunctionBeginUser;
 
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Generating a random forcing matrix\n\n");CHKERRQ(ierr);
+	n    = RSVD->AdjointFirst ? RSVD->Nc : RSVD->Nb;
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Generating a random %s matrix (%s)\n\n", RSVD->AdjointFirst ? "response" : "forcing", names[RSVD->SketchOpt]);CHKERRQ(ierr);
 	ierr = MatCreate(PETSC_COMM_WORLD,&RSVDM->Y_hat);CHKERRQ(ierr);
 	ierr = MatSetType(RSVDM->Y_hat,MATDENSE);CHKERRQ(ierr);
-	ierr = MatSetSizes(RSVDM->Y_hat,PETSC_DECIDE,PETSC_DECIDE,RSVD->Nb,RSVD->k);CHKERRQ(ierr);
+	ierr = MatSetSizes(RSVDM->Y_hat,PETSC_DECIDE,PETSC_DECIDE,n,RSVD->k);CHKERRQ(ierr);
+	ierr = GetBlockSize(RSVD, n, &bs);CHKERRQ(ierr);
+	ierr = MatSetBlockSizes(RSVDM->Y_hat,bs,1);CHKERRQ(ierr);
 	ierr = MatSetUp(RSVDM->Y_hat);CHKERRQ(ierr);
-	ierr = PetscRandomCreate(PETSC_COMM_WORLD,&r);CHKERRQ(ierr);
-	ierr = PetscRandomSetSeed(r, RSVD->RandSeed);CHKERRQ(ierr);
-	ierr = PetscRandomSeed(r);CHKERRQ(ierr);
-	ierr = MatSetRandom(RSVDM->Y_hat,r);CHKERRQ(ierr);
+
+	ierr = MatGetOwnershipRange(RSVDM->Y_hat,&rstart,&rend);CHKERRQ(ierr);
+	ierr = MatDenseGetLDA(RSVDM->Y_hat,&lda);CHKERRQ(ierr);
+	ierr = MatDenseGetArrayWrite(RSVDM->Y_hat,&a);CHKERRQ(ierr);
+
+	switch (RSVD->SketchOpt) {
+		case SKETCH_GAUSSIAN:
+			for (j=0; j<RSVD->k; j++) {
+				for (i=rstart; i<rend; i++) {
+					r     = PetscSqrtReal(-2*PetscLogReal(Uniform(Counter(RSVD->RandSeed,0,i,j))));
+					theta = 2*PETSC_PI*Uniform(Counter(RSVD->RandSeed,1,i,j));
+					a[(i-rstart)+j*lda] = r*PetscCosReal(theta) + PETSC_i*r*PetscSinReal(theta);
+				}
+			}
+			break;
+		case SKETCH_RADEMACHER:
+			for (j=0; j<RSVD->k; j++) {
+				for (i=rstart; i<rend; i++) a[(i-rstart)+j*lda] = (Counter(RSVD->RandSeed,0,i,j) >> 63) ? 1. : -1.;
+			}
+			break;
+		case SKETCH_SPARSESIGN:
+
+			/*
+				The z columns of every row are the first z of a partial Fisher-Yates shuffle of 0..k-1
+			*/
+
+			z    = PetscMin(RSVD->k,8);
+			ierr = PetscMalloc1(RSVD->k,&idx);CHKERRQ(ierr);
+			for (j=0; j<RSVD->k; j++) {
+				for (i=rstart; i<rend; i++) a[(i-rstart)+j*lda] = 0;
+			}
+			for (i=rstart; i<rend; i++) {
+				for (j=0; j<RSVD->k; j++) idx[j] = j;
+				for (t=0; t<z; t++) {
+					j      = t + (PetscInt)(Counter(RSVD->RandSeed,2,i,t) % (uint64_t)(RSVD->k-t));
+					tmp    = idx[t];
+					idx[t] = idx[j];
+					idx[j] = tmp;
+					a[(i-rstart)+idx[t]*lda] = (Counter(RSVD->RandSeed,3,i,t) >> 63) ? 1. : -1.;
+				}
+			}
+			ierr = PetscFree(idx);CHKERRQ(ierr);
+			break;
+		case SKETCH_SRFT:
+
+			/*
+				Frequencies drawn the same way on every rank (distinct unless k > n); the phase
+				(i s_j mod n)/n is exact in integer arithmetic
+			*/
+
+			ierr = PetscMalloc1(RSVD->k,&freq);CHKERRQ(ierr);
+			for (j=0; j<RSVD->k; j++) {
+				for (t=0, dup=PETSC_TRUE; dup; t++) {
+					freq[j] = (PetscInt)(Counter(RSVD->RandSeed,4,j,t) % (uint64_t)n);
+					for (z=0, dup=PETSC_FALSE; z<j && j<n; z++) dup = (PetscBool) (dup || freq[z] == freq[j]);
+				}
+			}
+			for (j=0; j<RSVD->k; j++) {
+				for (i=rstart; i<rend; i++) {
+					theta = -2*PETSC_PI*(PetscReal)(((PetscInt64)i*freq[j]) % n)/n;
+					r     = (Counter(RSVD->RandSeed,5,i,0) >> 63) ? 1. : -1.;
+					a[(i-rstart)+j*lda] = r*PetscCosReal(theta) + PETSC_i*r*PetscSinReal(theta);
+				}
+			}
+			ierr = PetscFree(freq);CHKERRQ(ierr);
+			break;
+	}
+
+	ierr = MatDenseRestoreArrayWrite(RSVDM->Y_hat,&a);CHKERRQ(ierr);
+	ierr = MatAssemblyBegin(RSVDM->Y_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(RSVDM->Y_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
 
 	PetscFunctionReturn(0);
-	
-}
 
+}
@@ -1,6 +1,6 @@
 
 #include <unistd.h>
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
 
 PetscErrorCode CreateResultsDir(Directories *dirs, const char *FileName)
@@ -10,14 +10,15 @@ PetscErrorCode CreateResultsDir(Directories *dirs, const char *FileName)
 	*/
 
 	PetscErrorCode        ierr;
-	PetscInt              rank, FolderInd=0;
+	PetscInt              FolderInd=0;
+	PetscMPIInt           rank;
 	char                  FolderName[PETSC_MAX_PATH_LEN];
 
 	PetscFunctionBeginUser;
 
-	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,(int*)&rank);CHKERRMPI(ierr);
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
 
-	if ((int)rank == 0) {
+	if (!rank) {
 		ierr = PetscSNPrintf((char*)&FolderName,PETSC_MAX_PATH_LEN,"%s%d/",FileName,(int)FolderInd);CHKERRQ(ierr);
 		ierr = PetscSNPrintf((char*)&dirs->FolderDir,PETSC_MAX_PATH_LEN,"%s%s%s",dirs->RootDir,dirs->ResultsDir,FolderName);CHKERRQ(ierr);
 		while (access(dirs->FolderDir, F_OK) == 0) {
@@ -27,8 +28,16 @@ PetscErrorCode CreateResultsDir(Directories *dirs, const char *FileName)
 		}
 		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"mkdir %s",dirs->FolderDir);CHKERRQ(ierr);
 		ierr = system(dirs->IO_dir);CHKERRQ(ierr);
+		ierr = PetscStrncpy(dirs->MainFolderDir,dirs->FolderDir,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
 	}
 
+	/*
+		All ranks need the folder name, the modes are written by every rank
+	*/
+
+	ierr = MPI_Bcast(dirs->FolderDir,PETSC_MAX_PATH_LEN,MPI_CHAR,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	ierr = MPI_Bcast(dirs->MainFolderDir,PETSC_MAX_PATH_LEN,MPI_CHAR,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
 	PetscFunctionReturn(0);
 	
 }
@@ -2,6 +2,8 @@
 #include <petscksp.h>
 #include <Variables.h>
 #include <ApplyWeightMats.h>
+#include <StageThreads.h>
+#include <MultiShift.h>
 
 PetscErrorCode DirectAction(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight)
 {
@@ -9,34 +11,35 @@ PetscErrorCode DirectAction(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weig
 		Computes $R \times \hat{F}$ 
 		For a modified resolvent operator, it computes C * W_q_sqrt * R * W_f_sqrt_inv * B \times \hat{F} 
 		In the latter case, the weight and input/output matrices are given as inputs
+		All columns are solved at once, so that MUMPS receives the block as distributed right-hand sides
+		With the multi-shift solver, the LU of the central frequency of the window preconditions GMRES
 	*/
 
 	PetscErrorCode        ierr;
-	PetscLogDouble        t1, t2, t3, t4;
-	Vec                   x;
-	PetscInt              j, hh, mm, ss;
+	PetscLogDouble        t1, t2;
+	Mat                   X;
+	PetscInt              nv, hh, mm, ss;
 
 	PetscFunctionBeginUser;
 
 	ierr = ApplyWeightMats(RSVDM, RSVD, Weight, 1, 1);CHKERRQ(ierr);
 
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_SOLVE);CHKERRQ(ierr);
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
-	for (j=0; j<RSVD->k; j++) {
-		ierr = PetscTime(&t3);CHKERRQ(ierr);
-		ierr = MatDenseGetColumnVecWrite(RSVDM->Y_hat, j, &x);CHKERRQ(ierr);
-		ierr = KSPSolve(ksp, x, x);CHKERRQ(ierr);
-		ierr = MatDenseRestoreColumnVecWrite(RSVDM->Y_hat, j, &x);CHKERRQ(ierr);
-		ierr = PetscTime(&t4);CHKERRQ(ierr);
-		hh   = (t4-t3)/3600;
-		mm   = (t4-t3-3600*hh)/60;
-		ss   = t4-t3-3600*hh-mm*60;
-		if (RSVD->Display == 2) ierr = PetscPrintf(PETSC_COMM_WORLD,"Solving LU-decomposed system (direct) for mode number %d elapsed time = %02d:%02d:%02d\n", (int) j+1, (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);    
+	ierr = MatGetSize(RSVDM->Y_hat,NULL,&nv);CHKERRQ(ierr);
+	ierr = MatDuplicate(RSVDM->Y_hat,MAT_DO_NOT_COPY_VALUES,&X);CHKERRQ(ierr);
+	if (RSVDM->MS) {
+		ierr = MultiShiftMatSolve(RSVDM->MS, RSVD, RSVDM->Y_hat, X, PETSC_FALSE);CHKERRQ(ierr);
+	} else {
+		ierr = KSPMatSolve(ksp, RSVDM->Y_hat, X);CHKERRQ(ierr);
 	}
+	ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
+	RSVDM->Y_hat = X;
 	ierr = PetscTime(&t2);CHKERRQ(ierr);
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Solving LU-decomposed system (direct) for all modes elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Solving LU-decomposed system (direct) for all %d modes elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)nv, (int)RSVD->Threads[STAGE_SOLVE], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
 	ierr = ApplyWeightMats(RSVDM, RSVD, Weight, 1, 0);CHKERRQ(ierr);
 
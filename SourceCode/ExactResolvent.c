@@ -0,0 +1,152 @@
+
+#include <slepcsvd.h>
+#include <Variables.h>
+#include <BlockLayout.h>
+#include <DirectAction.h>
+#include <AdjointAction.h>
+#include <SaveModes.h>
+#include <StageThreads.h>
+#include <SaveModesPolicy.h>
+
+PetscErrorCode ExactResolvent(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs, PetscInt iw)
+{
+	/*
+		Computes the resolvent modes and gains exactly when the input (Nb) or output (Nc) size is small
+		The weighted resolvent is formed by applying it to the identity of the smaller of the two spaces:
+		R (Nc x Nb) with Nb direct solves if Nb <= Nc, otherwise R' (Nb x Nc) with Nc adjoint solves
+		followed by a dense SVD; only min(k, Nb, Nc) modes exist, the remaining columns and gains are zero
+	*/
+
+	PetscErrorCode        ierr=0;
+	PetscInt              ik, n, nconv, bs, hh, mm, ss;
+	PetscReal             sigma;
+	PetscBool             direct, save;
+	Vec                   U, V;
+	Mat                   Y_U;
+	SVD                   svd;
+	PetscLogDouble        t1, t2;
+
+	PetscFunctionBeginUser;
+
+	direct = (PetscBool) (RSVD->Nb <= RSVD->Nc);
+	n      = direct ? RSVD->Nb : RSVD->Nc;
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Exact resolvent with %d %s solves\n\n", (int)n, direct ? "direct" : "adjoint");CHKERRQ(ierr);
+
+	/*
+		Applies the resolvent to the identity of size n x n
+	*/
+
+	ierr = MatCreate(PETSC_COMM_WORLD,&RSVDM->Y_hat);CHKERRQ(ierr);
+	ierr = MatSetType(RSVDM->Y_hat,MATDENSE);CHKERRQ(ierr);
+	ierr = MatSetSizes(RSVDM->Y_hat,PETSC_DECIDE,PETSC_DECIDE,n,n);CHKERRQ(ierr);
+	ierr = GetBlockSize(RSVD, n, &bs);CHKERRQ(ierr);
+	ierr = MatSetBlockSizes(RSVDM->Y_hat,bs,1);CHKERRQ(ierr);
+	ierr = MatSetUp(RSVDM->Y_hat);CHKERRQ(ierr);
+	ierr = MatZeroEntries(RSVDM->Y_hat);CHKERRQ(ierr);
+	ierr = MatAssemblyBegin(RSVDM->Y_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(RSVDM->Y_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatShift(RSVDM->Y_hat,1.);CHKERRQ(ierr);
+
+	if (direct) {
+		ierr = DirectAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+	} else {
+		ierr = AdjointAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+	}
+
+	/*
+		Dense SVD of R (U S V') or R' (V S U')
+	*/
+
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_DENSE);CHKERRQ(ierr);
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Exact SVD begins! ***\n");CHKERRQ(ierr);
+
+	ierr = MatCreate(PETSC_COMM_WORLD,&Y_U);CHKERRQ(ierr);
+	ierr = MatSetType(Y_U,MATDENSE);CHKERRQ(ierr);
+	ierr = MatSetSizes(Y_U,PETSC_DECIDE,PETSC_DECIDE,RSVD->Nc,RSVD->k);CHKERRQ(ierr);
+	ierr = GetBlockSize(RSVD, RSVD->Nc, &bs);CHKERRQ(ierr);
+	ierr = MatSetBlockSizes(Y_U,bs,1);CHKERRQ(ierr);
+	ierr = MatSetUp(Y_U);CHKERRQ(ierr);
+	ierr = MatZeroEntries(Y_U);CHKERRQ(ierr);
+
+	ierr = MatCreate(PETSC_COMM_WORLD,&Res->V_hat);CHKERRQ(ierr);
+	ierr = MatSetType(Res->V_hat,MATDENSE);CHKERRQ(ierr);
+	ierr = MatSetSizes(Res->V_hat,PETSC_DECIDE,PETSC_DECIDE,RSVD->Nb,RSVD->k);CHKERRQ(ierr);
+	ierr = GetBlockSize(RSVD, RSVD->Nb, &bs);CHKERRQ(ierr);
+	ierr = MatSetBlockSizes(Res->V_hat,bs,1);CHKERRQ(ierr);
+	ierr = MatSetUp(Res->V_hat);CHKERRQ(ierr);
+	ierr = MatZeroEntries(Res->V_hat);CHKERRQ(ierr);
+
+	ierr = VecCreate(PETSC_COMM_WORLD,&Res->S_hat);CHKERRQ(ierr);
+	ierr = VecSetSizes(Res->S_hat,PETSC_DECIDE,RSVD->k);CHKERRQ(ierr);
+	ierr = VecSetUp(Res->S_hat);CHKERRQ(ierr);
+	ierr = VecZeroEntries(Res->S_hat);CHKERRQ(ierr);
+
+	ierr = SVDCreate(PETSC_COMM_WORLD,&svd);CHKERRQ(ierr);
+	ierr = SVDSetOperators(svd,RSVDM->Y_hat,NULL);CHKERRQ(ierr);
+	ierr = SVDSetDimensions(svd,PetscMin(RSVD->k,PetscMin(RSVD->Nb,RSVD->Nc)),PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
+	ierr = SVDSolve(svd);CHKERRQ(ierr);
+	ierr = SVDGetConverged(svd,&nconv);CHKERRQ(ierr);
+
+	for (ik=0; ik<PetscMin(RSVD->k,nconv); ik++) {
+		ierr = MatDenseGetColumnVecWrite(Y_U,ik,&U);CHKERRQ(ierr);
+		ierr = MatDenseGetColumnVecWrite(Res->V_hat,ik,&V);CHKERRQ(ierr);
+		if (direct) {
+			ierr = SVDGetSingularTriplet(svd,ik,&sigma,U,V);CHKERRQ(ierr);
+		} else {
+			ierr = SVDGetSingularTriplet(svd,ik,&sigma,V,U);CHKERRQ(ierr);
+		}
+		ierr = VecSetValue(Res->S_hat,ik,sigma,INSERT_VALUES);CHKERRQ(ierr);
+		ierr = MatDenseRestoreColumnVecWrite(Res->V_hat,ik,&V);CHKERRQ(ierr);
+		ierr = MatDenseRestoreColumnVecWrite(Y_U,ik,&U);CHKERRQ(ierr);
+	}
+	ierr = VecAssemblyBegin(Res->S_hat);CHKERRQ(ierr);
+	ierr = VecAssemblyEnd(Res->S_hat);CHKERRQ(ierr);
+	ierr = MatAssemblyBegin(Y_U,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(Y_U,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyBegin(Res->V_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(Res->V_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = VecMax(Res->S_hat,NULL,&Res->Gain);CHKERRQ(ierr);
+
+	ierr = SVDDestroy(&svd);CHKERRQ(ierr);
+	ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	hh   = (t2-t1)/3600;
+	mm   = (t2-t1-3600*hh)/60;
+	ss   = t2-t1-3600*hh-mm*60;
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Exact SVD elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)RSVD->Threads[STAGE_DENSE], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+
+	/*
+		Saves the modes and gains as in SVD4Response() and SVD4Forcing()
+	*/
+
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Saving the modes and gains begins! ***\n");CHKERRQ(ierr);
+
+	ierr = SaveGains(RSVD, Res, dirs, iw);CHKERRQ(ierr);
+
+	ierr = SaveModesAtFreq(RSVD, iw, &save);CHKERRQ(ierr);
+	if (save) {
+		ierr = SaveModes(RSVD, Weight, Res, dirs, Y_U, 1, iw);CHKERRQ(ierr);
+		ierr = SaveModes(RSVD, Weight, Res, dirs, Res->V_hat, 0, iw);CHKERRQ(ierr);
+	}
+
+	if (RSVD->SaveModesOpt == 3) {
+		Res->U_hat = Y_U;
+	} else {
+		ierr = MatDestroy(&Y_U);CHKERRQ(ierr);
+		ierr = MatDestroy(&Res->V_hat);CHKERRQ(ierr);
+	}
+	ierr = VecDestroy(&Res->S_hat);CHKERRQ(ierr);
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	hh   = (t2-t1)/3600;
+	mm   = (t2-t1-3600*hh)/60;
+	ss   = t2-t1-3600*hh-mm*60;
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Saving the modes and gains elapsed time = %02d:%02d:%02d ***\n\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
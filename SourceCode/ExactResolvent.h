@@ -0,0 +1,7 @@
+
+#ifndef EXACTRESOLVENT_H
+#define EXACTRESOLVENT_H
+
+PetscErrorCode ExactResolvent(KSP, RSVD_matrices*, RSVD_vars*, Weight_matrices*, Resolvent_matrices*, Directories*, PetscInt);
+
+#endif
\ No newline at end of file
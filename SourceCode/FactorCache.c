@@ -0,0 +1,625 @@
+
+#include <dirent.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <petscksp.h>
+#include <petscpkg_version.h>
+#include <Variables.h>
+
+#if !PETSC_PKG_MUMPS_VERSION_GE(5,1,0)
+#error "The LU factor cache requires MUMPS >= 5.1 (save/restore)"
+#endif
+
+#if defined(PETSC_USE_COMPLEX)
+#include <zmumps_c.h>
+#define MUMPS_STRUC_C         ZMUMPS_STRUC_C
+#define MumpsScalar           ZMUMPS_COMPLEX
+#define MUMPS_c               zmumps_c
+#else
+#include <dmumps_c.h>
+#define MUMPS_STRUC_C         DMUMPS_STRUC_C
+#define MumpsScalar           DMUMPS_REAL
+#define MUMPS_c               dmumps_c
+#endif
+
+#define ICNTL(I)              icntl[(I)-1]
+#define INFO(I)               info[(I)-1]
+#define INFOG(I)              infog[(I)-1]
+#define CNTL(I)               cntl[(I)-1]
+
+/*
+	LU factor cache persisted to disk
+
+	The shifted operator is factorized by a MUMPS instance driven here (a PCSHELL replaces PCLU,
+	since PETSc does not expose the MUMPS save/restore). After each factorization, the factors are
+	saved (MUMPS JOB = 7) in CacheDir/<key>/, where the key is made of a checksum of the operator,
+	the frequency, beta and the number of processes; a later run with the same key restores them
+	(JOB = 8) instead of factorizing. Every rank marks its saved part with done_<rank>; the marker of
+	the first rank holds the size of the factors and its time stamp is used for the LRU eviction
+	once the cache exceeds the size bound.
+	With MUMPS >= 5.3, the right-hand sides and solutions are distributed (ICNTL(20) = 10, ICNTL(21) = 1):
+	every rank passes its rows of x and receives its part of y in the MUMPS layout, scattered back to
+	the PETSc layout, instead of gathering them on the first rank.
+*/
+
+struct _p_FactorCache {
+	MUMPS_STRUC_C         id;                             /* MUMPS instance */
+	PetscBool             init;                           /* instance initialized (JOB = -1) */
+	PetscBool             analyzed;                       /* analysis available (factorized or restored) */
+	MUMPS_INT             nz;                             /* number of local nonzeros */
+	MUMPS_INT            *irn, *jcn;                      /* local nonzeros, 1-based global indices */
+	PetscScalar          *val;                            /* local nonzero values */
+	PetscInt              N;                              /* problem size */
+	Vec                   seq;                            /* local part of the distributed solution (right-hand side/solution on the first rank if MUMPS < 5.3) */
+	VecScatter            scat;                           /* from the MUMPS to the PETSc layout of the solution (to the first rank if MUMPS < 5.3) */
+	MUMPS_INT            *irhs;                           /* global indices (1-based) of the local rows of the right-hand side */
+	MUMPS_INT            *isol;                           /* global indices (1-based) of the local entries of the solution */
+	PetscInt              m, nsol;                        /* number of local rows and local solution entries */
+	uint64_t              checksum;                       /* checksum of the (current) operator */
+	Mat                   A_org;                          /* operator of the checksum */
+	PetscObjectState      state;                          /* state of the operator of the checksum */
+	char                  dir[PETSC_MAX_PATH_LEN];        /* cache directory */
+	PetscReal             maxsize;                        /* max size of the cache in bytes (0: unbounded) */
+	PetscInt              threads;                        /* OpenMP threads of MUMPS, ICNTL(16) */
+	PetscInt              Display;
+	PetscMPIInt           rank, size;
+	PetscInt              nhits, nmisses;
+};
+
+static PetscErrorCode MumpsCall(FactorCache fc, PetscInt job)
+{
+	/*
+		Calls MUMPS with the given job and checks the error code
+	*/
+
+	PetscFunctionBeginUser;
+
+	fc->id.job = (MUMPS_INT)job;
+	MUMPS_c(&fc->id);
+	if (fc->id.INFOG(1) < 0) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_LIB,"MUMPS error (JOB = %d): INFOG(1) = %d, INFOG(2) = %d", (int)job, (int)fc->id.INFOG(1), (int)fc->id.INFOG(2));
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode MumpsInit(FactorCache fc)
+{
+	/*
+		Initializes a MUMPS instance (unsymmetric, distributed assembled input, centralized right-hand side)
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	fc->id.par          = 1;
+	fc->id.sym          = 0;
+	fc->id.comm_fortran = (MUMPS_INT)MPI_Comm_c2f(PETSC_COMM_WORLD);
+	ierr = MumpsCall(fc, -1);CHKERRQ(ierr);
+	fc->init     = PETSC_TRUE;
+	fc->analyzed = PETSC_FALSE;
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode MumpsSetUp(FactorCache fc)
+{
+	/*
+		Sets the matrix and the control parameters (again after a restore)
+		The -mat_mumps_icntl_<i> and -mat_mumps_cntl_<i> options are applied as with PCLU, except for the
+		ICNTLs this interface relies on (output, matrix and right-hand side distribution, threads)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              i, ival;
+	PetscReal             rval;
+	PetscBool             flg;
+	char                  name[64];
+
+	PetscFunctionBeginUser;
+
+	fc->id.ICNTL(1)  = -1;
+	fc->id.ICNTL(2)  = -1;
+	fc->id.ICNTL(3)  = -1;
+	fc->id.ICNTL(4)  = 0;
+	fc->id.ICNTL(5)  = 0;
+	fc->id.ICNTL(18) = 3;
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	fc->id.ICNTL(20) = 10;
+	fc->id.ICNTL(21) = 1;
+#else
+	fc->id.ICNTL(20) = 0;
+	fc->id.ICNTL(21) = 0;
+#endif
+#if PETSC_PKG_MUMPS_VERSION_GE(5,2,0)
+	fc->id.ICNTL(16) = (MUMPS_INT)fc->threads;
+#endif
+	fc->id.n         = (MUMPS_INT)fc->N;
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	fc->id.nnz_loc   = fc->nz;
+#else
+	fc->id.nz_loc    = fc->nz;
+#endif
+	fc->id.irn_loc   = fc->irn;
+	fc->id.jcn_loc   = fc->jcn;
+	fc->id.a_loc     = (MumpsScalar*)fc->val;
+
+	for (i=1; i<=60; i++) {
+		if (i <= 3 || i == 5 || i == 16 || i == 18 || i == 20 || i == 21) continue;
+		ierr = PetscSNPrintf(name,sizeof(name),"-mat_mumps_icntl_%d",(int)i);CHKERRQ(ierr);
+		ierr = PetscOptionsGetInt(NULL,NULL,name,&ival,&flg);CHKERRQ(ierr);
+		if (flg) fc->id.ICNTL(i) = (MUMPS_INT)ival;
+	}
+	for (i=1; i<=15; i++) {
+		ierr = PetscSNPrintf(name,sizeof(name),"-mat_mumps_cntl_%d",(int)i);CHKERRQ(ierr);
+		ierr = PetscOptionsGetReal(NULL,NULL,name,&rval,&flg);CHKERRQ(ierr);
+		if (flg) fc->id.CNTL(i) = rval;
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SetSaveDir(FactorCache fc, const char *keydir)
+{
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	if (strlen(keydir) >= sizeof(fc->id.save_dir)) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Factor cache path too long for MUMPS: %s", keydir);
+	ierr = PetscStrncpy(fc->id.save_dir,keydir,sizeof(fc->id.save_dir));CHKERRQ(ierr);
+	ierr = PetscStrncpy(fc->id.save_prefix,"lu",sizeof(fc->id.save_prefix));CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SolutionSetUp(FactorCache fc)
+{
+	/*
+		Allocates the local part of the distributed solution after a factorization or restore,
+		whose size is INFO(23); the scatter to the PETSc layout is built at the first solve
+	*/
+
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	PetscErrorCode        ierr;
+#endif
+
+	PetscFunctionBeginUser;
+
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	ierr = VecScatterDestroy(&fc->scat);CHKERRQ(ierr);
+	ierr = VecDestroy(&fc->seq);CHKERRQ(ierr);
+	ierr = PetscFree(fc->isol);CHKERRQ(ierr);
+	fc->nsol = fc->id.INFO(23);
+	ierr = PetscMalloc1(fc->nsol,&fc->isol);CHKERRQ(ierr);
+	ierr = VecCreateSeq(PETSC_COMM_SELF,fc->nsol,&fc->seq);CHKERRQ(ierr);
+#endif
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode Solve(PC pc, Vec x, Vec y, PetscBool transpose)
+{
+	/*
+		Solves A y = x (A^T y = x) with the factors
+		Distributed right-hand side and solution with MUMPS >= 5.3, otherwise gathered on the first rank
+	*/
+
+	PetscErrorCode        ierr;
+	FactorCache           fc;
+	PetscScalar          *arr;
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	const PetscScalar    *xarr;
+	PetscInt             *idx, i;
+	IS                    is;
+#endif
+
+	PetscFunctionBeginUser;
+
+	ierr = PCShellGetContext(pc,&fc);CHKERRQ(ierr);
+	fc->id.ICNTL(9) = transpose ? 0 : 1;
+	fc->id.nrhs     = 1;
+
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	ierr = VecGetArrayRead(x,&xarr);CHKERRQ(ierr);
+	ierr = VecGetArray(fc->seq,&arr);CHKERRQ(ierr);
+	fc->id.nloc_rhs = (MUMPS_INT)fc->m;
+	fc->id.lrhs_loc = (MUMPS_INT)fc->m;
+	fc->id.irhs_loc = fc->irhs;
+	fc->id.rhs_loc  = (MumpsScalar*)xarr;
+	fc->id.lsol_loc = (MUMPS_INT)fc->nsol;
+	fc->id.isol_loc = fc->isol;
+	fc->id.sol_loc  = (MumpsScalar*)arr;
+	ierr = MumpsCall(fc, 3);CHKERRQ(ierr);
+	ierr = VecRestoreArray(fc->seq,&arr);CHKERRQ(ierr);
+	ierr = VecRestoreArrayRead(x,&xarr);CHKERRQ(ierr);
+
+	/*
+		The layout of the solution (isol_loc) is fixed by the factorization and known after its first solve
+	*/
+
+	if (!fc->scat) {
+		ierr = PetscMalloc1(fc->nsol,&idx);CHKERRQ(ierr);
+		for (i=0; i<fc->nsol; i++) idx[i] = fc->isol[i]-1;
+		ierr = ISCreateGeneral(PETSC_COMM_SELF,fc->nsol,idx,PETSC_OWN_POINTER,&is);CHKERRQ(ierr);
+		ierr = VecScatterCreate(fc->seq,NULL,y,is,&fc->scat);CHKERRQ(ierr);
+		ierr = ISDestroy(&is);CHKERRQ(ierr);
+	}
+	ierr = VecScatterBegin(fc->scat,fc->seq,y,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecScatterEnd(fc->scat,fc->seq,y,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+#else
+	ierr = VecScatterBegin(fc->scat,x,fc->seq,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecScatterEnd(fc->scat,x,fc->seq,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecGetArray(fc->seq,&arr);CHKERRQ(ierr);
+	fc->id.lrhs     = (MUMPS_INT)fc->N;
+	fc->id.rhs      = (MumpsScalar*)arr;
+	ierr = MumpsCall(fc, 3);CHKERRQ(ierr);
+	ierr = VecRestoreArray(fc->seq,&arr);CHKERRQ(ierr);
+	ierr = VecScatterBegin(fc->scat,fc->seq,y,INSERT_VALUES,SCATTER_REVERSE);CHKERRQ(ierr);
+	ierr = VecScatterEnd(fc->scat,fc->seq,y,INSERT_VALUES,SCATTER_REVERSE);CHKERRQ(ierr);
+#endif
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode ApplyDirect(PC pc, Vec x, Vec y)
+{
+	return Solve(pc, x, y, PETSC_FALSE);
+}
+
+static PetscErrorCode ApplyTranspose(PC pc, Vec x, Vec y)
+{
+	return Solve(pc, x, y, PETSC_TRUE);
+}
+
+static PetscErrorCode Checksum(FactorCache fc, Mat A_org)
+{
+	/*
+		64-bit FNV-1a checksum of the global indices and values of the operator, combined over the ranks
+		Recomputed only if the operator has changed (new operator of a sweep)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              i, j, rstart, rend, ncols;
+	const PetscInt       *cols;
+	const PetscScalar    *vals;
+	PetscObjectState      state;
+	const unsigned char  *p;
+	uint64_t              h = 14695981039346656037ULL;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscObjectStateGet((PetscObject)A_org,&state);CHKERRQ(ierr);
+	if (fc->A_org == A_org && fc->state == state) PetscFunctionReturn(0);
+
+	ierr = MatGetOwnershipRange(A_org,&rstart,&rend);CHKERRQ(ierr);
+	for (i=rstart; i<rend; i++) {
+		ierr = MatGetRow(A_org,i,&ncols,&cols,&vals);CHKERRQ(ierr);
+		for (j=0; j<ncols; j++) {
+			for (p=(const unsigned char*)&cols[j]; p<(const unsigned char*)(&cols[j]+1); p++) h = (h ^ *p) * 1099511628211ULL;
+			for (p=(const unsigned char*)&vals[j]; p<(const unsigned char*)(&vals[j]+1); p++) h = (h ^ *p) * 1099511628211ULL;
+		}
+		ierr = MatRestoreRow(A_org,i,&ncols,&cols,&vals);CHKERRQ(ierr);
+	}
+	h   *= 2*(uint64_t)fc->rank+1;
+	ierr = MPI_Allreduce(MPI_IN_PLACE,&h,1,MPI_UINT64_T,MPI_SUM,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
+	fc->checksum = h;
+	fc->A_org    = A_org;
+	fc->state    = state;
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode Evict(FactorCache fc, const char *keep)
+{
+	/*
+		Removes the least recently used entries until the cache fits into its size bound
+		The first rank decides from its markers, every rank then erases its saved part (JOB = -3)
+	*/
+
+	PetscErrorCode        ierr;
+	DIR                  *d;
+	struct dirent        *e;
+	struct stat           st;
+	FILE                 *fp;
+	char                  path[PETSC_MAX_PATH_LEN], victim[PETSC_MAX_PATH_LEN];
+	double                total, sz, vsz;
+	time_t                oldest;
+	PetscMPIInt           found;
+	MUMPS_STRUC_C         id;
+
+	PetscFunctionBeginUser;
+
+	if (fc->maxsize <= 0) PetscFunctionReturn(0);
+
+	while (1) {
+		found = 0;
+		if (!fc->rank) {
+			total  = 0;
+			oldest = 0;
+			vsz    = 0;
+			d      = opendir(fc->dir);
+			while (d && (e = readdir(d))) {
+				if (e->d_name[0] == '.') continue;
+				ierr = PetscSNPrintf(path,PETSC_MAX_PATH_LEN,"%s%s/done_0",fc->dir,e->d_name);CHKERRQ(ierr);
+				if (stat(path,&st)) continue;
+				sz = 0;
+				fp = fopen(path,"r");
+				if (fp) {
+					if (fscanf(fp,"%lg",&sz) != 1) sz = 0;
+					fclose(fp);
+				}
+				total += sz;
+				if (!strcmp(e->d_name,keep)) continue;
+				if (!found || st.st_mtime < oldest) {
+					found  = 1;
+					oldest = st.st_mtime;
+					vsz    = sz;
+					ierr   = PetscSNPrintf(victim,PETSC_MAX_PATH_LEN,"%s%s/",fc->dir,e->d_name);CHKERRQ(ierr);
+				}
+			}
+			if (d) closedir(d);
+			if (total <= fc->maxsize) found = 0;
+			if (found && fc->Display) ierr = PetscPrintf(PETSC_COMM_SELF,"Factor cache: %.3g GB > %.3g GB, evicting %s (%.3g GB)\n", total/1e9, fc->maxsize/1e9, victim, vsz/1e9);CHKERRQ(ierr);
+		}
+		ierr = MPI_Bcast(&found,1,MPI_INT,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		if (!found) break;
+		ierr = MPI_Bcast(victim,PETSC_MAX_PATH_LEN,MPI_CHAR,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
+		ierr = PetscMemzero(&id,sizeof(id));CHKERRQ(ierr);
+		id.par          = 1;
+		id.sym          = 0;
+		id.comm_fortran = (MUMPS_INT)MPI_Comm_c2f(PETSC_COMM_WORLD);
+		id.job          = -1;
+		MUMPS_c(&id);
+		id.ICNTL(1) = -1; id.ICNTL(2) = -1; id.ICNTL(3) = -1; id.ICNTL(4) = 0;
+		ierr = PetscStrncpy(id.save_dir,victim,sizeof(id.save_dir));CHKERRQ(ierr);
+		ierr = PetscStrncpy(id.save_prefix,"lu",sizeof(id.save_prefix));CHKERRQ(ierr);
+		id.job = -3;
+		MUMPS_c(&id);
+		id.job = -2;
+		MUMPS_c(&id);
+
+		ierr = PetscSNPrintf(path,PETSC_MAX_PATH_LEN,"%sdone_%d",victim,(int)fc->rank);CHKERRQ(ierr);
+		unlink(path);
+		ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		if (!fc->rank) rmdir(victim);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode FactorCacheCreate(RSVD_vars *RSVD, Directories *dirs, Mat A, KSP ksp, FactorCache *cache)
+{
+	/*
+		Creates the cache and sets up ksp (preonly + PCSHELL) to solve with its factors
+		The nonzero pattern of A is fixed for the entire run
+	*/
+
+	PetscErrorCode        ierr;
+	FactorCache           fc;
+	PC                    pc;
+#if !PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	Vec                   x;
+#endif
+	PetscInt              i, j, rstart, rend, ncols, nz;
+	const PetscInt       *cols;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscNew(&fc);CHKERRQ(ierr);
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&fc->rank);CHKERRMPI(ierr);
+	ierr = MPI_Comm_size(PETSC_COMM_WORLD,&fc->size);CHKERRMPI(ierr);
+	ierr = PetscSNPrintf(fc->dir,PETSC_MAX_PATH_LEN,"%s%s/",dirs->RootDir,dirs->FactorCacheDir);CHKERRQ(ierr);
+	fc->maxsize = RSVD->FactorCacheSize*1e9;
+	fc->threads = RSVD->Threads[STAGE_LU];
+	fc->Display = RSVD->Display;
+
+	if (!fc->rank) {
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"mkdir -p %s",fc->dir);CHKERRQ(ierr);
+		ierr = system(dirs->IO_dir);CHKERRQ(ierr);
+	}
+
+	/*
+		Local nonzeros (1-based global indices)
+	*/
+
+	ierr = MatGetSize(A,&fc->N,NULL);CHKERRQ(ierr);
+	ierr = MatGetOwnershipRange(A,&rstart,&rend);CHKERRQ(ierr);
+	for (nz=0, i=rstart; i<rend; i++) {
+		ierr = MatGetRow(A,i,&ncols,NULL,NULL);CHKERRQ(ierr);
+		nz  += ncols;
+		ierr = MatRestoreRow(A,i,&ncols,NULL,NULL);CHKERRQ(ierr);
+	}
+	fc->nz = (MUMPS_INT)nz;
+	ierr   = PetscMalloc3(nz,&fc->irn,nz,&fc->jcn,nz,&fc->val);CHKERRQ(ierr);
+	for (nz=0, i=rstart; i<rend; i++) {
+		ierr = MatGetRow(A,i,&ncols,&cols,NULL);CHKERRQ(ierr);
+		for (j=0; j<ncols; j++, nz++) {
+			fc->irn[nz] = (MUMPS_INT)(i+1);
+			fc->jcn[nz] = (MUMPS_INT)(cols[j]+1);
+		}
+		ierr = MatRestoreRow(A,i,&ncols,&cols,NULL);CHKERRQ(ierr);
+	}
+
+	fc->m = rend-rstart;
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	ierr = PetscMalloc1(fc->m,&fc->irhs);CHKERRQ(ierr);
+	for (i=0; i<fc->m; i++) fc->irhs[i] = (MUMPS_INT)(rstart+i+1);
+#else
+	ierr = MatCreateVecs(A,&x,NULL);CHKERRQ(ierr);
+	ierr = VecScatterCreateToZero(x,&fc->scat,&fc->seq);CHKERRQ(ierr);
+	ierr = VecDestroy(&x);CHKERRQ(ierr);
+#endif
+
+	ierr = MumpsInit(fc);CHKERRQ(ierr);
+
+	ierr = KSPSetType(ksp,KSPPREONLY);CHKERRQ(ierr);
+	ierr = KSPGetPC(ksp,&pc);CHKERRQ(ierr);
+	ierr = PCSetType(pc,PCSHELL);CHKERRQ(ierr);
+	ierr = PCShellSetContext(pc,fc);CHKERRQ(ierr);
+	ierr = PCShellSetApply(pc,ApplyDirect);CHKERRQ(ierr);
+	ierr = PCShellSetApplyTranspose(pc,ApplyTranspose);CHKERRQ(ierr);
+	ierr = PCShellSetName(pc,"MUMPS LU with factor cache");CHKERRQ(ierr);
+
+	*cache = fc;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode FactorCacheFactor(FactorCache fc, Mat A_org, Mat A, PetscReal w, PetscReal beta, PetscBool *hit)
+{
+	/*
+		Restores the factors of A from the cache if available, otherwise factorizes A and saves them
+		A = -A_org + i w I (- beta I) with the nonzero pattern given to FactorCacheCreate
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              i, j, rstart, rend, ncols, nz;
+	const PetscScalar    *vals;
+	char                  key[PETSC_MAX_PATH_LEN], keydir[PETSC_MAX_PATH_LEN], path[PETSC_MAX_PATH_LEN];
+	PetscMPIInt           have;
+	FILE                 *fp;
+	double                size;
+
+	PetscFunctionBeginUser;
+
+	ierr = Checksum(fc, A_org);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(key,PETSC_MAX_PATH_LEN,"%016llx_w%.17g_b%.17g_np%d",(unsigned long long)fc->checksum,(double)w,(double)beta,(int)fc->size);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(keydir,PETSC_MAX_PATH_LEN,"%s%s/",fc->dir,key);CHKERRQ(ierr);
+
+	/*
+		Hit if every rank finds its marker
+	*/
+
+	ierr = PetscSNPrintf(path,PETSC_MAX_PATH_LEN,"%sdone_%d",keydir,(int)fc->rank);CHKERRQ(ierr);
+	have = (access(path, F_OK) == 0);
+	ierr = MPI_Allreduce(MPI_IN_PLACE,&have,1,MPI_INT,MPI_LAND,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
+	/*
+		Current values of A
+	*/
+
+	ierr = MatGetOwnershipRange(A,&rstart,&rend);CHKERRQ(ierr);
+	for (nz=0, i=rstart; i<rend; i++) {
+		ierr = MatGetRow(A,i,&ncols,NULL,&vals);CHKERRQ(ierr);
+		for (j=0; j<ncols; j++, nz++) fc->val[nz] = vals[j];
+		ierr = MatRestoreRow(A,i,&ncols,NULL,&vals);CHKERRQ(ierr);
+	}
+
+	if (have) {
+		if (fc->analyzed) {
+			ierr = MumpsCall(fc, -2);CHKERRQ(ierr);
+			ierr = MumpsInit(fc);CHKERRQ(ierr);
+		}
+		ierr = SetSaveDir(fc, keydir);CHKERRQ(ierr);
+		fc->id.ICNTL(1) = -1; fc->id.ICNTL(2) = -1; fc->id.ICNTL(3) = -1; fc->id.ICNTL(4) = 0;
+		fc->id.job = 8;
+		MUMPS_c(&fc->id);
+		if (fc->id.INFOG(1) < 0) {
+			ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: restoring the factors from %s failed (INFOG(1) = %d), factorizing instead\n", keydir, (int)fc->id.INFOG(1));CHKERRQ(ierr);
+			ierr = MumpsCall(fc, -2);CHKERRQ(ierr);
+			ierr = MumpsInit(fc);CHKERRQ(ierr);
+			have = 0;
+		} else {
+			ierr = MumpsSetUp(fc);CHKERRQ(ierr);
+			fc->analyzed = PETSC_TRUE;
+			if (!fc->rank) utime(path, NULL);
+			fc->nhits++;
+		}
+	}
+
+	if (!have) {
+		ierr = MumpsSetUp(fc);CHKERRQ(ierr);
+		if (!fc->analyzed) {
+			ierr = MumpsCall(fc, 1);CHKERRQ(ierr);
+			fc->analyzed = PETSC_TRUE;
+		}
+		ierr = MumpsCall(fc, 2);CHKERRQ(ierr);
+		fc->nmisses++;
+
+		/*
+			Saves the factors and marks the entry, then bounds the size of the cache
+		*/
+
+		if (!fc->rank) {
+			ierr = PetscSNPrintf(path,PETSC_MAX_PATH_LEN,"mkdir -p %s",keydir);CHKERRQ(ierr);
+			ierr = system(path);CHKERRQ(ierr);
+		}
+		ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		ierr = SetSaveDir(fc, keydir);CHKERRQ(ierr);
+		ierr = MumpsCall(fc, 7);CHKERRQ(ierr);
+
+		size = (fc->id.INFOG(9) < 0 ? -1e6*fc->id.INFOG(9) : (double)fc->id.INFOG(9))*sizeof(PetscScalar)
+		     + (fc->id.INFOG(10) < 0 ? -1e6*fc->id.INFOG(10) : (double)fc->id.INFOG(10))*sizeof(MUMPS_INT);
+		ierr = PetscSNPrintf(path,PETSC_MAX_PATH_LEN,"%sdone_%d",keydir,(int)fc->rank);CHKERRQ(ierr);
+		fp   = fopen(path,"w");
+		if (!fp) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_OPEN,"Cannot write the factor cache marker %s", path);
+		fprintf(fp,"%.17g\n",size);
+		fclose(fp);
+		ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
+		ierr = Evict(fc, key);CHKERRQ(ierr);
+	}
+
+	ierr = SolutionSetUp(fc);CHKERRQ(ierr);
+
+	*hit = (PetscBool) have;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode FactorCacheSetThreads(FactorCache fc, PetscInt threads)
+{
+	/*
+		Sets the number of OpenMP threads used by the following MUMPS calls (factorization or solves)
+	*/
+
+	PetscFunctionBeginUser;
+
+	fc->threads = threads;
+#if PETSC_PKG_MUMPS_VERSION_GE(5,2,0)
+	fc->id.ICNTL(16) = (MUMPS_INT)threads;
+#endif
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode FactorCacheDestroy(FactorCache *cache)
+{
+	/*
+		Releases the MUMPS instance (the saved factors are kept on disk)
+	*/
+
+	PetscErrorCode        ierr=0;
+	FactorCache           fc = *cache;
+
+	PetscFunctionBeginUser;
+
+	if (!fc) PetscFunctionReturn(0);
+	if (fc->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Factor cache: %d restored, %d factorized and saved\n", (int)fc->nhits, (int)fc->nmisses);CHKERRQ(ierr);
+	if (fc->init) ierr = MumpsCall(fc, -2);CHKERRQ(ierr);
+	ierr = VecScatterDestroy(&fc->scat);CHKERRQ(ierr);
+	ierr = VecDestroy(&fc->seq);CHKERRQ(ierr);
+	ierr = PetscFree(fc->irhs);CHKERRQ(ierr);
+	ierr = PetscFree(fc->isol);CHKERRQ(ierr);
+	ierr = PetscFree3(fc->irn,fc->jcn,fc->val);CHKERRQ(ierr);
+	ierr = PetscFree(fc);CHKERRQ(ierr);
+	*cache = NULL;
+
+	PetscFunctionReturn(0);
+
+}
+
@@ -0,0 +1,10 @@
+
+#ifndef FACTORCACHE_H
+#define FACTORCACHE_H
+
+PetscErrorCode FactorCacheCreate(RSVD_vars*, Directories*, Mat, KSP, FactorCache*);
+PetscErrorCode FactorCacheFactor(FactorCache, Mat, Mat, PetscReal, PetscReal, PetscBool*);
+PetscErrorCode FactorCacheSetThreads(FactorCache, PetscInt);
+PetscErrorCode FactorCacheDestroy(FactorCache*);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+
+#include <petscksp.h>
+#include <petscpkg_version.h>
+#include <Variables.h>
+#include <FactorCache.h>
+#include <StageThreads.h>
+
+PetscErrorCode FactorOperator(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Directories *dirs, PetscReal w)
+{
+	/*
+		Builds the shifted operator (i w I - A_org) of the frequency w and factorizes it with MUMPS
+		The KSP is created at the first call and kept in RSVDM->ksp
+	*/
+
+	PetscErrorCode        ierr;
+	KSP                   ksp;
+	PC                    pc;
+	Mat                   A, Ad, F;
+	MatSolverType         type;
+	PetscInt              hh, mm, ss;
+	PetscBool             missing, hit, set, dense, islu, ismumps;
+	PetscLogDouble        t1, t2;
+
+	PetscFunctionBeginUser;
+
+	/*
+		Builds the reolvent operator
+		The shifted operator is kept across frequencies (and operators of the same nonzero pattern)
+		so that the ordering and symbolic factorization are performed only once
+		The diagonal is checked on the local diagonal block, which also covers block CSR (MATMPIBAIJ)
+		A dense operator (batch mode, small N) has all its diagonal entries
+		Low-memory mode: A_org itself is shifted, its diagonal being saved to restore it exactly once factorized
+	*/
+
+	ierr = PetscObjectTypeCompare((PetscObject)RSVDM->A_org,MATSEQDENSE,&dense);CHKERRQ(ierr);
+	if (RSVD->LowMemory) {
+		if (!RSVDM->Diag) ierr = MatCreateVecs(RSVDM->A_org,NULL,&RSVDM->Diag);CHKERRQ(ierr);
+		ierr = MatGetDiagonal(RSVDM->A_org,RSVDM->Diag);CHKERRQ(ierr);
+	} else if (!RSVDM->A) {
+		ierr = MatDuplicate(RSVDM->A_org,MAT_COPY_VALUES,&RSVDM->A);CHKERRQ(ierr);
+	} else if (dense) {
+		ierr = MatCopy(RSVDM->A_org,RSVDM->A,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+	} else {
+		ierr = MatGetDiagonalBlock(RSVDM->A_org,&Ad);CHKERRQ(ierr);
+		ierr = MatMissingDiagonal(Ad,&missing,NULL);CHKERRQ(ierr);
+		ierr = MPI_Allreduce(MPI_IN_PLACE,&missing,1,MPIU_BOOL,MPI_LOR,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		ierr = MatCopy(RSVDM->A_org,RSVDM->A,missing ? SUBSET_NONZERO_PATTERN : SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+	}
+	A    = RSVD->LowMemory ? RSVDM->A_org : RSVDM->A;
+	ierr = MatScale(A, -1.);CHKERRQ(ierr);
+	ierr = MatShift(A, PETSC_i * w);CHKERRQ(ierr);
+
+	/*
+		Discounting
+	*/
+
+	if (RSVD->Disc.DiscFlg) {
+		ierr = MatShift(A,-RSVD->Disc.beta);CHKERRQ(ierr);
+		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n---- Discounting with beta = %g ----\n\n", RSVD->Disc.beta);CHKERRQ(ierr);
+	}
+
+	/*
+		Creates the KSP solver for R and R^* (only once), then factorizes the shifted operator
+		Since the nonzero pattern is unchanged, only the numerical factorization is redone
+		With a factor cache, the factors are restored from disk if this operator/frequency was factorized before
+		The right-hand sides are given to MUMPS distributed (ICNTL(20) = 10, MUMPS >= 5.3) unless set otherwise,
+		on the factor itself (again after a KSPReset() of the low-memory mode) rather than in the options database
+		A dense operator is factorized by LAPACK (getrf) instead of MUMPS
+	*/
+
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+
+	if (!RSVDM->ksp) {
+		ierr = KSPCreate(PETSC_COMM_WORLD,&RSVDM->ksp);CHKERRQ(ierr);
+		if (dirs->FactorCacheDir[0]) {
+			ierr = FactorCacheCreate(RSVD, dirs, A, RSVDM->ksp, &RSVDM->Cache);CHKERRQ(ierr);
+		} else {
+			ierr = KSPSetType(RSVDM->ksp,KSPPREONLY);CHKERRQ(ierr);
+			ierr = KSPGetPC(RSVDM->ksp, &pc);CHKERRQ(ierr);
+			ierr = PCSetType(pc, PCLU);CHKERRQ(ierr);
+			ierr = PCFactorSetMatSolverType(pc, dense ? MATSOLVERPETSC : MATSOLVERMUMPS);CHKERRQ(ierr);
+		}
+		ierr = KSPSetTolerances(RSVDM->ksp,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
+		ierr = KSPSetFromOptions(RSVDM->ksp);CHKERRQ(ierr);
+	}
+	ksp  = RSVDM->ksp;
+	ierr = KSPSetOperators(ksp,A,A);CHKERRQ(ierr);
+#if PETSC_PKG_MUMPS_VERSION_GE(5,3,0)
+	ierr = PetscOptionsHasName(NULL,NULL,"-mat_mumps_icntl_20",&set);CHKERRQ(ierr);
+	ierr = KSPGetPC(ksp,&pc);CHKERRQ(ierr);
+	ierr = PetscObjectTypeCompare((PetscObject)pc,PCLU,&islu);CHKERRQ(ierr);
+	if (!set && islu && !RSVDM->Cache) {
+		ierr = PCFactorSetUpMatSolverType(pc);CHKERRQ(ierr);
+		ierr = PCFactorGetMatrix(pc,&F);CHKERRQ(ierr);
+		ierr = MatFactorGetSolverType(F,&type);CHKERRQ(ierr);
+		ierr = PetscStrcmp(type,MATSOLVERMUMPS,&ismumps);CHKERRQ(ierr);
+		if (ismumps) ierr = MatMumpsSetIcntl(F,20,10);CHKERRQ(ierr);
+	}
+#endif
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_LU);CHKERRQ(ierr);
+	if (RSVDM->Cache) {
+		ierr = FactorCacheFactor(RSVDM->Cache, RSVDM->A_org, A, w, RSVD->Disc.DiscFlg ? RSVD->Disc.beta : 0., &hit);CHKERRQ(ierr);
+		if (RSVD->Display && hit) ierr = PetscPrintf(PETSC_COMM_WORLD,"LU factors restored from the factor cache\n");CHKERRQ(ierr);
+	}
+	if (RSVD->LowMemory) {
+		ierr = KSPGetPC(ksp,&pc);CHKERRQ(ierr);
+		ierr = PCSetReusePreconditioner(pc,PETSC_FALSE);CHKERRQ(ierr);
+	}
+	ierr = KSPSetUp(ksp);CHKERRQ(ierr);
+
+	/*
+		Low-memory mode: A_org is restored, A_org = -(shifted A_org) with its saved diagonal, and the
+		factors are kept for the solves of this frequency although the operator of the KSP has changed
+	*/
+
+	if (RSVD->LowMemory) {
+		ierr = MatScale(A, -1.);CHKERRQ(ierr);
+		ierr = MatDiagonalSet(A,RSVDM->Diag,INSERT_VALUES);CHKERRQ(ierr);
+		ierr = PCSetReusePreconditioner(pc,PETSC_TRUE);CHKERRQ(ierr);
+	}
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	hh   = (t2-t1)/3600;
+	mm   = (t2-t1-3600*hh)/60;
+	ss   = t2-t1-3600*hh-mm*60;
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** LU decomposition elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)RSVD->Threads[STAGE_LU], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode ReleaseOperator(RSVD_matrices *RSVDM, RSVD_vars *RSVD)
+{
+	/*
+		Low-memory mode: frees the LU factors once the last solve of a frequency is done, so that they are
+		not alive during the last SVD and the saving of the modes (the KSP keeps its type and options,
+		and the next frequency is factorized from scratch)
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	if (!RSVD->LowMemory || !RSVDM->ksp) PetscFunctionReturn(0);
+	ierr = KSPReset(RSVDM->ksp);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
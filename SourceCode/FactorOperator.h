@@ -0,0 +1,8 @@
+
+#ifndef FACTOROPERATOR_H
+#define FACTOROPERATOR_H
+
+PetscErrorCode FactorOperator(RSVD_matrices*, RSVD_vars*, Directories*, PetscReal);
+PetscErrorCode ReleaseOperator(RSVD_matrices*, RSVD_vars*);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <BlockLayout.h>
+#include <SharedMats.h>
+
+static PetscErrorCode SamePatternLocal(Mat A1, Mat A2, PetscBool *same)
+{
+	/*
+		Compares the local nonzero pattern (row pointers and column indices) of two sequential AIJ blocks
+		(block rows and block column indices for BAIJ blocks)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              n1, n2;
+	const PetscInt       *ia1, *ja1, *ia2, *ja2;
+	PetscBool             done1, done2;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatGetRowIJ(A1,0,PETSC_FALSE,PETSC_FALSE,&n1,&ia1,&ja1,&done1);CHKERRQ(ierr);
+	ierr = MatGetRowIJ(A2,0,PETSC_FALSE,PETSC_FALSE,&n2,&ia2,&ja2,&done2);CHKERRQ(ierr);
+	*same = (PetscBool) (done1 && done2 && n1 == n2 && ia1[n1] == ia2[n2]);
+	if (*same) ierr = PetscMemcmp(ia1,ia2,(n1+1)*sizeof(PetscInt),same);CHKERRQ(ierr);
+	if (*same) ierr = PetscMemcmp(ja1,ja2,ia1[n1]*sizeof(PetscInt),same);CHKERRQ(ierr);
+	ierr = MatRestoreRowIJ(A1,0,PETSC_FALSE,PETSC_FALSE,&n1,&ia1,&ja1,&done1);CHKERRQ(ierr);
+	ierr = MatRestoreRowIJ(A2,0,PETSC_FALSE,PETSC_FALSE,&n2,&ia2,&ja2,&done2);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode LoadOperator(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Directories *dirs, PetscInt iop)
+{
+	/*
+		Loads the iop-th operator of the sweep
+		The first operator defines the parallel layout; the following operators must share the
+		same nonzero pattern and are copied into A_org so that the shifted operator, ordering and
+		symbolic factorization built for the first one remain valid
+		For more than one operator, the results of each are saved in MainFolderDir/Operator<iop+1>/
+		For more than one configuration, the results of each are saved in <name>/ inside that folder
+		With BlockSize > 1 (or given by the .info file of the first operator if BlockSize = 0), the
+		operators are kept in block CSR (MATMPIBAIJ)
+		In batch mode, every operator is loaded anew on the group of ranks processing it (any nonzero
+		pattern, same size) and its folders were created beforehand by BatchSweep(), or wrapped from the
+		node-level shared memory (BatchShared)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscLogDouble        t1, t2;
+	PetscInt              hh, mm, ss, m, n, m_new, n_new, nco1, nco2, bs, ic, N;
+	PetscMPIInt           rank;
+	PetscViewer           fd;
+	Mat                   A_new, Ad1, Ao1, Ad2, Ao2;
+	const PetscInt       *colmap1, *colmap2;
+	PetscBool             same, same_d, same_o, set, baij;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscStrncpy(dirs->OperatorDir,dirs->OperatorList[iop],PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Loading the operator (%d/%d): %s%s\n",(int)iop+1,(int)RSVD->NumOps,dirs->RootDir,dirs->OperatorDir);CHKERRQ(ierr);
+
+	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->OperatorDir);CHKERRQ(ierr);
+
+	if (RSVD->Batch.Flg) {
+		ierr = MatDestroy(&RSVDM->A_org);CHKERRQ(ierr);
+		ierr = SharedMatsGetOperator(RSVDM->Shared, iop, &RSVDM->A_org);CHKERRQ(ierr);
+		if (!RSVDM->A_org) ierr = LoadSparseMat(RSVD, dirs->IO_dir, &RSVDM->A_org);CHKERRQ(ierr);
+		ierr = MatGetSize(RSVDM->A_org,&N,NULL);CHKERRQ(ierr);
+		if (RSVD->N && N != RSVD->N) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Operator %s must have the same size as the previous ones (%d)",dirs->OperatorList[iop],(int)RSVD->N);
+		RSVD->N = N;
+	} else if (iop == 0) {
+
+		/*
+			Block size from the .info file (-matload_block_size) read when the viewer is opened
+		*/
+
+		if (RSVD->BlockSize == 0) {
+			ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
+			ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+			ierr = PetscOptionsGetInt(NULL,NULL,"-matload_block_size",&RSVD->BlockSize,&set);CHKERRQ(ierr);
+			if (!set || RSVD->BlockSize < 1) RSVD->BlockSize = 1;
+		}
+		ierr = LoadSparseMat(RSVD, dirs->IO_dir, &RSVDM->A_org);CHKERRQ(ierr);
+		ierr = MatGetSize(RSVDM->A_org,&RSVD->N,NULL);CHKERRQ(ierr);
+		ierr = GetBlockSize(RSVD, RSVD->N, &bs);CHKERRQ(ierr);
+		if (bs != RSVD->BlockSize) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"The operator size N = %d must be a multiple of 'BlockSize' = %d", (int)RSVD->N, (int)RSVD->BlockSize);
+		if (RSVD->Display && bs > 1) ierr = PetscPrintf(PETSC_COMM_WORLD,"Block CSR storage with block size %d\n", (int)bs);CHKERRQ(ierr);
+	} else {
+		ierr = MatGetLocalSize(RSVDM->A_org,&m,&n);CHKERRQ(ierr);
+		ierr = LoadSparseMat(RSVD, dirs->IO_dir, &A_new);CHKERRQ(ierr);
+		ierr = MatGetLocalSize(A_new,&m_new,&n_new);CHKERRQ(ierr);
+		same = (PetscBool) (m == m_new && n == n_new);
+		ierr = MPI_Allreduce(MPI_IN_PLACE,&same,1,MPIU_BOOL,MPI_LAND,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		if (!same) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Operator %s must have the same size as %s",dirs->OperatorList[iop],dirs->OperatorList[0]);
+
+		/*
+			Verifies that the nonzero pattern matches the first operator
+			(block pattern and block column map in block CSR)
+		*/
+
+		ierr = PetscObjectTypeCompare((PetscObject)RSVDM->A_org,MATMPIBAIJ,&baij);CHKERRQ(ierr);
+		if (baij) {
+			ierr = MatMPIBAIJGetSeqBAIJ(RSVDM->A_org,&Ad1,&Ao1,&colmap1);CHKERRQ(ierr);
+			ierr = MatMPIBAIJGetSeqBAIJ(A_new,&Ad2,&Ao2,&colmap2);CHKERRQ(ierr);
+		} else {
+			ierr = MatMPIAIJGetSeqAIJ(RSVDM->A_org,&Ad1,&Ao1,&colmap1);CHKERRQ(ierr);
+			ierr = MatMPIAIJGetSeqAIJ(A_new,&Ad2,&Ao2,&colmap2);CHKERRQ(ierr);
+		}
+		ierr = SamePatternLocal(Ad1,Ad2,&same_d);CHKERRQ(ierr);
+		ierr = SamePatternLocal(Ao1,Ao2,&same_o);CHKERRQ(ierr);
+		ierr = MatGetSize(Ao1,NULL,&nco1);CHKERRQ(ierr);
+		ierr = MatGetSize(Ao2,NULL,&nco2);CHKERRQ(ierr);
+		same = (PetscBool) (same_d && same_o && nco1 == nco2);
+		if (same) ierr = PetscMemcmp(colmap1,colmap2,(nco1/RSVD->BlockSize)*sizeof(PetscInt),&same);CHKERRQ(ierr);
+		ierr = MPI_Allreduce(MPI_IN_PLACE,&same,1,MPIU_BOOL,MPI_LAND,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		if (!same) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Operator %s must have the same nonzero pattern as %s",dirs->OperatorList[iop],dirs->OperatorList[0]);
+
+		ierr = MatCopy(A_new,RSVDM->A_org,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+		ierr = MatDestroy(&A_new);CHKERRQ(ierr);
+	}
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	hh   = (t2-t1)/3600;
+	mm   = (t2-t1-3600*hh)/60;
+	ss   = t2-t1-3600*hh-mm*60;
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Loading the operator elapsed time (N = %d) = %02d:%02d:%02d\n", (int)RSVD->N, (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+
+	/*
+		Creates a subfolder for the results of this operator, and one per configuration in it
+	*/
+
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
+	if (RSVD->NumOps > 1) {
+		ierr = PetscSNPrintf((char*)&dirs->FolderDir,PETSC_MAX_PATH_LEN,"%sOperator%d/",dirs->MainFolderDir,(int)iop+1);CHKERRQ(ierr);
+		if (!rank && !RSVD->Batch.Flg && !RSVD->Plan.DryRun) {
+			ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"mkdir %s",dirs->FolderDir);CHKERRQ(ierr);
+			ierr = system(dirs->IO_dir);CHKERRQ(ierr);
+		}
+		ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	}
+	if (RSVD->NumConfigs > 1) {
+		if (!rank && !RSVD->Batch.Flg && !RSVD->Plan.DryRun) {
+			for (ic=0; ic<RSVD->NumConfigs; ic++) {
+				ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"mkdir %s%s/",dirs->FolderDir,dirs->ConfigList[ic]);CHKERRQ(ierr);
+				ierr = system(dirs->IO_dir);CHKERRQ(ierr);
+			}
+		}
+		ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
@@ -0,0 +1,7 @@
+
+#ifndef LOADOPERATOR_H
+#define LOADOPERATOR_H
+
+PetscErrorCode LoadOperator(RSVD_matrices*, RSVD_vars*, Directories*, PetscInt);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,380 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <FactorOperator.h>
+#include <SetupFreqGrid.h>
+
+/*
+	Multi-shift Krylov solver of a window of frequencies
+
+	The shifted operators of the window differ from the one of its central frequency w_c only by a
+	multiple of the identity, (i w I - A) = (i w_c I - A) + i (w - w_c) I, and so do their transposes.
+	With T = (i w_c I - A)^{-1} (LU of FactorOperator()), every system is solved in the preconditioned
+	form (I + i delta T) x = T b, delta = w - w_c, whose Krylov spaces K(T, T b) do not depend on delta.
+	One Arnoldi basis of T thus serves every frequency of the window, each one with its own small
+	Hessenberg least-squares problem (GMRES) and its own convergence check.
+	The first action of every frequency starts from the same random matrix, so that its solutions for the
+	whole window are computed at once (shared), while the other solves are single-shift GMRES runs with
+	the same preconditioner. The k columns are processed in lockstep, so that every Arnoldi step applies T
+	to a block of k vectors with one (MUMPS) multiple right-hand side solve.
+*/
+
+struct _p_MultiShift {
+	PetscInt              Window, MaxIt;                  /* frequencies per window and max dimension of the basis */
+	PetscReal             Tol;                            /* relative tolerance of the preconditioned residual */
+	PetscInt              iw0, nw, cur;                   /* first frequency and size of the window, current frequency in it */
+	PetscObjectState      state;                          /* state of A_org at the factorization (a new operator starts a new window) */
+	PetscReal            *delta;                          /* offsets w - w_c of the frequencies of the window */
+	KSP                   ksp;                            /* LU at the central frequency */
+	PetscBool             shared;                         /* the right-hand side is the one shared by the window (first action) */
+	PetscBool             filled, transpose;              /* the shared solutions are computed, and for which system */
+	Mat                  *cache;                          /* shared solutions of the window (each one destroyed when used) */
+	PetscInt              windows, solves, steps;         /* statistics */
+};
+
+static PetscErrorCode ApplyT(MultiShift ms, Mat B, Mat X, PetscBool transpose)
+{
+	/*
+		X = T B or X = T^T B with the LU at the central frequency
+	*/
+
+	PetscErrorCode        ierr;
+#if !PETSC_VERSION_GE(3,20,0)
+	Vec                   b, x;
+	PetscInt              j, nv;
+#endif
+
+	PetscFunctionBeginUser;
+
+	if (!transpose) {
+		ierr = KSPMatSolve(ms->ksp, B, X);CHKERRQ(ierr);
+	} else {
+#if PETSC_VERSION_GE(3,20,0)
+		ierr = KSPMatSolveTranspose(ms->ksp, B, X);CHKERRQ(ierr);
+#else
+		ierr = MatGetSize(B,NULL,&nv);CHKERRQ(ierr);
+		for (j=0; j<nv; j++) {
+			ierr = MatDenseGetColumnVecRead(B, j, &b);CHKERRQ(ierr);
+			ierr = MatDenseGetColumnVecWrite(X, j, &x);CHKERRQ(ierr);
+			ierr = KSPSolveTranspose(ms->ksp, b, x);CHKERRQ(ierr);
+			ierr = MatDenseRestoreColumnVecWrite(X, j, &x);CHKERRQ(ierr);
+			ierr = MatDenseRestoreColumnVecRead(B, j, &b);CHKERRQ(ierr);
+		}
+#endif
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode MultiShiftGMRES(MultiShift ms, RSVD_vars *RSVD, Mat B, PetscInt ns, const PetscReal *delta, Mat *X, PetscBool transpose)
+{
+	/*
+		Solves (I + i delta_s T) X_s = T B for the ns offsets delta_s with one Arnoldi basis per column of B
+		The basis vectors of all columns are the columns of the dense matrices V[0..m]; the Hessenberg matrix
+		H_c of column c is shared by the shifts, which only keep their Givens rotations and rotated
+		right-hand side g, so that the residual of every (shift, column) pair is known at every step
+		The pair converges when |g_{j+1}| <= Tol |T b|, its solution is built at the end from its first conv steps
+	*/
+
+	PetscErrorCode        ierr;
+	Mat                  *V;
+	Vec                  *vc, wv, xc;
+	PetscInt              m = ms->MaxIt, k, i, j, jj, c, s, p, n, nsteps, nconv = 0, nfail = 0, *conv;
+	PetscScalar          *H, *hc, *sn, *g, *col, *R, *y, t;
+	PetscReal            *cs, *beta, nrm, a, r, res, resmax = 0;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatGetSize(B,NULL,&k);CHKERRQ(ierr);
+	ierr = PetscCalloc1(m+1,&V);CHKERRQ(ierr);
+	ierr = PetscMalloc5(k*(m+1)*m,&H,ns*k*m,&sn,ns*k*(m+1),&g,ns*k*m,&cs,ns*k,&conv);CHKERRQ(ierr);
+	ierr = PetscMalloc5(m+2,&col,m*m,&R,m+1,&y,m+1,&vc,k,&beta);CHKERRQ(ierr);
+
+	/*
+		Initial vectors T b / |T b|
+	*/
+
+	ierr = MatDuplicate(B,MAT_DO_NOT_COPY_VALUES,&V[0]);CHKERRQ(ierr);
+	ierr = ApplyT(ms, B, V[0], transpose);CHKERRQ(ierr);
+	ierr = MatGetColumnNorms(V[0],NORM_2,beta);CHKERRQ(ierr);
+	for (c=0; c<k; c++) {
+		if (beta[c] > 0) {
+			ierr = MatDenseGetColumnVecWrite(V[0],c,&wv);CHKERRQ(ierr);
+			ierr = VecScale(wv,1./beta[c]);CHKERRQ(ierr);
+			ierr = MatDenseRestoreColumnVecWrite(V[0],c,&wv);CHKERRQ(ierr);
+		}
+		for (s=0; s<ns; s++) {
+			p        = s*k+c;
+			conv[p]  = beta[c] > 0 ? -1 : 0;
+			nconv   += beta[c] > 0 ? 0 : 1;
+			g[p*(m+1)] = beta[c];
+		}
+	}
+
+	/*
+		Arnoldi steps until every pair converged
+	*/
+
+	for (j=0; j<m && nconv<ns*k; j++) {
+
+		ierr = MatDuplicate(B,MAT_DO_NOT_COPY_VALUES,&V[j+1]);CHKERRQ(ierr);
+		ierr = ApplyT(ms, V[j], V[j+1], transpose);CHKERRQ(ierr);
+
+		for (c=0; c<k; c++) {
+
+			/*
+				Classical Gram-Schmidt with one reorthogonalization against the basis of this column
+			*/
+
+			hc   = &H[c*(m+1)*m + j*(m+1)];
+			for (i=0; i<=j; i++) ierr = MatDenseGetColumnVecRead(V[i],c,&vc[i]);CHKERRQ(ierr);
+			ierr = MatDenseGetColumnVecWrite(V[j+1],c,&wv);CHKERRQ(ierr);
+			ierr = VecMDot(wv,j+1,vc,hc);CHKERRQ(ierr);
+			for (i=0; i<=j; i++) col[i] = -hc[i];
+			ierr = VecMAXPY(wv,j+1,col,vc);CHKERRQ(ierr);
+			ierr = VecMDot(wv,j+1,vc,col);CHKERRQ(ierr);
+			for (i=0; i<=j; i++) {
+				hc[i] += col[i];
+				col[i] = -col[i];
+			}
+			ierr = VecMAXPY(wv,j+1,col,vc);CHKERRQ(ierr);
+			ierr = VecNorm(wv,NORM_2,&nrm);CHKERRQ(ierr);
+			hc[j+1] = nrm;
+			if (nrm > 0) ierr = VecScale(wv,1./nrm);CHKERRQ(ierr);
+			ierr = MatDenseRestoreColumnVecWrite(V[j+1],c,&wv);CHKERRQ(ierr);
+			for (i=0; i<=j; i++) ierr = MatDenseRestoreColumnVecRead(V[i],c,&vc[i]);CHKERRQ(ierr);
+
+			/*
+				Column j of I + i delta_s H_c, rotated by the previous rotations of the pair, and its new rotation
+			*/
+
+			for (s=0; s<ns; s++) {
+				p = s*k+c;
+				if (conv[p] >= 0) continue;
+				for (i=0; i<=j+1; i++) col[i] = PETSC_i*delta[s]*hc[i];
+				col[j] += 1;
+				for (i=0; i<j; i++) {
+					t        = cs[p*m+i]*col[i] + sn[p*m+i]*col[i+1];
+					col[i+1] = -PetscConj(sn[p*m+i])*col[i] + cs[p*m+i]*col[i+1];
+					col[i]   = t;
+				}
+				a = PetscAbsScalar(col[j]);
+				r = PetscSqrtReal(a*a + PetscAbsScalar(col[j+1])*PetscAbsScalar(col[j+1]));
+				if (a == 0) {
+					cs[p*m+j] = 0;
+					sn[p*m+j] = 1;
+				} else {
+					cs[p*m+j] = a/r;
+					sn[p*m+j] = col[j]/a*PetscConj(col[j+1])/r;
+				}
+				g[p*(m+1)+j+1] = -PetscConj(sn[p*m+j])*g[p*(m+1)+j];
+				g[p*(m+1)+j]   = cs[p*m+j]*g[p*(m+1)+j];
+				if (PetscAbsScalar(g[p*(m+1)+j+1]) <= ms->Tol*beta[c]) {
+					conv[p] = j+1;
+					nconv++;
+				}
+			}
+		}
+	}
+	nsteps = j;
+
+	/*
+		Solutions X_s(:,c) = V y, with R y = g (R rebuilt from H_c and the rotations of the pair)
+	*/
+
+	for (s=0; s<ns; s++) {
+		for (c=0; c<k; c++) {
+			p = s*k+c;
+			n = conv[p] >= 0 ? conv[p] : nsteps;
+			if (conv[p] < 0) {
+				res    = PetscAbsScalar(g[p*(m+1)+n])/beta[c];
+				resmax = PetscMax(resmax,res);
+				nfail++;
+			}
+			for (jj=0; jj<n; jj++) {
+				hc = &H[c*(m+1)*m + jj*(m+1)];
+				for (i=0; i<=jj+1; i++) col[i] = PETSC_i*delta[s]*hc[i];
+				col[jj] += 1;
+				for (i=0; i<=jj; i++) {
+					t        = cs[p*m+i]*col[i] + sn[p*m+i]*col[i+1];
+					col[i+1] = -PetscConj(sn[p*m+i])*col[i] + cs[p*m+i]*col[i+1];
+					col[i]   = t;
+				}
+				for (i=0; i<=jj; i++) R[i+jj*m] = col[i];
+			}
+			for (i=n-1; i>=0; i--) {
+				t = g[p*(m+1)+i];
+				for (jj=i+1; jj<n; jj++) t -= R[i+jj*m]*y[jj];
+				y[i] = t/R[i+i*m];
+			}
+			ierr = MatDenseGetColumnVecWrite(X[s],c,&xc);CHKERRQ(ierr);
+			ierr = VecSet(xc,0.);CHKERRQ(ierr);
+			if (n) {
+				for (i=0; i<n; i++) ierr = MatDenseGetColumnVecRead(V[i],c,&vc[i]);CHKERRQ(ierr);
+				ierr = VecMAXPY(xc,n,y,vc);CHKERRQ(ierr);
+				for (i=0; i<n; i++) ierr = MatDenseRestoreColumnVecRead(V[i],c,&vc[i]);CHKERRQ(ierr);
+			}
+			ierr = MatDenseRestoreColumnVecWrite(X[s],c,&xc);CHKERRQ(ierr);
+		}
+	}
+
+	for (i=0; i<=m; i++) {
+		ierr = MatDestroy(&V[i]);CHKERRQ(ierr);
+	}
+	ierr = PetscFree(V);CHKERRQ(ierr);
+	ierr = PetscFree5(H,sn,g,cs,conv);CHKERRQ(ierr);
+	ierr = PetscFree5(col,R,y,vc,beta);CHKERRQ(ierr);
+
+	ms->solves++;
+	ms->steps += nsteps;
+	if (RSVD->Display == 2) ierr = PetscPrintf(PETSC_COMM_WORLD,"Multi-shift GMRES: %d frequencies x %d columns, %d steps\n", (int)ns, (int)k, (int)nsteps);CHKERRQ(ierr);
+	if (nfail) {
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: multi-shift GMRES did not converge for %d of %d (frequency, column) pairs in %d steps (max relative residual %g). "
+				"Increase 'MultiShiftMaxIt' or reduce 'MultiShiftWindow'\n", (int)nfail, (int)(ns*k), (int)nsteps, (double)resmax);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode MultiShiftCreate(RSVD_vars *RSVD, MultiShift *ms)
+{
+	/*
+		Creates the multi-shift solver (windows of MultiShiftWindow frequencies)
+	*/
+
+	PetscErrorCode        ierr;
+	MultiShift            s;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscNew(&s);CHKERRQ(ierr);
+	s->Window = RSVD->MShift.Window;
+	s->MaxIt  = RSVD->MShift.MaxIt;
+	s->Tol    = RSVD->MShift.Tol;
+	s->iw0    = -1;
+	ierr = PetscMalloc1(s->Window,&s->delta);CHKERRQ(ierr);
+	ierr = PetscCalloc1(s->Window,&s->cache);CHKERRQ(ierr);
+
+	*ms = s;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode MultiShiftSetFrequency(MultiShift ms, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Directories *dirs, PetscInt iw)
+{
+	/*
+		Selects the iw-th frequency. The first frequency of a window (or of a new operator) factorizes the
+		shifted operator at the central frequency of the window, which replaces the LU of its frequencies
+	*/
+
+	PetscErrorCode        ierr;
+	PetscObjectState      state;
+	PetscReal             w0, w1, wc, w;
+	PetscInt              iw0, s;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscObjectStateGet((PetscObject)RSVDM->A_org,&state);CHKERRQ(ierr);
+	iw0  = (iw/ms->Window)*ms->Window;
+	if (iw0 != ms->iw0 || state != ms->state) {
+		for (s=0; s<ms->Window; s++) {
+			ierr = MatDestroy(&ms->cache[s]);CHKERRQ(ierr);
+		}
+		ms->iw0    = iw0;
+		ms->nw     = PetscMin(ms->Window,RSVD->Nw-iw0);
+		ms->state  = state;
+		ms->filled = PETSC_FALSE;
+		ierr = GetFrequency(RSVD, iw0, &w0);CHKERRQ(ierr);
+		ierr = GetFrequency(RSVD, iw0+ms->nw-1, &w1);CHKERRQ(ierr);
+		wc   = (w0 + w1)/2;
+		for (s=0; s<ms->nw; s++) {
+			ierr = GetFrequency(RSVD, iw0+s, &w);CHKERRQ(ierr);
+			ms->delta[s] = w - wc;
+		}
+		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Multi-shift window iw = %d to %d, LU at the central frequency w = %g\n", (int)iw0+1, (int)(iw0+ms->nw), wc);CHKERRQ(ierr);
+		ierr = FactorOperator(RSVDM, RSVD, dirs, wc);CHKERRQ(ierr);
+		ms->ksp = RSVDM->ksp;
+		ms->windows++;
+	}
+	ms->cur = iw - iw0;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode MultiShiftSetShared(MultiShift ms, PetscBool shared)
+{
+	/*
+		Marks the next solves as the ones of the right-hand side shared by the window (first action)
+	*/
+
+	PetscFunctionBeginUser;
+
+	if (ms) ms->shared = shared;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode MultiShiftMatSolve(MultiShift ms, RSVD_vars *RSVD, Mat B, Mat X, PetscBool transpose)
+{
+	/*
+		Solves (i w I - A) X = B, or its transpose, at the current frequency
+		For the shared right-hand side, the first frequency of the window solves for all of them
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              s;
+
+	PetscFunctionBeginUser;
+
+	if (ms->shared && ms->nw > 1) {
+		if (!ms->filled || ms->transpose != transpose) {
+			for (s=0; s<ms->nw; s++) {
+				ierr = MatDestroy(&ms->cache[s]);CHKERRQ(ierr);
+				ierr = MatDuplicate(B,MAT_DO_NOT_COPY_VALUES,&ms->cache[s]);CHKERRQ(ierr);
+			}
+			ierr = MultiShiftGMRES(ms, RSVD, B, ms->nw, ms->delta, ms->cache, transpose);CHKERRQ(ierr);
+			ms->filled    = PETSC_TRUE;
+			ms->transpose = transpose;
+		}
+		if (ms->cache[ms->cur]) {
+			ierr = MatCopy(ms->cache[ms->cur],X,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+			ierr = MatDestroy(&ms->cache[ms->cur]);CHKERRQ(ierr);
+			PetscFunctionReturn(0);
+		}
+	}
+	ierr = MultiShiftGMRES(ms, RSVD, B, 1, &ms->delta[ms->cur], &X, transpose);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode MultiShiftDestroy(RSVD_vars *RSVD, MultiShift *ms)
+{
+	/*
+		Prints the statistics of the multi-shift solver and frees it
+	*/
+
+	PetscErrorCode        ierr=0;
+	MultiShift            s = *ms;
+	PetscInt              i;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Multi-shift GMRES: %d LU factorizations (windows), %d block solves, %.1f Krylov steps per solve\n\n",
+			(int)s->windows, (int)s->solves, s->solves ? (double)s->steps/s->solves : 0.);CHKERRQ(ierr);
+	for (i=0; i<s->Window; i++) {
+		ierr = MatDestroy(&s->cache[i]);CHKERRQ(ierr);
+	}
+	ierr = PetscFree(s->cache);CHKERRQ(ierr);
+	ierr = PetscFree(s->delta);CHKERRQ(ierr);
+	ierr = PetscFree(*ms);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
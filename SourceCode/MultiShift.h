@@ -0,0 +1,11 @@
+
+#ifndef MULTISHIFT_H
+#define MULTISHIFT_H
+
+PetscErrorCode MultiShiftCreate(RSVD_vars*, MultiShift*);
+PetscErrorCode MultiShiftSetFrequency(MultiShift, RSVD_matrices*, RSVD_vars*, Directories*, PetscInt);
+PetscErrorCode MultiShiftSetShared(MultiShift, PetscBool);
+PetscErrorCode MultiShiftMatSolve(MultiShift, RSVD_vars*, Mat, Mat, PetscBool);
+PetscErrorCode MultiShiftDestroy(RSVD_vars*, MultiShift*);
+
+#endif
\ No newline at end of file
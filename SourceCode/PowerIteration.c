@@ -1,39 +1,163 @@
-
 #include <petscksp.h>
+#include <slepcbv.h>
+#include <petscblaslapack.h>
 #include <Variables.h>
 #include <QRDecomposition.h>
 #include <AdjointAction.h>
 #include <DirectAction.h>
+#include <SetupFreqGrid.h>
+
+static PetscErrorCode FactorSingularValues(Mat R, PetscInt k, PetscReal *s)
+{
+	/*
+		Singular values of the k x k triangular factor of a QR decomposition (LAPACK, on a copy)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscScalar          *r, *a, *work;
+	PetscReal            *rwork;
+	PetscBLASInt          bk, lwork, info, one = 1;
+
+	PetscFunctionBeginUser;
+
+	bk    = (PetscBLASInt)k;
+	lwork = 5*bk;
+	ierr  = PetscMalloc3(k*k,&a,5*k,&work,5*k,&rwork);CHKERRQ(ierr);
+	ierr  = MatDenseGetArray(R,&r);CHKERRQ(ierr);
+	ierr  = PetscArraycpy(a,r,k*k);CHKERRQ(ierr);
+	ierr  = MatDenseRestoreArray(R,&r);CHKERRQ(ierr);
+	LAPACKgesvd_("N","N",&bk,&bk,a,&bk,s,NULL,&one,NULL,&one,work,&lwork,rwork,&info);
+	if (info) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_LIB,"LAPACK gesvd failed with info = %d", (int)info);
+	ierr  = PetscFree3(a,work,rwork);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode RestoreFromQR(Mat V, Mat R)
+{
+	/*
+		V <- V R, i.e., undoes the orthonormalization V = Q R
+	*/
+
+	PetscErrorCode        ierr;
+	BV                    bv;
+	Mat                   T;
+	PetscInt              k;
+
+	PetscFunctionBeginUser;
 
-PetscErrorCode PowerIteration(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight)
+	ierr = MatGetSize(V,NULL,&k);CHKERRQ(ierr);
+	ierr = BVCreateFromMat(V,&bv);CHKERRQ(ierr);
+	ierr = BVSetType(bv,BVVECS);CHKERRQ(ierr);
+	ierr = BVMultInPlace(bv,R,0,k);CHKERRQ(ierr);
+	ierr = BVCreateMat(bv,&T);CHKERRQ(ierr);
+	ierr = MatCopy(T,V,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+	ierr = MatDestroy(&T);CHKERRQ(ierr);
+	ierr = BVDestroy(&bv);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode PowerIteration(KSP ksp, RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, PetscInt *rounds, PetscReal *change)
 {
 	/*
-		Performs power iteration for q times 
+		Performs power iteration for q times
+		The order of the direct and adjoint actions is swapped if the sketch starts from the output space
+		Adaptive mode (PowerTol > 0): the R factors of the two QR decompositions of a round give estimates of
+		the gains, the singular values of R applied to an orthonormal basis. From the second round on, the
+		leading SaveModesNum estimates of the first QR are compared with the ones of the second QR of the
+		previous round, and the iteration stops (V = Q R restored) once their max relative change is below
+		PowerTol, so q becomes the max number of rounds. The rounds used and the last change are returned
 	*/
 
 	PetscErrorCode        ierr;
-	PetscInt              iq;
+	PetscInt              iq, i, nc;
+	Mat                   R1 = NULL, R2 = NULL;
+	PetscReal            *s1 = NULL, *s2 = NULL;
+	PetscBool             adaptive = (PetscBool) (RSVD->PowerTol > 0);
 
 	PetscFunctionBeginUser;
 
+	*rounds = RSVD->q;
+	*change = -1;
+	nc      = PetscMax(1,PetscMin(RSVD->SaveModesNum,RSVD->k));
+	if (adaptive) {
+		ierr = MatCreateSeqDense(PETSC_COMM_SELF,RSVD->k,RSVD->k,NULL,&R1);CHKERRQ(ierr);
+		ierr = MatCreateSeqDense(PETSC_COMM_SELF,RSVD->k,RSVD->k,NULL,&R2);CHKERRQ(ierr);
+		ierr = PetscMalloc2(RSVD->k,&s1,RSVD->k,&s2);CHKERRQ(ierr);
+	}
+
 	for (iq=0; iq<RSVD->q; iq++) {
 
 		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n******** Inside power iteration, %d/%d *******\n\n",(int)iq+1,(int)RSVD->q);CHKERRQ(ierr);
 
-		ierr = QRDecomposition(RSVD, RSVDM->Y_hat);CHKERRQ(ierr);
-		ierr = AdjointAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
-		ierr = MatConjugate(RSVDM->Y_hat);CHKERRQ(ierr);
-		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n");CHKERRQ(ierr);
-		ierr = QRDecomposition(RSVD, RSVDM->Y_hat);CHKERRQ(ierr);
-		ierr = DirectAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
-		
+		/*
+			The first QR of the first round follows the random matrix, so its factor is not an estimate
+		*/
+
+		ierr = QRDecomposition(RSVD, RSVDM->Y_hat, R1);CHKERRQ(ierr);
+		if (adaptive && iq > 0) {
+			ierr = FactorSingularValues(R1, RSVD->k, s1);CHKERRQ(ierr);
+			for (i=0, *change=0; i<nc; i++) *change = PetscMax(*change,PetscAbsReal(s1[i] - s2[i])/PetscMax(s1[i],PETSC_MACHINE_EPSILON*s1[0]));
+			if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Relative change of the %d leading gains = %g\n", (int)nc, (double)*change);CHKERRQ(ierr);
+			if (*change < RSVD->PowerTol) {
+				ierr = RestoreFromQR(RSVDM->Y_hat, R1);CHKERRQ(ierr);
+				*rounds = iq;
+				break;
+			}
+		}
+		if (RSVD->AdjointFirst) {
+			ierr = DirectAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+			if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n");CHKERRQ(ierr);
+			ierr = QRDecomposition(RSVD, RSVDM->Y_hat, R2);CHKERRQ(ierr);
+			ierr = AdjointAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+		} else {
+			ierr = AdjointAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+			if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n");CHKERRQ(ierr);
+			ierr = QRDecomposition(RSVD, RSVDM->Y_hat, R2);CHKERRQ(ierr);
+			ierr = DirectAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+		}
+		if (adaptive) ierr = FactorSingularValues(R2, RSVD->k, s2);CHKERRQ(ierr);
+
 	}
 
-	if (RSVD->q > 0 && RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n******** Power iteration DONE! *************\n");CHKERRQ(ierr);
+	if (RSVD->q > 0 && RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n******** Power iteration DONE! (%d/%d rounds) *************\n",(int)*rounds,(int)RSVD->q);CHKERRQ(ierr);
+
+	ierr = MatDestroy(&R1);CHKERRQ(ierr);
+	ierr = MatDestroy(&R2);CHKERRQ(ierr);
+	ierr = PetscFree2(s1,s2);CHKERRQ(ierr);
 
 	PetscFunctionReturn(0);
-	
+
 }
 
+PetscErrorCode LogPowerRounds(RSVD_vars *RSVD, Directories *dirs, PetscInt iw, PetscInt rounds, PetscReal change)
+{
+	/*
+		Writes the power iteration rounds of the iw-th frequency to FolderDir/PowerRounds_iw<iw+1>.csv (adaptive mode)
+		One file per frequency, as for the gains, since the frequencies of an operator may be shared among
+		the groups of the batch mode
+		The change is -1 if no convergence test was made (q < 2)
+	*/
 
+	PetscErrorCode        ierr;
+	PetscReal             w;
+	FILE                 *fp;
+	char                  filename[PETSC_MAX_PATH_LEN];
+
+	PetscFunctionBeginUser;
 
+	if (RSVD->PowerTol <= 0 || RSVD->InMemory) PetscFunctionReturn(0);
+
+	ierr = GetFrequency(RSVD, iw, &w);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(filename,PETSC_MAX_PATH_LEN,"%sPowerRounds_iw%d.csv",dirs->FolderDir,(int)iw+1);CHKERRQ(ierr);
+	ierr = PetscFOpen(PETSC_COMM_WORLD,filename,"w",&fp);CHKERRQ(ierr);
+	ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"iw,w,rounds,max_rounds,change\n");CHKERRQ(ierr);
+	ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"%d,%.10g,%d,%d,%.6g\n",(int)iw+1,(double)w,(int)rounds,(int)RSVD->q,(double)change);CHKERRQ(ierr);
+	ierr = PetscFClose(PETSC_COMM_WORLD,fp);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
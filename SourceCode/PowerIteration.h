@@ -2,6 +2,7 @@
 #ifndef POWERITERATION_H
 #define POWERITERATION_H
 
-PetscErrorCode PowerIteration(KSP, RSVD_matrices*, RSVD_vars*, Weight_matrices*);
+PetscErrorCode PowerIteration(KSP, RSVD_matrices*, RSVD_vars*, Weight_matrices*, PetscInt*, PetscReal*);
+PetscErrorCode LogPowerRounds(RSVD_vars*, Directories*, PetscInt, PetscInt, PetscReal);
 
 #endif
\ No newline at end of file
@@ -1,5 +1,5 @@
 
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
 #include <SetupFreqGrid.h>
 #include <ReadUserInput.h>
@@ -7,18 +7,20 @@
 #include <CreateResultsDir.h>
 #include <ReadWeightMats.h>
 #include <SaveInputVarsCopy.h>
+#include <LoadOperator.h>
+#include <ReadWeightInput.h>
+#include <SyntheticOperator.h>
 
-PetscErrorCode PreProcessing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Directories *dirs)
+PetscErrorCode PreProcessing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices **Weight, Directories *dirs)
 {
 
 	/*
 		Loading the operator, weight matrices, and creating the output directory
+		Weight is allocated here as an array of NumConfigs input/output configurations (freed by the caller)
 	*/  
 
 	PetscErrorCode        ierr;
-	PetscLogDouble        t1, t2;
-	PetscInt              hh, mm, ss;
-	PetscViewer           fd;
+	PetscInt              ic;
 
 	PetscFunctionBeginUser;
 
@@ -26,22 +28,21 @@ PetscErrorCode PreProcessing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matri
 		Reads in user input parameters
 	*/
 
-	ierr = ReadUserInput(RSVD, Weight, dirs);CHKERRQ(ierr);
+	ierr = ReadUserInput(RSVD, dirs);CHKERRQ(ierr);
+	ierr = PetscCalloc1(RSVD->NumConfigs,Weight);CHKERRQ(ierr);
 
 	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*******************************************\n"
 			"************** Problem info ***************\n*******************************************\n\n");CHKERRQ(ierr);
 
 	/*
-		Creates a folder for the results
+		Creates a folder for the results and saves a copy of the input variables in it
+		A dry run saves nothing, so it leaves no results folder behind
 	*/
 
-	ierr = CreateResultsDir(dirs, "RSVDLU_ResolventModes_");CHKERRQ(ierr); 
-
-	/*
-		Saves a copy of the input variables in the results folder
-	*/
-
-	ierr = SaveInputVarsCopy(dirs);CHKERRQ(ierr);
+	if (!RSVD->Plan.DryRun) {
+		ierr = CreateResultsDir(dirs, "RSVDLU_ResolventModes_");CHKERRQ(ierr); 
+		ierr = SaveInputVarsCopy(dirs);CHKERRQ(ierr);
+	}
 
 	/*
 		Initializes the time-stepping variables
@@ -50,30 +51,31 @@ PetscErrorCode PreProcessing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matri
 	ierr = SetupFreqGrid(RSVD);CHKERRQ(ierr);
 
 	/*
-		Loads the operator
+		Loads the (first) operator, generated first if a synthetic operator is requested (BenchGrid)
+		In batch mode, the operators and weight matrices are loaded by every group in BatchSweep()
 	*/
 
-	ierr = PetscTime(&t1);CHKERRQ(ierr);
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Loading the operator: %s%s\n",dirs->RootDir,dirs->OperatorDir);CHKERRQ(ierr);
-
-	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->OperatorDir);CHKERRQ(ierr);
-	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
-	ierr = MatCreate(PETSC_COMM_WORLD,&RSVDM->A_org);CHKERRQ(ierr);
-	ierr = MatSetType(RSVDM->A_org,MATMPIAIJ);CHKERRQ(ierr);
-	ierr = MatLoad(RSVDM->A_org,fd);CHKERRQ(ierr);
-	ierr = MatGetSize(RSVDM->A_org,&RSVD->N,NULL);CHKERRQ(ierr);
-
-	ierr = PetscTime(&t2);CHKERRQ(ierr);
-	hh   = (t2-t1)/3600;
-	mm   = (t2-t1-3600*hh)/60;
-	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Loading the operator elapsed time (N = %d) = %02d:%02d:%02d\n", (int)RSVD->N, (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Bench.NumGrid) ierr = SyntheticOperator(RSVD, dirs);CHKERRQ(ierr);
+	RSVDM->A_org  = NULL;
+	if (!RSVD->Batch.Flg) ierr = LoadOperator(RSVDM, RSVD, dirs, 0);CHKERRQ(ierr);
+	RSVDM->A      = NULL;
+	RSVDM->ksp    = NULL;
+	RSVDM->Cache  = NULL;
+	RSVDM->MS     = NULL;
+	RSVDM->Shared = NULL;
+	RSVDM->Diag   = NULL;
+	if (RSVD->LowMemory) ierr = PetscMemorySetGetMaximumUsage();CHKERRQ(ierr);
 
 	/*
-		Reads weight and spatial matrices (if applicable)
+		Reads weight and spatial matrices (if applicable) of every configuration
 	*/
 
-	ierr = ReadWeightMats(RSVD, Weight, dirs);CHKERRQ(ierr);
+	for (ic=0; ic<RSVD->NumConfigs; ic++) {
+		if (RSVD->Display && dirs->ConfigList[ic]) ierr = PetscPrintf(PETSC_COMM_WORLD,"Configuration (%d/%d): %s\n",(int)ic+1,(int)RSVD->NumConfigs,dirs->ConfigList[ic]);CHKERRQ(ierr);
+		ierr = ReadWeightInput(&(*Weight)[ic], dirs->ConfigList[ic]);CHKERRQ(ierr);
+		if (RSVD->Bench.NumGrid) ierr = SyntheticWeights(RSVD, &(*Weight)[ic], dirs);CHKERRQ(ierr);
+		if (!RSVD->Batch.Flg) ierr = ReadWeightMats(RSVD, &(*Weight)[ic], dirs);CHKERRQ(ierr);
+	}
 
 	PetscFunctionReturn(0);
 }
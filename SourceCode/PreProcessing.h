@@ -2,6 +2,6 @@
 #ifndef PREPROCESSING_H
 #define PREPROCESSING_H
 
-PetscErrorCode PreProcessing(RSVD_matrices*, RSVD_vars*, Weight_matrices*, Directories*);
+PetscErrorCode PreProcessing(RSVD_matrices*, RSVD_vars*, Weight_matrices**, Directories*);
 
 #endif
\ No newline at end of file
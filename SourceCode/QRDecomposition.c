@@ -1,11 +1,17 @@
 
+#include <petscksp.h>
 #include <slepcbv.h>
+#include <petscblaslapack.h>
 #include <Variables.h>
+#include <StageThreads.h>
 
-PetscErrorCode QRDecomposition(RSVD_vars *RSVD, Mat V)
+PetscErrorCode QRDecomposition(RSVD_vars *RSVD, Mat V, Mat R)
 {
 	/*
-		Performs QR decomposition on a given matrix 
+		Performs QR decomposition on a given matrix, V <- Q
+		The k x k triangular factor is returned in R (sequential dense) unless R is NULL
+		Low-memory mode: Q is stored in one contiguous block (BVMAT) and copied back through BVGetMat(),
+		which shares its storage, so only one copy of V is made
 	*/  
 
 	PetscErrorCode        ierr;
@@ -16,16 +22,23 @@ PetscErrorCode QRDecomposition(RSVD_vars *RSVD, Mat V)
 
 	PetscFunctionBeginUser;
 
+	ierr = SetStageThreads(NULL, RSVD, STAGE_DENSE);CHKERRQ(ierr);
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
 	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** QR decomposition begins! ***\n");CHKERRQ(ierr);	
 
 	ierr = BVCreateFromMat(V,&Q);CHKERRQ(ierr);
-	ierr = BVSetType(Q,BVVECS);CHKERRQ(ierr);
-	ierr = BVOrthogonalize(Q,NULL);CHKERRQ(ierr);
-	ierr = BVCreateMat(Q,&Q_temp);CHKERRQ(ierr);
-	ierr = MatCopy(Q_temp,V,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+	ierr = BVSetType(Q,RSVD->LowMemory ? BVMAT : BVVECS);CHKERRQ(ierr);
+	ierr = BVOrthogonalize(Q,R);CHKERRQ(ierr);
+	if (RSVD->LowMemory) {
+		ierr = BVGetMat(Q,&Q_temp);CHKERRQ(ierr);
+		ierr = MatCopy(Q_temp,V,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+		ierr = BVRestoreMat(Q,&Q_temp);CHKERRQ(ierr);
+	} else {
+		ierr = BVCreateMat(Q,&Q_temp);CHKERRQ(ierr);
+		ierr = MatCopy(Q_temp,V,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+		ierr = MatDestroy(&Q_temp);CHKERRQ(ierr);
+	}
 	ierr = BVDestroy(&Q);CHKERRQ(ierr);
-	ierr = MatDestroy(&Q_temp);CHKERRQ(ierr);
 	
 	/*
 		Prints out the elapsed time and exits
@@ -35,11 +48,57 @@ PetscErrorCode QRDecomposition(RSVD_vars *RSVD, Mat V)
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** QR decomposition elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);	
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** QR decomposition elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)RSVD->Threads[STAGE_DENSE], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);	
 
 	PetscFunctionReturn(0);
 
 }
 
+PetscErrorCode QRSVD(RSVD_vars *RSVD, Mat V, PetscReal *s)
+{
+	/*
+		Economy SVD of V (N x k) in place through its QR decomposition (low-memory mode):
+		V = Q R, R = U_r S W^* (LAPACK), V <- Q U_r, the left singular vectors
+		The k singular values (in decreasing order) are returned in s unless s is NULL
+	*/
+
+	PetscErrorCode        ierr;
+	Mat                   R, Q_temp;
+	BV                    Q;
+	PetscInt              k;
+	PetscScalar          *r, *work;
+	PetscReal            *sv, *rwork;
+	PetscBLASInt          bk, lwork, info, one = 1;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatGetSize(V,NULL,&k);CHKERRQ(ierr);
+	ierr = MatCreateSeqDense(PETSC_COMM_SELF,k,k,NULL,&R);CHKERRQ(ierr);
+	ierr = BVCreateFromMat(V,&Q);CHKERRQ(ierr);
+	ierr = BVSetType(Q,BVMAT);CHKERRQ(ierr);
+	ierr = BVOrthogonalize(Q,R);CHKERRQ(ierr);
+
+	/*
+		R <- U_r (every rank holds the same R, hence the same U_r)
+	*/
+
+	bk    = (PetscBLASInt)k;
+	lwork = 5*bk;
+	ierr  = PetscMalloc3(k,&sv,5*k,&work,5*k,&rwork);CHKERRQ(ierr);
+	ierr  = MatDenseGetArray(R,&r);CHKERRQ(ierr);
+	LAPACKgesvd_("O","N",&bk,&bk,r,&bk,sv,NULL,&one,NULL,&one,work,&lwork,rwork,&info);
+	ierr  = MatDenseRestoreArray(R,&r);CHKERRQ(ierr);
+	if (info) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_LIB,"LAPACK gesvd failed with info = %d", (int)info);
+	if (s) ierr = PetscArraycpy(s,sv,k);CHKERRQ(ierr);
 
+	ierr = BVMultInPlace(Q,R,0,k);CHKERRQ(ierr);
+	ierr = BVGetMat(Q,&Q_temp);CHKERRQ(ierr);
+	ierr = MatCopy(Q_temp,V,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+	ierr = BVRestoreMat(Q,&Q_temp);CHKERRQ(ierr);
+	ierr = BVDestroy(&Q);CHKERRQ(ierr);
+	ierr = MatDestroy(&R);CHKERRQ(ierr);
+	ierr = PetscFree3(sv,work,rwork);CHKERRQ(ierr);
 
+	PetscFunctionReturn(0);
+
+}
@@ -2,6 +2,7 @@
 #ifndef QRDECOMPOSITION_H
 #define QRDECOMPOSITION_H
 
-PetscErrorCode QRDecomposition(RSVD_vars*, Mat);
+PetscErrorCode QRDecomposition(RSVD_vars*, Mat, Mat);
+PetscErrorCode QRSVD(RSVD_vars*, Mat, PetscReal*);
 
 #endif
\ No newline at end of file
@@ -7,20 +7,48 @@
 #include <PowerIteration.h>
 #include <SVD4Response.h>
 #include <SVD4Forcing.h>
+#include <SaveModesPolicy.h>
+#include <ExactResolvent.h>
+#include <FactorOperator.h>
+#include <SetupFreqGrid.h>
+#include <StatusFile.h>
+#include <MultiShift.h>
+
+static PetscErrorCode StageMemory(RSVD_vars *RSVD, const char *stage)
+{
+	/*
+		Low-memory mode: prints the current and peak resident memory (max over ranks) after a stage
+	*/
+
+	PetscErrorCode        ierr;
+	PetscLogDouble        mem[2];
+
+	PetscFunctionBeginUser;
+
+	if (!RSVD->LowMemory || !RSVD->Display) PetscFunctionReturn(0);
+	ierr = PetscMemoryGetCurrentUsage(&mem[0]);CHKERRQ(ierr);
+	ierr = PetscMemoryGetMaximumUsage(&mem[1]);CHKERRQ(ierr);
+	ierr = MPI_Allreduce(MPI_IN_PLACE,mem,2,MPI_DOUBLE,MPI_MAX,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"Memory after %s: current %.1f MB, peak %.1f MB (max over ranks)\n", stage, mem[0]/1048576, mem[1]/1048576);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
 
 PetscErrorCode RSVDLU(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs, PetscInt iw)
 {
 
 	/*
 		Performs the RSVD-LU algorithm to compute resolvent modes and gains for each freqency of interest
+		Weight is an array of NumConfigs input/output configurations, all solved with one factorization
 	*/  
 
 	PetscErrorCode        ierr;
 	KSP                   ksp;
-	PC                    pc;
-	Mat                   A;
-	PetscInt              hh, mm, ss;
-	PetscReal             w;
+	PetscInt              hh, mm, ss, ic, rounds;
+	PetscBool             exact;
+	char                  FolderDir[PETSC_MAX_PATH_LEN];
+	PetscReal             w, change;
 	PetscLogDouble        t1, t2;
 
 	PetscFunctionBeginUser;
@@ -29,7 +57,7 @@ PetscErrorCode RSVDLU(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *We
 		Current frequency
 	*/
 
-	w = RSVD->w_min + iw * RSVD->dw;
+	ierr = GetFrequency(RSVD, iw, &w);CHKERRQ(ierr);
 
 	if (RSVD->Display) {
 		ierr = PetscPrintf(PETSC_COMM_WORLD,"*******************************************\n"
@@ -43,49 +71,19 @@ PetscErrorCode RSVDLU(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *We
 	}	
 
 	/*
-		Builds the reolvent operator
-	*/
-
-	ierr = MatDuplicate(RSVDM->A_org,MAT_COPY_VALUES,&A);CHKERRQ(ierr);
-	ierr = MatScale(A, -1.);CHKERRQ(ierr);
-	ierr = MatShift(A, PETSC_i * w);CHKERRQ(ierr);
-
-	/*
-		Discounting
-	*/
-
-	if (RSVD->Disc.DiscFlg) {
-		ierr = MatShift(A,-RSVD->Disc.beta);CHKERRQ(ierr);
-		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n---- Discounting with beta = %g ----\n\n", RSVD->Disc.beta);CHKERRQ(ierr);
-	}
-
-	/*
-		Creates the initial random matrix of size Nxk
-	*/
-
-	ierr = CreateRandomMat(RSVDM, RSVD, dirs);CHKERRQ(ierr);
-
-	/*
-		Creates the KSP solver for R and R^*
+		Builds and factorizes the resolvent operator
+		With the multi-shift solver, only the first frequency of a window factorizes (at its central frequency)
 	*/
 
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
-
-	ierr = KSPCreate(PETSC_COMM_WORLD,&ksp);CHKERRQ(ierr);
-	ierr = KSPSetType(ksp,KSPPREONLY);CHKERRQ(ierr);
-	ierr = KSPSetOperators(ksp,A,A);CHKERRQ(ierr);
-	ierr = KSPGetPC(ksp, &pc);CHKERRQ(ierr);
-	ierr = PCSetType(pc, PCLU);CHKERRQ(ierr);
-	ierr = PCFactorSetMatSolverType(pc, MATSOLVERMUMPS);CHKERRQ(ierr);
-	ierr = KSPSetTolerances(ksp,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
-	ierr = KSPSetFromOptions(ksp);CHKERRQ(ierr);
-	ierr = KSPSetUp(ksp);CHKERRQ(ierr);
-
-	ierr = PetscTime(&t2);CHKERRQ(ierr);
-	hh   = (t2-t1)/3600;
-	mm   = (t2-t1-3600*hh)/60;
-	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** LU decomposition elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVDM->MS) {
+		ierr = MultiShiftSetFrequency(RSVDM->MS, RSVDM, RSVD, dirs, iw);CHKERRQ(ierr);
+	} else {
+		ierr = FactorOperator(RSVDM, RSVD, dirs, w);CHKERRQ(ierr);
+	}
+	ksp  = RSVDM->ksp;
+	ierr = StatusFileStage(Res->Status, STATUS_LU);CHKERRQ(ierr);
+	ierr = StageMemory(RSVD, "LU");CHKERRQ(ierr);
 
 	/*************************************************************************
 		****************     RSVD - LU algorithm       *******************
@@ -93,34 +91,106 @@ PetscErrorCode RSVDLU(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *We
 	**************************************************************************/
 
 	/*
-		Direct action
+		Runs the pipeline for every input/output configuration with the same factorization
+		The results of configuration <name> are saved in FolderDir/<name>/
 	*/
 
-	ierr = DirectAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+	ierr = PetscStrncpy(FolderDir,dirs->FolderDir,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
 
-	/*
-		Power itertion
-	*/	
+	for (ic=0; ic<RSVD->NumConfigs; ic++) {
 
-	ierr = PowerIteration(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+		if (RSVD->NumConfigs > 1) {
+			if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n---- Configuration (%d/%d): %s ----\n\n",(int)ic+1,(int)RSVD->NumConfigs,dirs->ConfigList[ic]);CHKERRQ(ierr);
+			ierr = PetscSNPrintf((char*)&dirs->FolderDir,PETSC_MAX_PATH_LEN,"%s%s/",FolderDir,dirs->ConfigList[ic]);CHKERRQ(ierr);
+		}
+		RSVD->Nb           = Weight[ic].Nb;
+		RSVD->Nc           = Weight[ic].Nc;
+		RSVD->AdjointFirst = Weight[ic].AdjointFirst;
 
-	/*
-		Reduced SVD to obtain response modes
-	*/
+		/*
+			The exact resolvent requires min(Nb, Nc) solves against k(q+1) direct and k(q+1) adjoint
+			solves for the randomized one, hence it is chosen (ExactOpt = 1) if min(Nb, Nc) <= k(q+1)
+		*/
 
-	ierr = SVD4Response(RSVDM, RSVD, Weight, Res, dirs, iw);CHKERRQ(ierr);
+		exact = (PetscBool) (RSVD->ExactOpt == 2 || (RSVD->ExactOpt == 1 && PetscMin(RSVD->Nb,RSVD->Nc) <= RSVD->k*(RSVD->q+1)));
 
-	/*
-		Adjoint action
-	*/
+		/*
+			Creates the initial random matrix of size Nxk
+		*/
 
-	ierr = AdjointAction(ksp, RSVDM, RSVD, Weight);CHKERRQ(ierr);
+		if (!exact) ierr = CreateRandomMat(RSVDM, RSVD, dirs);CHKERRQ(ierr);
 
-	/*
-		Reduced SVD to obtain forcing modes and gains
-	*/	
+		if (exact) {
+			ierr = ExactResolvent(ksp, RSVDM, RSVD, &Weight[ic], Res, dirs, iw);CHKERRQ(ierr);
+			ierr = StatusFileStage(Res->Status, STATUS_EXACT);CHKERRQ(ierr);
+			ierr = StageMemory(RSVD, "exact resolvent");CHKERRQ(ierr);
+			if (ic == RSVD->NumConfigs-1) ierr = ReleaseOperator(RSVDM, RSVD);CHKERRQ(ierr);
+		} else {
+			/*
+				Direct action (adjoint action if the sketch starts from the output space)
+				Its right-hand side is the same random matrix at every frequency (shared by a multi-shift window)
+			*/
+
+			ierr = MultiShiftSetShared(RSVDM->MS, PETSC_TRUE);CHKERRQ(ierr);
+			if (RSVD->AdjointFirst) {
+				ierr = AdjointAction(ksp, RSVDM, RSVD, &Weight[ic]);CHKERRQ(ierr);
+			} else {
+				ierr = DirectAction(ksp, RSVDM, RSVD, &Weight[ic]);CHKERRQ(ierr);
+			}
+			ierr = MultiShiftSetShared(RSVDM->MS, PETSC_FALSE);CHKERRQ(ierr);
+			ierr = StatusFileStage(Res->Status, STATUS_FIRST_ACTION);CHKERRQ(ierr);
+			ierr = StageMemory(RSVD, "first action");CHKERRQ(ierr);
+
+			/*
+				Power itertion
+			*/	
+
+			ierr = PowerIteration(ksp, RSVDM, RSVD, &Weight[ic], &rounds, &change);CHKERRQ(ierr);
+			ierr = LogPowerRounds(RSVD, dirs, iw, rounds, change);CHKERRQ(ierr);
+			ierr = StatusFileStage(Res->Status, STATUS_POWER_ITERATION);CHKERRQ(ierr);
+			ierr = StageMemory(RSVD, "power iteration");CHKERRQ(ierr);
+
+			/*
+				Reduced SVD to obtain response modes (forcing modes)
+			*/
+
+			ierr = SVD4Response(RSVDM, RSVD, &Weight[ic], Res, dirs, iw);CHKERRQ(ierr);
+			ierr = StatusFileStage(Res->Status, STATUS_SVD_RESPONSE);CHKERRQ(ierr);
+			ierr = StageMemory(RSVD, "first SVD");CHKERRQ(ierr);
+
+			/*
+				Adjoint action (direct action)
+			*/
+
+			if (RSVD->AdjointFirst) {
+				ierr = DirectAction(ksp, RSVDM, RSVD, &Weight[ic]);CHKERRQ(ierr);
+			} else {
+				ierr = AdjointAction(ksp, RSVDM, RSVD, &Weight[ic]);CHKERRQ(ierr);
+			}
+			ierr = StatusFileStage(Res->Status, STATUS_SECOND_ACTION);CHKERRQ(ierr);
+			ierr = StageMemory(RSVD, "second action");CHKERRQ(ierr);
+
+			/*
+				Reduced SVD to obtain forcing modes (response modes) and gains
+				Low-memory mode: the factors are freed first once the last configuration is solved
+			*/	
+
+			if (ic == RSVD->NumConfigs-1) ierr = ReleaseOperator(RSVDM, RSVD);CHKERRQ(ierr);
+
+			ierr = SVD4Forcing(RSVDM, RSVD, &Weight[ic], Res, dirs, iw);CHKERRQ(ierr);
+			ierr = StatusFileStage(Res->Status, STATUS_SVD_FORCING);CHKERRQ(ierr);
+			ierr = StageMemory(RSVD, "second SVD and saving");CHKERRQ(ierr);
+		}
+
+		/*
+			Saves the modes of the previous frequency if its leading gain is a local maximum
+		*/
+
+		if (RSVD->SaveModesOpt == 3) ierr = SavePeakModes(RSVD, &Weight[ic], Res, dirs, iw);CHKERRQ(ierr);
 
-	ierr = SVD4Forcing(RSVDM, RSVD, Weight, Res, dirs, iw);CHKERRQ(ierr);
+	}
+
+	ierr = PetscStrncpy(dirs->FolderDir,FolderDir,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
 
 	ierr = PetscTime(&t2);CHKERRQ(ierr);
 	hh   = (t2-t1)/3600;
@@ -128,13 +198,6 @@ PetscErrorCode RSVDLU(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *We
 	ss   = t2-t1-3600*hh-mm*60;
 	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Total elapsed time = %02d:%02d:%02d ***\n\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
-	/*
-		Destroys variables
-	*/
-
-	ierr = MatDestroy(&A);CHKERRQ(ierr);
-	ierr = KSPDestroy(&ksp);CHKERRQ(ierr);
-
 	PetscFunctionReturn(0);
 
 }	
@@ -0,0 +1,420 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <RSVDLUSolver.h>
+#include <RSVDLU.h>
+#include <FactorCache.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+struct _p_RSVDLUSolver {
+	RSVD_vars             RSVD;                             /* RSVD variables */
+	Weight_matrices       Weight;                           /* weight and input/output matrices (borrowed from the caller) */
+	RSVD_matrices         RSVDM;                            /* RSVD matrices, A_org borrowed from the caller */
+	Resolvent_matrices    Res;                              /* resolvent modes and gains */
+	Directories           dirs;                             /* unused directories (no files) */
+	PetscReal            *gains;                            /* Nw x k gains of the last solve (row iw), on every rank */
+	RSVDLUGainsFn         GainsFn;                          /* gains callback of the caller */
+	RSVDLUModesFn         ModesFn;                          /* modes callback of the caller */
+	void                 *ctx;                              /* context of the callbacks */
+};
+
+static PetscErrorCode SolverGains(PetscInt iw, PetscReal w, Vec S, void *ctx)
+{
+	/*
+		Keeps the gains of the iw-th frequency on every rank, then calls the gains callback of the caller
+	*/
+
+	PetscErrorCode        ierr;
+	RSVDLUSolver          solver = (RSVDLUSolver)ctx;
+	VecScatter            scatter;
+	Vec                   S_all;
+	const PetscScalar    *s;
+	PetscInt              ik;
+
+	PetscFunctionBeginUser;
+
+	ierr = VecScatterCreateToAll(S,&scatter,&S_all);CHKERRQ(ierr);
+	ierr = VecScatterBegin(scatter,S,S_all,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecScatterEnd(scatter,S,S_all,INSERT_VALUES,SCATTER_FORWARD);CHKERRQ(ierr);
+	ierr = VecGetArrayRead(S_all,&s);CHKERRQ(ierr);
+	for (ik=0; ik<solver->RSVD.k; ik++) solver->gains[iw*solver->RSVD.k+ik] = PetscRealPart(s[ik]);
+	ierr = VecRestoreArrayRead(S_all,&s);CHKERRQ(ierr);
+	ierr = VecScatterDestroy(&scatter);CHKERRQ(ierr);
+	ierr = VecDestroy(&S_all);CHKERRQ(ierr);
+
+	if (solver->GainsFn) ierr = (*solver->GainsFn)(iw, w, S, solver->ctx);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SolverModes(PetscInt iw, PetscReal w, PetscBool response, Mat X, void *ctx)
+{
+	/*
+		Hands the (unweighted) modes of the iw-th frequency to the modes callback of the caller
+	*/
+
+	PetscErrorCode        ierr;
+	RSVDLUSolver          solver = (RSVDLUSolver)ctx;
+
+	PetscFunctionBeginUser;
+
+	ierr = (*solver->ModesFn)(iw, w, response, X, solver->ctx);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverCreate(MPI_Comm comm, RSVDLUSolver *solver)
+{
+	/*
+		Creates a solver with the defaults of the executable (k = 10, q = 1, ExactOpt = 1, no display)
+		comm must be (congruent to) PETSC_COMM_WORLD, on which all the operations are performed
+	*/
+
+	PetscErrorCode        ierr;
+	PetscMPIInt           result;
+	RSVDLUSolver          s;
+	PetscInt              is;
+
+	PetscFunctionBeginUser;
+
+	ierr = MPI_Comm_compare(comm,PETSC_COMM_WORLD,&result);CHKERRMPI(ierr);
+	if (result != MPI_IDENT && result != MPI_CONGRUENT) SETERRQ(comm,PETSC_ERR_ARG_WRONG,"The communicator must be PETSC_COMM_WORLD; set PETSC_COMM_WORLD to it before SlepcInitialize()");
+
+	ierr = PetscNew(&s);CHKERRQ(ierr);
+
+	s->RSVD.k              = 10;
+	s->RSVD.q              = 1;
+	s->RSVD.RandSeed       = 1373;
+	s->RSVD.ExactOpt       = 1;
+	s->RSVD.BlockSize      = 1;
+	s->RSVD.NumOps         = 1;
+	s->RSVD.NumConfigs     = 1;
+	s->RSVD.SaveResultsOpt = 2;
+	s->RSVD.IOBuffers      = 2;
+	s->RSVD.InMemory       = PETSC_TRUE;
+	for (is=0; is<NUM_STAGES; is++) {
+		s->RSVD.Threads[is] = 1;
+#if defined(_OPENMP)
+		s->RSVD.Threads[is] = omp_get_max_threads();
+#endif
+	}
+
+	s->Res.GainsFn    = SolverGains;
+	s->Res.MonitorCtx = s;
+
+	*solver = s;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetOperator(RSVDLUSolver solver, Mat A, PetscBool same_pattern)
+{
+	/*
+		Sets the linear operator A (kept by reference, not modified)
+		With same_pattern, A has the nonzero pattern of the previous operator (e.g., the next Jacobian of the
+		simulation), and the ordering and symbolic factorization are reused as for an OperatorList
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              M, N, bs;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatGetSize(A,&M,&N);CHKERRQ(ierr);
+	if (M != N) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_SIZ,"The operator must be square, current size: %d x %d", (int)M, (int)N);
+	if (same_pattern && solver->RSVDM.A_org && N != solver->RSVD.N) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_SIZ,"The operator must have the size of the previous one");
+	if (!same_pattern) {
+		ierr = KSPDestroy(&solver->RSVDM.ksp);CHKERRQ(ierr);
+		ierr = MatDestroy(&solver->RSVDM.A);CHKERRQ(ierr);
+	}
+
+	ierr = PetscObjectReference((PetscObject)A);CHKERRQ(ierr);
+	ierr = MatDestroy(&solver->RSVDM.A_org);CHKERRQ(ierr);
+	ierr = MatGetBlockSize(A,&bs);CHKERRQ(ierr);
+	solver->RSVDM.A_org  = A;
+	solver->RSVD.N       = N;
+	solver->RSVD.BlockSize = bs;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetInputOutput(RSVDLUSolver solver, Mat B, Mat C)
+{
+	/*
+		Sets the input (N x Nb) and output (Nc x N) matrices, NULL for the identity
+	*/
+
+	PetscErrorCode        ierr=0;
+
+	PetscFunctionBeginUser;
+
+	if (B) ierr = PetscObjectReference((PetscObject)B);CHKERRQ(ierr);
+	if (C) ierr = PetscObjectReference((PetscObject)C);CHKERRQ(ierr);
+	ierr = MatDestroy(&solver->Weight.B);CHKERRQ(ierr);
+	ierr = MatDestroy(&solver->Weight.C);CHKERRQ(ierr);
+	solver->Weight.B               = B;
+	solver->Weight.C               = C;
+	solver->Weight.InputMatrixFlg  = (PetscBool) (B != NULL);
+	solver->Weight.OutputMatrixFlg = (PetscBool) (C != NULL);
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SolverSetWeight(PetscObject W, PetscObject w, Mat *W_old, Vec *w_old, PetscBool *flg)
+{
+	/*
+		Replaces a weight (matrix W or diagonal w, at most one of both) by a reference to the new one
+	*/
+
+	PetscErrorCode        ierr=0;
+
+	PetscFunctionBeginUser;
+
+	if (W) ierr = PetscObjectReference(W);CHKERRQ(ierr);
+	if (w) ierr = PetscObjectReference(w);CHKERRQ(ierr);
+	ierr = MatDestroy(W_old);CHKERRQ(ierr);
+	ierr = VecDestroy(w_old);CHKERRQ(ierr);
+	*W_old = (Mat)W;
+	*w_old = (Vec)w;
+	*flg   = (PetscBool) (W || w);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetWeights(RSVDLUSolver solver, Mat W_f_sqrt_inv, Mat W_q_sqrt, Mat W_q_sqrt_inv)
+{
+	/*
+		Sets the weights as matrices, NULL for the identity
+		W_q_sqrt_inv is only used to recover the response modes, which are weighted if it is NULL
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	ierr = SolverSetWeight((PetscObject)W_f_sqrt_inv,NULL,&solver->Weight.W_f_sqrt_inv,&solver->Weight.w_f_sqrt_inv,&solver->Weight.InvInputWeightFlg);CHKERRQ(ierr);
+	ierr = SolverSetWeight((PetscObject)W_q_sqrt,NULL,&solver->Weight.W_q_sqrt,&solver->Weight.w_q_sqrt,&solver->Weight.OutputWeightFlg);CHKERRQ(ierr);
+	ierr = SolverSetWeight((PetscObject)W_q_sqrt_inv,NULL,&solver->Weight.W_q_sqrt_inv,&solver->Weight.w_q_sqrt_inv,&solver->Weight.InvOutputWeightFlg);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetDiagonalWeights(RSVDLUSolver solver, Vec w_f_sqrt_inv, Vec w_q_sqrt, Vec w_q_sqrt_inv)
+{
+	/*
+		Sets diagonal weights given by their diagonals, NULL for the identity
+		If w_q_sqrt_inv is NULL, it is taken as the reciprocal of w_q_sqrt
+	*/
+
+	PetscErrorCode        ierr;
+	Vec                   w = NULL;
+
+	PetscFunctionBeginUser;
+
+	ierr = SolverSetWeight(NULL,(PetscObject)w_f_sqrt_inv,&solver->Weight.W_f_sqrt_inv,&solver->Weight.w_f_sqrt_inv,&solver->Weight.InvInputWeightFlg);CHKERRQ(ierr);
+	ierr = SolverSetWeight(NULL,(PetscObject)w_q_sqrt,&solver->Weight.W_q_sqrt,&solver->Weight.w_q_sqrt,&solver->Weight.OutputWeightFlg);CHKERRQ(ierr);
+	if (!w_q_sqrt_inv && w_q_sqrt) {
+		ierr = VecDuplicate(w_q_sqrt,&w);CHKERRQ(ierr);
+		ierr = VecCopy(w_q_sqrt,w);CHKERRQ(ierr);
+		ierr = VecReciprocal(w);CHKERRQ(ierr);
+	}
+	ierr = SolverSetWeight(NULL,(PetscObject)(w ? w : w_q_sqrt_inv),&solver->Weight.W_q_sqrt_inv,&solver->Weight.w_q_sqrt_inv,&solver->Weight.InvOutputWeightFlg);CHKERRQ(ierr);
+	ierr = VecDestroy(&w);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetDimensions(RSVDLUSolver solver, PetscInt k, PetscInt q)
+{
+	/*
+		Sets the number of test vectors k and of power iterations q
+	*/
+
+	PetscFunctionBeginUser;
+
+	if (k < 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"'k' must be a positive integer, current value: %d", (int) k);
+	if (q < 0) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"'q' must be a non-negative integer, current value: %d", (int) q);
+	solver->RSVD.k = k;
+	solver->RSVD.q = q;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetFrequencies(RSVDLUSolver solver, PetscInt Nw, const PetscReal w[])
+{
+	/*
+		Sets the Nw (angular) frequencies to resolve, in any order
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	if (Nw < 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_OUTOFRANGE,"At least one frequency is required");
+	ierr = PetscFree(solver->RSVD.w_list);CHKERRQ(ierr);
+	ierr = PetscMalloc1(Nw,&solver->RSVD.w_list);CHKERRQ(ierr);
+	ierr = PetscArraycpy(solver->RSVD.w_list,w,Nw);CHKERRQ(ierr);
+	solver->RSVD.Nw    = Nw;
+	solver->RSVD.w_min = w[0];
+	solver->RSVD.w_max = w[Nw-1];
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetMonitor(RSVDLUSolver solver, RSVDLUGainsFn GainsFn, RSVDLUModesFn ModesFn, void *ctx)
+{
+	/*
+		Sets the callbacks receiving the gains and modes of every frequency as soon as they are computed
+		The modes are only recovered (unweighted) if ModesFn is given; X is destroyed after the call
+	*/
+
+	PetscFunctionBeginUser;
+
+	solver->GainsFn           = GainsFn;
+	solver->ModesFn           = ModesFn;
+	solver->ctx               = ctx;
+	solver->Res.ModesFn       = ModesFn ? SolverModes : NULL;
+	solver->RSVD.SaveModesOpt = ModesFn ? 1 : 0;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSetFromOptions(RSVDLUSolver solver)
+{
+	/*
+		Reads the options of the executable that apply to the library from the options database:
+		Display, RandSeed, SketchOpt, ExactOpt, DiscFlg, beta, ThreadsLU, ThreadsSolve and ThreadsDense
+	*/
+
+	PetscErrorCode        ierr;
+	RSVD_vars            *RSVD = &solver->RSVD;
+	PetscBool             flg_set;
+	PetscInt              is;
+	char                  option[64];
+	const char           *StageThreads[NUM_STAGES] = {"ThreadsLU", "ThreadsSolve", "ThreadsDense"};
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscOptionsGetInt(NULL,NULL,"-Display",&RSVD->Display,NULL);CHKERRQ(ierr);
+	ierr = PetscOptionsGetInt(NULL,NULL,"-RandSeed",&RSVD->RandSeed,NULL);CHKERRQ(ierr);
+	ierr = PetscOptionsGetInt(NULL,NULL,"-SketchOpt",&RSVD->SketchOpt,NULL);CHKERRQ(ierr);
+	if (RSVD->SketchOpt < SKETCH_GAUSSIAN || RSVD->SketchOpt > SKETCH_SRFT) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SketchOpt' must be 0, 1, 2 or 3, current value: %d", (int) RSVD->SketchOpt);
+	ierr = PetscOptionsGetInt(NULL,NULL,"-ExactOpt",&RSVD->ExactOpt,NULL);CHKERRQ(ierr);
+	if (RSVD->ExactOpt < 0 || RSVD->ExactOpt > 2) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'ExactOpt' must be 0, 1 or 2, current value: %d", (int) RSVD->ExactOpt);
+	ierr = PetscOptionsGetBool(NULL,NULL,"-DiscFlg",&RSVD->Disc.DiscFlg,NULL);CHKERRQ(ierr);
+	ierr = PetscOptionsGetReal(NULL,NULL,"-beta",&RSVD->Disc.beta,&flg_set);CHKERRQ(ierr);
+	if (!flg_set && RSVD->Disc.DiscFlg) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Discounting flag is on! Either set 'DiscFlg' to zero or specify 'beta'");
+	for (is=0; is<NUM_STAGES; is++) {
+		ierr = PetscSNPrintf(option,sizeof(option),"-%s",StageThreads[is]);CHKERRQ(ierr);
+		ierr = PetscOptionsGetInt(NULL,NULL,option,&RSVD->Threads[is],NULL);CHKERRQ(ierr);
+		if (RSVD->Threads[is] < 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'%s' must be a positive integer, current value: %d", StageThreads[is], (int) RSVD->Threads[is]);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverSolve(RSVDLUSolver solver)
+{
+	/*
+		Runs RSVDLU() for every frequency, with the gains kept in memory and handed with the modes to the callbacks
+		The sizes Nb and Nc follow from B and C (N if not set), and the sketch starts from the smaller space
+	*/
+
+	PetscErrorCode        ierr=0;
+	RSVD_vars            *RSVD = &solver->RSVD;
+	Weight_matrices      *Weight = &solver->Weight;
+	PetscInt              iw, n;
+
+	PetscFunctionBeginUser;
+
+	if (!solver->RSVDM.A_org) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ORDER,"Must set the operator with RSVDLUSolverSetOperator()");
+	if (!RSVD->w_list) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ORDER,"Must set the frequencies with RSVDLUSolverSetFrequencies()");
+
+	RSVD->Nb = RSVD->N;
+	RSVD->Nc = RSVD->N;
+	if (Weight->B) ierr = MatGetSize(Weight->B,NULL,&RSVD->Nb);CHKERRQ(ierr);
+	if (Weight->C) ierr = MatGetSize(Weight->C,&RSVD->Nc,NULL);CHKERRQ(ierr);
+	if (Weight->W_f_sqrt_inv) ierr = MatGetSize(Weight->W_f_sqrt_inv,&n,NULL);CHKERRQ(ierr);
+	if (Weight->w_f_sqrt_inv) ierr = VecGetSize(Weight->w_f_sqrt_inv,&n);CHKERRQ(ierr);
+	if (Weight->InvInputWeightFlg && n != RSVD->Nb) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_SIZ,"Size mismatch between input matrix (B) and input weight matrix (W_f_sqrt_inv)");
+	if (Weight->W_q_sqrt) ierr = MatGetSize(Weight->W_q_sqrt,&n,NULL);CHKERRQ(ierr);
+	if (Weight->w_q_sqrt) ierr = VecGetSize(Weight->w_q_sqrt,&n);CHKERRQ(ierr);
+	if (Weight->OutputWeightFlg && n != RSVD->Nc) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ARG_SIZ,"Size mismatch between output matrix (C) and output weight matrix (W_q_sqrt)");
+	Weight->Nb           = RSVD->Nb;
+	Weight->Nc           = RSVD->Nc;
+	Weight->AdjointFirst = (PetscBool) (RSVD->Nc < RSVD->Nb);
+	RSVD->SaveModesNum   = RSVD->k;
+
+	ierr = PetscFree(solver->gains);CHKERRQ(ierr);
+	ierr = PetscCalloc1(RSVD->Nw*RSVD->k,&solver->gains);CHKERRQ(ierr);
+
+	for (iw=0; iw<RSVD->Nw; iw++) {
+		ierr = RSVDLU(&solver->RSVDM, RSVD, Weight, &solver->Res, &solver->dirs, iw);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverGetGains(RSVDLUSolver solver, PetscInt *Nw, PetscInt *k, const PetscReal **gains)
+{
+	/*
+		Gives the Nw x k gains of the last solve, gains[iw*k + ik] (owned by the solver, same on every rank)
+	*/
+
+	PetscFunctionBeginUser;
+
+	if (!solver->gains) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_ORDER,"Must call RSVDLUSolverSolve() first");
+	if (Nw) *Nw = solver->RSVD.Nw;
+	if (k)  *k  = solver->RSVD.k;
+	*gains = solver->gains;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode RSVDLUSolverDestroy(RSVDLUSolver *solver)
+{
+	/*
+		Destroys the solver and releases the references to the objects of the caller
+	*/
+
+	PetscErrorCode        ierr;
+	RSVDLUSolver          s = *solver;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	ierr = KSPDestroy(&s->RSVDM.ksp);CHKERRQ(ierr);
+	ierr = FactorCacheDestroy(&s->RSVDM.Cache);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->RSVDM.A);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->RSVDM.A_org);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->Weight.B);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->Weight.C);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->Weight.W_f_sqrt_inv);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->Weight.W_q_sqrt);CHKERRQ(ierr);
+	ierr = MatDestroy(&s->Weight.W_q_sqrt_inv);CHKERRQ(ierr);
+	ierr = VecDestroy(&s->Weight.w_f_sqrt_inv);CHKERRQ(ierr);
+	ierr = VecDestroy(&s->Weight.w_q_sqrt);CHKERRQ(ierr);
+	ierr = VecDestroy(&s->Weight.w_q_sqrt_inv);CHKERRQ(ierr);
+	ierr = PetscFree(s->RSVD.w_list);CHKERRQ(ierr);
+	ierr = PetscFree(s->gains);CHKERRQ(ierr);
+	ierr = PetscFree(*solver);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
@@ -0,0 +1,36 @@
+
+#ifndef RSVDLUSOLVER_H
+#define RSVDLUSOLVER_H
+
+/*
+	Library API of RSVD-LU for in-situ use (make lib builds libRSVDLU.so from all sources but main.c)
+	The caller initializes SLEPc, passes the operator A (and optionally B, C and the weights) as PETSc
+	objects that stay owned by the caller, and receives the gains and modes in memory or through callbacks;
+	nothing is written to disk. The solver runs on PETSC_COMM_WORLD, which may be set to a sub-communicator
+	of the simulation before SlepcInitialize()
+*/
+
+#include <petscmat.h>
+
+typedef struct _p_RSVDLUSolver *RSVDLUSolver;
+
+/* called with the k gains of the iw-th frequency w */
+typedef PetscErrorCode (*RSVDLUGainsFn)(PetscInt iw, PetscReal w, Vec S, void *ctx);
+
+/* called with the N x k response (response = PETSC_TRUE) or forcing modes of the iw-th frequency w */
+typedef PetscErrorCode (*RSVDLUModesFn)(PetscInt iw, PetscReal w, PetscBool response, Mat X, void *ctx);
+
+PETSC_EXTERN PetscErrorCode RSVDLUSolverCreate(MPI_Comm, RSVDLUSolver*);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetOperator(RSVDLUSolver, Mat, PetscBool);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetInputOutput(RSVDLUSolver, Mat, Mat);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetWeights(RSVDLUSolver, Mat, Mat, Mat);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetDiagonalWeights(RSVDLUSolver, Vec, Vec, Vec);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetDimensions(RSVDLUSolver, PetscInt, PetscInt);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetFrequencies(RSVDLUSolver, PetscInt, const PetscReal[]);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetMonitor(RSVDLUSolver, RSVDLUGainsFn, RSVDLUModesFn, void*);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSetFromOptions(RSVDLUSolver);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverSolve(RSVDLUSolver);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverGetGains(RSVDLUSolver, PetscInt*, PetscInt*, const PetscReal**);
+PETSC_EXTERN PetscErrorCode RSVDLUSolverDestroy(RSVDLUSolver*);
+
+#endif
\ No newline at end of file
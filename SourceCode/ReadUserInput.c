@@ -1,16 +1,22 @@
 
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
 
-PetscErrorCode ReadUserInput(RSVD_vars *RSVD, Weight_matrices *Weight, Directories *dirs)
+PetscErrorCode ReadUserInput(RSVD_vars *RSVD, Directories *dirs)
 {
 	/*
 		Reads in user input parameters
+		The weight and input/output matrix options are read per configuration by ReadWeightInput()
 	*/
 
 	PetscErrorCode        ierr;
 	PetscBool             flg_set;
-	char                  filename[PETSC_MAX_PATH_LEN];
+	PetscInt              is, nthreads;
+	char                  filename[PETSC_MAX_PATH_LEN], option[64], env[64];
+	const char           *StageThreads[NUM_STAGES] = {"ThreadsLU", "ThreadsSolve", "ThreadsDense"};
 
 	PetscFunctionBeginUser;
 
@@ -22,6 +28,12 @@ PetscErrorCode ReadUserInput(RSVD_vars *RSVD, Weight_matrices *Weight, Directori
 		RSVD->RandSeed = 1373;
 		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'RandSeed' variable not found. Setting 'RandSeed' to default value: %d\n", (int) RSVD->RandSeed);
 	}	
+	ierr = PetscOptionsGetInt(NULL,NULL,"-SketchOpt",&RSVD->SketchOpt,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->SketchOpt = SKETCH_GAUSSIAN;
+	} else if (RSVD->SketchOpt < SKETCH_GAUSSIAN || RSVD->SketchOpt > SKETCH_SRFT) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SketchOpt' must be 0, 1, 2 or 3, current value: %d", (int) RSVD->SketchOpt);CHKERRQ(ierr);
+	}
 	ierr = PetscOptionsGetInt(NULL,NULL,"-k",&RSVD->k,&flg_set);CHKERRQ(ierr);
 	if (!flg_set) {
 		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'k'");CHKERRQ(ierr);
@@ -34,6 +46,12 @@ PetscErrorCode ReadUserInput(RSVD_vars *RSVD, Weight_matrices *Weight, Directori
 	} else if (RSVD->q < 0) {
 		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'q' must be a non-negative integer, current value: %d", (int) RSVD->q);CHKERRQ(ierr);
 	}	
+	ierr = PetscOptionsGetReal(NULL,NULL,"-PowerTol",&RSVD->PowerTol,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->PowerTol = 0;
+	} else if (RSVD->PowerTol < 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'PowerTol' must be non-negative, current value: %g", RSVD->PowerTol);CHKERRQ(ierr);
+	}
 	ierr = PetscOptionsGetInt(NULL,NULL,"-Display",&RSVD->Display,&flg_set);CHKERRQ(ierr);
 	if (!flg_set) {
 		RSVD->Display = 2;
@@ -52,6 +70,8 @@ PetscErrorCode ReadUserInput(RSVD_vars *RSVD, Weight_matrices *Weight, Directori
 	} else if (RSVD->dw <= 0) {
 		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'dw' must be positive, current value: %g", RSVD->dw);CHKERRQ(ierr);
 	}
+	RSVD->w_list   = NULL;
+	RSVD->InMemory = PETSC_FALSE;
 	ierr = PetscOptionsGetBool(NULL,NULL,"-DiscFlg",&RSVD->Disc.DiscFlg,&flg_set);CHKERRQ(ierr);
 	if (!flg_set) {
 		RSVD->Disc.DiscFlg = 0;
@@ -65,51 +85,278 @@ PetscErrorCode ReadUserInput(RSVD_vars *RSVD, Weight_matrices *Weight, Directori
 		RSVD->TwoPI = 0;
 		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'TwoPI' variable not found. Setting 'TwoPI' to default value: %d\n", (int) RSVD->TwoPI);
 	}
+	ierr = PetscOptionsGetBool(NULL,NULL,"-DryRun",&RSVD->Plan.DryRun,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Plan.DryRun = PETSC_FALSE;
+	ierr = PetscOptionsGetInt(NULL,NULL,"-PlanNumFreqs",&RSVD->Plan.NumFreqs,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Plan.NumFreqs = 3;
+	ierr = PetscOptionsGetInt(NULL,NULL,"-PlanRanksPerNode",&RSVD->Plan.RanksPerNode,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Plan.RanksPerNode = 128;
+	ierr = PetscOptionsGetReal(NULL,NULL,"-PlanNodeMem",&RSVD->Plan.NodeMem,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Plan.NodeMem = 256;
+	ierr = PetscOptionsGetReal(NULL,NULL,"-PlanGflops",&RSVD->Plan.Gflops,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Plan.Gflops = 5;
+	ierr = PetscOptionsGetReal(NULL,NULL,"-PlanWalltime",&RSVD->Plan.Walltime,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Plan.Walltime = 24;
+	if (RSVD->Plan.DryRun && (RSVD->Plan.NumFreqs < 1 || RSVD->Plan.RanksPerNode < 1 || RSVD->Plan.NodeMem <= 0 || RSVD->Plan.Gflops <= 0 || RSVD->Plan.Walltime <= 0)) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'PlanNumFreqs', 'PlanRanksPerNode', 'PlanNodeMem', 'PlanGflops' and 'PlanWalltime' must be positive");
+	}
+	ierr = PetscOptionsGetBool(NULL,NULL,"-StatusFlg",&RSVD->StatusFlg,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->StatusFlg = PETSC_TRUE;
+	ierr = PetscOptionsGetBool(NULL,NULL,"-AsyncIO",&RSVD->AsyncIO,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->AsyncIO = PETSC_FALSE;
+	ierr = PetscOptionsGetInt(NULL,NULL,"-IOBuffers",&RSVD->IOBuffers,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->IOBuffers = 2;
+	} else if (RSVD->IOBuffers < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'IOBuffers' must be a positive integer, current value: %d", (int) RSVD->IOBuffers);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-SaveModesNum",&RSVD->SaveModesNum,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->SaveModesNum = RSVD->k;
+	} else if (RSVD->SaveModesNum < 1 || RSVD->SaveModesNum > RSVD->k) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveModesNum' must be between 1 and k = %d, current value: %d", (int) RSVD->k, (int) RSVD->SaveModesNum);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-ExactOpt",&RSVD->ExactOpt,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->ExactOpt = 1;
+	} else if (RSVD->ExactOpt < 0 || RSVD->ExactOpt > 2) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'ExactOpt' must be 0, 1 or 2, current value: %d", (int) RSVD->ExactOpt);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-SaveModesOpt",&RSVD->SaveModesOpt,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->SaveModesOpt = 1;
+	} else if (RSVD->SaveModesOpt < 0 || RSVD->SaveModesOpt > 3) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveModesOpt' must be 0, 1, 2 or 3, current value: %d", (int) RSVD->SaveModesOpt);CHKERRQ(ierr);
+	}
+	RSVD->NumSaveModesList = MAX_NUM_SAVED;
+	ierr = PetscOptionsGetIntArray(NULL,NULL,"-SaveModesList",RSVD->SaveModesList,&RSVD->NumSaveModesList,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->NumSaveModesList = 0;
+	if (RSVD->SaveModesOpt == 2 && !RSVD->NumSaveModesList) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveModesOpt' = 2 requires 'SaveModesList'");
+	ierr = PetscOptionsGetBool(NULL,NULL,"-SinglePrec",&RSVD->SinglePrec,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->SinglePrec = PETSC_FALSE;
+	ierr = PetscOptionsGetReal(NULL,NULL,"-CompressTol",&RSVD->CompressTol,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->CompressTol = 0;
+	} else if (RSVD->CompressTol < 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'CompressTol' must be non-negative, current value: %g", RSVD->CompressTol);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-SaveResultsOpt",&RSVD->SaveResultsOpt,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->SaveResultsOpt = 2;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'SaveResultsOpt' variable not found. Setting 'SaveResultsOpt' to default value: %d\n", (int) RSVD->SaveResultsOpt);
+	} else if (RSVD->SaveResultsOpt != 1 && RSVD->SaveResultsOpt != 2) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveResultsOpt' must be 1 or 2, current value: %d", (int) RSVD->SaveResultsOpt);CHKERRQ(ierr);
+	}
+	if (RSVD->SaveResultsOpt == 1 && (RSVD->SinglePrec || RSVD->CompressTol > 0)) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveResultsOpt' = 1 saves the modes in double precision, set 'SinglePrec' and 'CompressTol' to zero");
+	if (RSVD->SaveResultsOpt == 1 && RSVD->AsyncIO) ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'AsyncIO' is ignored with 'SaveResultsOpt' = 1\n");
+	RSVD->CompressBits = 0;
+	if (RSVD->CompressTol > 0) {
+		for (RSVD->CompressBits=8; RSVD->CompressBits<32; RSVD->CompressBits*=2) {
+			if (0.5/(PetscPowReal(2.,RSVD->CompressBits-1)-1) <= RSVD->CompressTol) break;
+		}
+		if (0.5/(PetscPowReal(2.,RSVD->CompressBits-1)-1) > RSVD->CompressTol) {
+			RSVD->CompressBits = 0;
+			ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'CompressTol' = %g is below the 32-bit quantization error, the modes are saved without compression\n", RSVD->CompressTol);
+		}
+	}
 	ierr = PetscOptionsGetString(NULL, NULL,"-RootDir",(char*)&dirs->RootDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
 	if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'RootDir'");CHKERRQ(ierr);
 	ierr = PetscOptionsGetString(NULL, NULL,"-ResultsDir",(char*)&dirs->ResultsDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
 	if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'ResultsDir'");CHKERRQ(ierr);
-	ierr = PetscOptionsGetString(NULL, NULL,"-OperatorDir",(char*)&dirs->OperatorDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
-	if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'OperatorDir'");CHKERRQ(ierr);
-	ierr = PetscOptionsGetBool(NULL,NULL,"-InvInputWeightFlg",&Weight->InvInputWeightFlg,&flg_set);CHKERRQ(ierr);	
-	if (!flg_set) {
-		Weight->InvInputWeightFlg = 0;
-		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'InvInputWeightFlg' variable not found. Setting 'InputWeightFlg' to default value: %d\n", (int) Weight->InvInputWeightFlg);
-	} else if (Weight->InvInputWeightFlg) {
-		ierr = PetscOptionsGetString(NULL,NULL,"-InvInputWeightDir",(char*)&dirs->InvInputWeightDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
-		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'InvInputWeightDir'");CHKERRQ(ierr);
-	}
-	ierr = PetscOptionsGetBool(NULL,NULL,"-OutputWeightFlg",&Weight->OutputWeightFlg,&flg_set);CHKERRQ(ierr);	
-	if (!flg_set) {
-		Weight->OutputWeightFlg = 0;
-		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'OutputWeightFlg' variable not found. Setting 'OutputWeightFlg' to default value: %d\n", (int) Weight->OutputWeightFlg);
-	} else if (Weight->OutputWeightFlg) {
-		ierr = PetscOptionsGetString(NULL,NULL,"-OutputWeightDir",(char*)&dirs->OutputWeightDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
-		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'OutputWeightDir'");CHKERRQ(ierr);
-	}
-	ierr = PetscOptionsGetBool(NULL,NULL,"-InvOutputWeightFlg",&Weight->InvOutputWeightFlg,&flg_set);CHKERRQ(ierr);	
-	if (!flg_set) {
-		Weight->InvOutputWeightFlg = 0;
-		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'InvOutputWeightFlg' variable not found. Setting 'InvOutputWeightFlg' to default value: %d\n", (int) Weight->InvOutputWeightFlg);
-	} else if (Weight->InvOutputWeightFlg) {
-		ierr = PetscOptionsGetString(NULL,NULL,"-InvOutputWeightDir",(char*)&dirs->InvOutputWeightDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
-		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'InvOutputWeightDir'");CHKERRQ(ierr);
-	}
-	ierr = PetscOptionsGetBool(NULL,NULL,"-InputMatrixFlg",&Weight->InputMatrixFlg,&flg_set);CHKERRQ(ierr);	
-	if (!flg_set) {
-		Weight->InputMatrixFlg = 0;
-		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'InputMatrixFlg' variable not found. Setting 'InputMatrixFlg' to default value: %d\n", (int) Weight->InputMatrixFlg);
-	} else if (Weight->InputMatrixFlg) {
-		ierr = PetscOptionsGetString(NULL,NULL,"-InputMatrixDir",(char*)&dirs->InputMatrixDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
-		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'InputMatrixDir'");CHKERRQ(ierr);
-	}
-	ierr = PetscOptionsGetBool(NULL,NULL,"-OutputMatrixFlg",&Weight->OutputMatrixFlg,&flg_set);CHKERRQ(ierr);	
-	if (!flg_set) {
-		Weight->OutputMatrixFlg = 0;
-		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'OutputMatrixFlg' variable not found. Setting 'OutputMatrixFlg' to default value: %d\n", (int) Weight->OutputMatrixFlg);
-	} else if (Weight->OutputMatrixFlg) {
-		ierr = PetscOptionsGetString(NULL,NULL,"-OutputMatrixDir",(char*)&dirs->OutputMatrixDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
-		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'OutputMatrixDir'");CHKERRQ(ierr);
+	RSVD->NumOps = MAX_NUM_OPS;
+	ierr = PetscOptionsGetStringArray(NULL,NULL,"-OperatorList",dirs->OperatorList,&RSVD->NumOps,&flg_set);CHKERRQ(ierr);
+	if (!flg_set || RSVD->NumOps == 0) {
+		ierr = PetscOptionsGetString(NULL, NULL,"-OperatorDir",(char*)&dirs->OperatorDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'OperatorDir' or 'OperatorList'");CHKERRQ(ierr);
+		RSVD->NumOps = 1;
+		ierr = PetscStrallocpy(dirs->OperatorDir,&dirs->OperatorList[0]);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetString(NULL,NULL,"-FactorCacheDir",(char*)&dirs->FactorCacheDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) dirs->FactorCacheDir[0] = 0;
+	ierr = PetscOptionsGetReal(NULL,NULL,"-FactorCacheSize",&RSVD->FactorCacheSize,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->FactorCacheSize = 0;
+	} else if (RSVD->FactorCacheSize < 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'FactorCacheSize' must be non-negative, current value: %g", RSVD->FactorCacheSize);CHKERRQ(ierr);
+	}
+
+	ierr = PetscOptionsGetBool(NULL,NULL,"-Benchmark",&RSVD->Bench.Flg,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Bench.Flg = PETSC_FALSE;
+	RSVD->Bench.NumGrid = 3;
+	ierr = PetscOptionsGetIntArray(NULL,NULL,"-BenchGrid",RSVD->Bench.Grid,&RSVD->Bench.NumGrid,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Bench.NumGrid = 0;
+	if (RSVD->Bench.NumGrid == 1 || (RSVD->Bench.NumGrid && PetscMin(RSVD->Bench.Grid[0],RSVD->Bench.Grid[1]) < 1) || (RSVD->Bench.NumGrid == 3 && RSVD->Bench.Grid[2] < 1)) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BenchGrid' must hold 2 or 3 positive integers (nx, ny[, nz])");
+	}
+	if (RSVD->Bench.NumGrid == 2) RSVD->Bench.Grid[2] = 1;
+	if (RSVD->Bench.NumGrid && RSVD->NumOps > 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BenchGrid' requires a single operator (OperatorDir)");
+	if (RSVD->Bench.NumGrid && RSVD->Plan.DryRun) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BenchGrid' cannot be combined with 'DryRun' (the synthetic files are saved in the results folder)");
+	ierr = PetscOptionsGetReal(NULL,NULL,"-BenchPeclet",&RSVD->Bench.Peclet,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Bench.Peclet = 100;
+	} else if (RSVD->Bench.Peclet <= 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BenchPeclet' must be positive, current value: %g", RSVD->Bench.Peclet);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-BenchReps",&RSVD->Bench.Reps,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Bench.Reps = 3;
+	} else if (RSVD->Bench.Reps < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BenchReps' must be a positive integer, current value: %d", (int) RSVD->Bench.Reps);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-BenchExactMaxN",&RSVD->Bench.ExactMaxN,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Bench.ExactMaxN = 4000;
+	} else if (RSVD->Bench.ExactMaxN < 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BenchExactMaxN' must be a non-negative integer, current value: %d", (int) RSVD->Bench.ExactMaxN);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetString(NULL,NULL,"-BenchCSV",filename,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) ierr = PetscStrncpy(filename,"RSVDLU_Benchmark.csv",PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(dirs->BenchCSV,PETSC_MAX_PATH_LEN,"%s%s%s",dirs->RootDir,dirs->ResultsDir,filename);CHKERRQ(ierr);
+
+	/*
+		Batch mode: the (operator, frequency) tasks are shared out among independent groups of BatchGroupSize ranks
+	*/
+
+	ierr = PetscOptionsGetBool(NULL,NULL,"-Batch",&RSVD->Batch.Flg,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Batch.Flg = PETSC_FALSE;
+	ierr = PetscOptionsGetInt(NULL,NULL,"-BatchGroupSize",&RSVD->Batch.GroupSize,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Batch.GroupSize = 1;
+	} else if (RSVD->Batch.GroupSize < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BatchGroupSize' must be a positive integer, current value: %d", (int) RSVD->Batch.GroupSize);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-BatchDenseMaxN",&RSVD->Batch.DenseMaxN,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Batch.DenseMaxN = 2000;
+	} else if (RSVD->Batch.DenseMaxN < 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BatchDenseMaxN' must be a non-negative integer, current value: %d", (int) RSVD->Batch.DenseMaxN);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetBool(NULL,NULL,"-BatchShared",&RSVD->Batch.Shared,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Batch.Shared = PETSC_FALSE;
+	if (RSVD->Batch.Shared && !RSVD->Batch.Flg) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BatchShared' requires 'Batch'");
+	if (RSVD->Batch.Shared && RSVD->Batch.GroupSize > 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BatchShared' requires 'BatchGroupSize' = 1 (sequential matrices)");
+	if (RSVD->Batch.Flg) {
+		if (RSVD->Bench.Flg || RSVD->Plan.DryRun) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'Batch' cannot be combined with 'Benchmark' or 'DryRun'");
+		if (RSVD->SaveResultsOpt != 2) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'Batch' requires 'SaveResultsOpt' = 2 (the frequencies of an operator may be split among groups)");
+		if (RSVD->SaveModesOpt == 3) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveModesOpt' = 3 is not supported with 'Batch'");
+		if (dirs->FactorCacheDir[0]) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'FactorCacheDir' is not supported with 'Batch'");
+	}
+
+	/*
+		OpenMP threads per rank of the LU, solve and dense stages, by default OMP_NUM_THREADS
+		MUMPS receives the LU/solve counts through ICNTL(16); the dense kernels need an OpenMP build
+	*/
+
+	ierr = PetscOptionsGetenv(PETSC_COMM_WORLD,"OMP_NUM_THREADS",env,sizeof(env),&flg_set);CHKERRQ(ierr);
+	nthreads = flg_set ? PetscMax(atoi(env),1) : 1;
+#if defined(_OPENMP)
+	nthreads = omp_get_max_threads();
+#endif
+	for (is=0; is<NUM_STAGES; is++) {
+		ierr = PetscSNPrintf(option,sizeof(option),"-%s",StageThreads[is]);CHKERRQ(ierr);
+		ierr = PetscOptionsGetInt(NULL,NULL,option,&RSVD->Threads[is],&flg_set);CHKERRQ(ierr);
+		if (!flg_set) {
+			RSVD->Threads[is] = nthreads;
+		} else if (RSVD->Threads[is] < 1) {
+			SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'%s' must be a positive integer, current value: %d", StageThreads[is], (int) RSVD->Threads[is]);CHKERRQ(ierr);
+		}
+	}
+#if !defined(_OPENMP)
+	if (RSVD->Threads[STAGE_DENSE] > 1) {
+		RSVD->Threads[STAGE_DENSE] = 1;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: compiled without OpenMP (make OPENMP=1). Setting 'ThreadsDense' to 1\n");
+	}
+#endif
+	ierr = PetscOptionsGetInt(NULL,NULL,"-BlockSize",&RSVD->BlockSize,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->BlockSize = 1;
+	} else if (RSVD->BlockSize < 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'BlockSize' must be a non-negative integer, current value: %d", (int) RSVD->BlockSize);CHKERRQ(ierr);
+	}
+	RSVD->NumConfigs = MAX_NUM_CONFIGS;
+	ierr = PetscOptionsGetStringArray(NULL,NULL,"-ConfigList",dirs->ConfigList,&RSVD->NumConfigs,&flg_set);CHKERRQ(ierr);
+	if (!flg_set || RSVD->NumConfigs == 0) {
+		RSVD->NumConfigs    = 1;
+		dirs->ConfigList[0] = NULL;
+	}
+	if (RSVD->NumConfigs > 1 && RSVD->SaveModesOpt == 3) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveModesOpt' = 3 is not supported with more than one entry in 'ConfigList'");
+
+	/*
+		Screening: gains estimated from eigenpairs of A near the imaginary axis, RSVD-LU only where unreliable
+	*/
+
+	ierr = PetscOptionsGetBool(NULL,NULL,"-Screening",&RSVD->Screen.Flg,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->Screen.Flg = PETSC_FALSE;
+	ierr = PetscOptionsGetInt(NULL,NULL,"-ScreenNev",&RSVD->Screen.Nev,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Screen.Nev = 50;
+	} else if (RSVD->Screen.Nev < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'ScreenNev' must be a positive integer, current value: %d", (int) RSVD->Screen.Nev);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-ScreenShifts",&RSVD->Screen.Shifts,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Screen.Shifts = 4;
+	} else if (RSVD->Screen.Shifts < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'ScreenShifts' must be a positive integer, current value: %d", (int) RSVD->Screen.Shifts);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-ScreenRefine",&RSVD->Screen.Refine,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Screen.Refine = 10;
+	} else if (RSVD->Screen.Refine < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'ScreenRefine' must be a positive integer, current value: %d", (int) RSVD->Screen.Refine);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetReal(NULL,NULL,"-ScreenFactor",&RSVD->Screen.Factor,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->Screen.Factor = 10;
+	} else if (RSVD->Screen.Factor <= 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'ScreenFactor' must be positive, current value: %g", RSVD->Screen.Factor);CHKERRQ(ierr);
+	}
+	RSVD->Screen.Full = NULL;
+	if (RSVD->Screen.Flg) {
+		if (RSVD->NumOps > 1 || RSVD->NumConfigs > 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'Screening' requires a single operator and configuration");
+		if (RSVD->Batch.Flg || RSVD->Bench.Flg || RSVD->Plan.DryRun) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'Screening' cannot be combined with 'Batch', 'Benchmark' or 'DryRun'");
+		if (RSVD->SaveModesOpt == 3) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'SaveModesOpt' = 3 is not supported with 'Screening'");
+	}
+
+	/*
+		Multi-shift Krylov solver: windows of MultiShiftWindow frequencies share the LU of their central frequency
+	*/
+
+	ierr = PetscOptionsGetBool(NULL,NULL,"-MultiShift",&RSVD->MShift.Flg,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->MShift.Flg = PETSC_FALSE;
+	ierr = PetscOptionsGetInt(NULL,NULL,"-MultiShiftWindow",&RSVD->MShift.Window,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->MShift.Window = 8;
+	} else if (RSVD->MShift.Window < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'MultiShiftWindow' must be a positive integer, current value: %d", (int) RSVD->MShift.Window);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetReal(NULL,NULL,"-MultiShiftTol",&RSVD->MShift.Tol,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->MShift.Tol = 1e-8;
+	} else if (RSVD->MShift.Tol <= 0) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'MultiShiftTol' must be positive, current value: %g", RSVD->MShift.Tol);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetInt(NULL,NULL,"-MultiShiftMaxIt",&RSVD->MShift.MaxIt,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) {
+		RSVD->MShift.MaxIt = 100;
+	} else if (RSVD->MShift.MaxIt < 1) {
+		SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'MultiShiftMaxIt' must be a positive integer, current value: %d", (int) RSVD->MShift.MaxIt);CHKERRQ(ierr);
+	}
+	if (RSVD->MShift.Flg) {
+		if (RSVD->NumConfigs > 1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'MultiShift' requires a single configuration");
+		if (RSVD->Batch.Flg || RSVD->Bench.Flg || RSVD->Plan.DryRun) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'MultiShift' cannot be combined with 'Batch', 'Benchmark' or 'DryRun'");
+	}
+
+	/*
+		Low-memory mode: A_org shifted in place, LU freed before the last SVD, SVDs through in-place QR
+	*/
+
+	ierr = PetscOptionsGetBool(NULL,NULL,"-LowMemory",&RSVD->LowMemory,&flg_set);CHKERRQ(ierr);
+	if (!flg_set) RSVD->LowMemory = PETSC_FALSE;
+	if (RSVD->LowMemory) {
+		if (RSVD->MShift.Flg) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'LowMemory' cannot be combined with 'MultiShift' (the LU is shared by a window of frequencies)");
+		if (dirs->FactorCacheDir[0]) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'LowMemory' cannot be combined with 'FactorCacheDir'");
+		if (RSVD->Batch.Shared) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"'LowMemory' cannot be combined with 'BatchShared' (the shared operators are read-only)");
 	}
 	
 	PetscFunctionReturn(0);
@@ -2,6 +2,6 @@
 #ifndef READUSERINPUT_H
 #define READUSERINPUT_H
 
-PetscErrorCode ReadUserInput(RSVD_vars*, Weight_matrices*, Directories*);
+PetscErrorCode ReadUserInput(RSVD_vars*, Directories*);
 
 #endif
\ No newline at end of file
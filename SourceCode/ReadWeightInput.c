@@ -0,0 +1,71 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+
+PetscErrorCode ReadWeightInput(Weight_matrices *Weight, const char *name)
+{
+	/*
+		Reads in the weight and input/output matrix options of one configuration
+		For a named configuration (ConfigList), the options are read from the block of the same name
+		in the input file, i.e., with the option prefix <name>_, otherwise from the top level
+	*/
+
+	PetscErrorCode        ierr;
+	PetscBool             flg_set;
+	char                  prefix[PETSC_MAX_PATH_LEN], cfg[PETSC_MAX_PATH_LEN];
+	const char           *pre = NULL;
+
+	PetscFunctionBeginUser;
+
+	prefix[0] = 0;
+	cfg[0]    = 0;
+	if (name) {
+		ierr = PetscSNPrintf(prefix,PETSC_MAX_PATH_LEN,"%s_",name);CHKERRQ(ierr);
+		pre  = prefix;
+		ierr = PetscSNPrintf(cfg,PETSC_MAX_PATH_LEN," in configuration '%s'",name);CHKERRQ(ierr);
+	}
+
+	ierr = PetscOptionsGetBool(NULL,pre,"-InvInputWeightFlg",&Weight->InvInputWeightFlg,&flg_set);CHKERRQ(ierr);	
+	if (!flg_set) {
+		Weight->InvInputWeightFlg = 0;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'InvInputWeightFlg' variable not found%s. Setting 'InputWeightFlg' to default value: %d\n", cfg, (int) Weight->InvInputWeightFlg);
+	} else if (Weight->InvInputWeightFlg) {
+		ierr = PetscOptionsGetString(NULL,pre,"-InvInputWeightDir",Weight->InvInputWeightDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'InvInputWeightDir'%s", cfg);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetBool(NULL,pre,"-OutputWeightFlg",&Weight->OutputWeightFlg,&flg_set);CHKERRQ(ierr);	
+	if (!flg_set) {
+		Weight->OutputWeightFlg = 0;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'OutputWeightFlg' variable not found%s. Setting 'OutputWeightFlg' to default value: %d\n", cfg, (int) Weight->OutputWeightFlg);
+	} else if (Weight->OutputWeightFlg) {
+		ierr = PetscOptionsGetString(NULL,pre,"-OutputWeightDir",Weight->OutputWeightDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'OutputWeightDir'%s", cfg);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetBool(NULL,pre,"-InvOutputWeightFlg",&Weight->InvOutputWeightFlg,&flg_set);CHKERRQ(ierr);	
+	if (!flg_set) {
+		Weight->InvOutputWeightFlg = 0;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'InvOutputWeightFlg' variable not found%s. Setting 'InvOutputWeightFlg' to default value: %d\n", cfg, (int) Weight->InvOutputWeightFlg);
+	} else if (Weight->InvOutputWeightFlg) {
+		ierr = PetscOptionsGetString(NULL,pre,"-InvOutputWeightDir",Weight->InvOutputWeightDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+		if (!flg_set) Weight->InvOutputWeightDir[0] = 0; /* derived from a diagonal W_q_sqrt in ReadWeightMats() */
+	}
+	ierr = PetscOptionsGetBool(NULL,pre,"-InputMatrixFlg",&Weight->InputMatrixFlg,&flg_set);CHKERRQ(ierr);	
+	if (!flg_set) {
+		Weight->InputMatrixFlg = 0;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'InputMatrixFlg' variable not found%s. Setting 'InputMatrixFlg' to default value: %d\n", cfg, (int) Weight->InputMatrixFlg);
+	} else if (Weight->InputMatrixFlg) {
+		ierr = PetscOptionsGetString(NULL,pre,"-InputMatrixDir",Weight->InputMatrixDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'InputMatrixDir'%s", cfg);CHKERRQ(ierr);
+	}
+	ierr = PetscOptionsGetBool(NULL,pre,"-OutputMatrixFlg",&Weight->OutputMatrixFlg,&flg_set);CHKERRQ(ierr);	
+	if (!flg_set) {
+		Weight->OutputMatrixFlg = 0;
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"Warning: 'OutputMatrixFlg' variable not found%s. Setting 'OutputMatrixFlg' to default value: %d\n", cfg, (int) Weight->OutputMatrixFlg);
+	} else if (Weight->OutputMatrixFlg) {
+		ierr = PetscOptionsGetString(NULL,pre,"-OutputMatrixDir",Weight->OutputMatrixDir,PETSC_MAX_PATH_LEN,&flg_set);CHKERRQ(ierr);
+		if (!flg_set) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'OutputMatrixDir'%s", cfg);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+}
+
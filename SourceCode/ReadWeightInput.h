@@ -0,0 +1,7 @@
+
+#ifndef READWEIGHTINPUT_H
+#define READWEIGHTINPUT_H
+
+PetscErrorCode ReadWeightInput(Weight_matrices*, const char*);
+
+#endif
\ No newline at end of file
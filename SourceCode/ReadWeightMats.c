@@ -1,6 +1,69 @@
 
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
+#include <BlockLayout.h>
+
+static PetscErrorCode LoadWeight(RSVD_vars *RSVD, const char *filename, const char *name, Mat *W, Vec *w, PetscInt *n)
+{
+	/*
+		Loads a square weight matrix, or a vector holding the diagonal of a diagonal weight matrix
+		A matrix without nonzero off-diagonal entries is converted to a vector as well
+	*/
+
+	PetscErrorCode        ierr;
+	PetscViewer           fd;
+	PetscInt              header[2], row, col, rstart, rend, ncols, bs, i, j;
+	const PetscInt       *cols;
+	const PetscScalar    *vals;
+	PetscBool             diag;
+
+	PetscFunctionBeginUser;
+
+	*W = NULL;
+	*w = NULL;
+
+	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&fd);CHKERRQ(ierr);
+	ierr = PetscViewerBinaryRead(fd,header,2,NULL,PETSC_INT);CHKERRQ(ierr);
+	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+
+	if (header[0] == VEC_FILE_CLASSID) {
+		ierr = GetBlockSize(RSVD, header[1], &bs);CHKERRQ(ierr);
+		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_READ,&fd);CHKERRQ(ierr);
+		ierr = VecCreate(PETSC_COMM_WORLD,w);CHKERRQ(ierr);
+		ierr = VecSetBlockSize(*w,bs);CHKERRQ(ierr);
+		ierr = VecLoad(*w,fd);CHKERRQ(ierr);
+		ierr = VecGetSize(*w,n);CHKERRQ(ierr);
+		ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+	} else {
+		ierr = LoadSparseMat(RSVD, filename, W);CHKERRQ(ierr);
+		ierr = MatGetSize(*W,&row,&col);CHKERRQ(ierr);
+		if (row != col) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"%s must be square, current size = %d x %d", name, (int)row, (int)col);CHKERRQ(ierr);
+		*n = row;
+
+		/*
+			Detects a diagonal matrix (no nonzero entry off the diagonal, also inside the blocks of BAIJ)
+		*/
+
+		diag = PETSC_TRUE;
+		ierr = MatGetOwnershipRange(*W,&rstart,&rend);CHKERRQ(ierr);
+		for (i=rstart; diag && i<rend; i++) {
+			ierr = MatGetRow(*W,i,&ncols,&cols,&vals);CHKERRQ(ierr);
+			for (j=0; j<ncols; j++) {
+				if (cols[j] != i && vals[j] != 0.) diag = PETSC_FALSE;
+			}
+			ierr = MatRestoreRow(*W,i,&ncols,&cols,&vals);CHKERRQ(ierr);
+		}
+		ierr = MPI_Allreduce(MPI_IN_PLACE,&diag,1,MPIU_BOOL,MPI_LAND,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+		if (diag) {
+			ierr = MatCreateVecs(*W,NULL,w);CHKERRQ(ierr);
+			ierr = MatGetDiagonal(*W,*w);CHKERRQ(ierr);
+			ierr = MatDestroy(W);CHKERRQ(ierr);
+		}
+	}
+
+	PetscFunctionReturn(0);
+
+}
 
 PetscErrorCode ReadWeightMats(RSVD_vars *RSVD, Weight_matrices *Weight, Directories *dirs)
 {
@@ -15,35 +78,38 @@ PetscErrorCode ReadWeightMats(RSVD_vars *RSVD, Weight_matrices *Weight, Director
 
 		If any of these matrix dimensions mismatch the expected sizes, an error will occur.
 		If the flag is off, an identity matrix is assumed.
+
+		Weights given as vectors, or as matrices with a diagonal pattern, are kept as vectors (w_*) and
+		applied by row scaling; W_q_sqrt_inv is then the reciprocal of W_q_sqrt if InvOutputWeightDir is empty.
 	*/
 
 	PetscErrorCode        ierr;
-	PetscViewer           fd;
-	PetscInt              row1, col1, row2, col2;
+	PetscInt              row1, col1, row2, col2, rowqi = 0;
 
 	PetscFunctionBeginUser;
 
+	Weight->W_f_sqrt_inv = NULL;
+	Weight->W_q_sqrt_inv = NULL;
+	Weight->W_q_sqrt     = NULL;
+	Weight->w_f_sqrt_inv = NULL;
+	Weight->w_q_sqrt_inv = NULL;
+	Weight->w_q_sqrt     = NULL;
+
 	if (Weight->InvInputWeightFlg) {
-		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->InvInputWeightDir);CHKERRQ(ierr);
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,Weight->InvInputWeightDir);CHKERRQ(ierr);
 		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\nReading the inverse input weight matrix  : %s\n", dirs->IO_dir);
-		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
-		ierr = MatCreate(PETSC_COMM_WORLD,&Weight->W_f_sqrt_inv);CHKERRQ(ierr);
-		ierr = MatSetType(Weight->W_f_sqrt_inv,MATMPIAIJ);CHKERRQ(ierr);
-		ierr = MatLoad(Weight->W_f_sqrt_inv,fd);CHKERRQ(ierr); 
-		ierr = MatGetSize(Weight->W_f_sqrt_inv,&row1,&col1);CHKERRQ(ierr); 
-		if (row1 != col1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Input weight matrix (W_f_sqrt_inv) must be square, current size = %d x %d", (int)row1, (int)col1);CHKERRQ(ierr);   
+		ierr = LoadWeight(RSVD,dirs->IO_dir,"Input weight matrix (W_f_sqrt_inv)",&Weight->W_f_sqrt_inv,&Weight->w_f_sqrt_inv,&row1);CHKERRQ(ierr);
+		col1 = row1;
+		if (RSVD->Display && Weight->w_f_sqrt_inv) ierr = PetscPrintf(PETSC_COMM_WORLD,"    (diagonal, applied as a vector)\n");CHKERRQ(ierr);
 	} else {
 		row1 = RSVD->N;
 		col1 = RSVD->N;
 	}
 
 	if (Weight->InputMatrixFlg) {
-		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->InputMatrixDir);CHKERRQ(ierr);
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,Weight->InputMatrixDir);CHKERRQ(ierr);
 		if (RSVD->Display > 0) ierr = PetscPrintf(PETSC_COMM_WORLD,"Reading the input matrix                 : %s\n", dirs->IO_dir);
-		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
-		ierr = MatCreate(PETSC_COMM_WORLD,&Weight->B);CHKERRQ(ierr);
-		ierr = MatSetType(Weight->B,MATMPIAIJ);CHKERRQ(ierr);	
-		ierr = MatLoad(Weight->B,fd);CHKERRQ(ierr);
+		ierr = LoadSparseMat(RSVD, dirs->IO_dir, &Weight->B);CHKERRQ(ierr);
 		ierr = MatGetSize(Weight->B,&row2,&col2);CHKERRQ(ierr); 
 		if (col2 != col1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between input matrix (B) and input weight matrix (W_f_sqrt_inv), %d != %d", (int)col2, (int)col1);CHKERRQ(ierr);
 		if (row2 != RSVD->N) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Input matrix (B) must have %d rows, current size = %d x %d", (int)RSVD->N, (int)row2, (int)col2);CHKERRQ(ierr);
@@ -53,54 +119,87 @@ PetscErrorCode ReadWeightMats(RSVD_vars *RSVD, Weight_matrices *Weight, Director
 		if (Weight->InvInputWeightFlg && RSVD->Nb != col1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between input matrix (B) and input weight matrix (W_f_sqrt_inv)");CHKERRQ(ierr);
 	}
 
-	if (Weight->InvOutputWeightFlg) {
-		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->InvOutputWeightDir);CHKERRQ(ierr);
+	if (Weight->InvOutputWeightFlg && Weight->InvOutputWeightDir[0]) {
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,Weight->InvOutputWeightDir);CHKERRQ(ierr);
 		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Reading the inverse output weight matrix : %s\n", dirs->IO_dir);
-		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
-		ierr = MatCreate(PETSC_COMM_WORLD,&Weight->W_q_sqrt_inv);CHKERRQ(ierr);
-		ierr = MatSetType(Weight->W_q_sqrt_inv,MATMPIAIJ);CHKERRQ(ierr);
-		ierr = MatLoad(Weight->W_q_sqrt_inv,fd);CHKERRQ(ierr);     
-		ierr = MatGetSize(Weight->W_q_sqrt_inv,&row1,&col1);CHKERRQ(ierr); 
-		if (row1 != col1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Inverse output weight matrix (W_q_sqrt_inv) must be square, current size = %d x %d", (int)row1, (int)col1);CHKERRQ(ierr); 
+		ierr = LoadWeight(RSVD,dirs->IO_dir,"Inverse output weight matrix (W_q_sqrt_inv)",&Weight->W_q_sqrt_inv,&Weight->w_q_sqrt_inv,&rowqi);CHKERRQ(ierr);
+		if (RSVD->Display && Weight->w_q_sqrt_inv) ierr = PetscPrintf(PETSC_COMM_WORLD,"    (diagonal, applied as a vector)\n");CHKERRQ(ierr);
 	}	
 
 	if (Weight->OutputWeightFlg) {
-		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->OutputWeightDir);CHKERRQ(ierr);
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,Weight->OutputWeightDir);CHKERRQ(ierr);
 		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Reading the output weight matrix         : %s\n", dirs->IO_dir);
-		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
-		ierr = MatCreate(PETSC_COMM_WORLD,&Weight->W_q_sqrt);CHKERRQ(ierr);
-		ierr = MatSetType(Weight->W_q_sqrt,MATMPIAIJ);CHKERRQ(ierr);
-		ierr = MatLoad(Weight->W_q_sqrt,fd);CHKERRQ(ierr);      
-		ierr = MatGetSize(Weight->W_q_sqrt,&row1,&col1);CHKERRQ(ierr); 
-		if (row1 != col1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Output weight matrix (W_q_sqrt) must be square, current size = %d x %d", (int)row1, (int)col1);CHKERRQ(ierr);
+		ierr = LoadWeight(RSVD,dirs->IO_dir,"Output weight matrix (W_q_sqrt)",&Weight->W_q_sqrt,&Weight->w_q_sqrt,&row1);CHKERRQ(ierr);
+		col1 = row1;
+		if (RSVD->Display && Weight->w_q_sqrt) ierr = PetscPrintf(PETSC_COMM_WORLD,"    (diagonal, applied as a vector)\n");CHKERRQ(ierr);
 	} else {
 		row1 = RSVD->N;
 		col1 = RSVD->N;
 	}
 
+	/*
+		Inverse output weight from the diagonal output weight
+	*/
+
+	if (Weight->InvOutputWeightFlg && !Weight->InvOutputWeightDir[0]) {
+		if (!Weight->w_q_sqrt) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Must specify 'InvOutputWeightDir' unless the output weight (W_q_sqrt) is diagonal");
+		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Inverse output weight matrix             : reciprocal of the output weight\n");CHKERRQ(ierr);
+		ierr = VecDuplicate(Weight->w_q_sqrt,&Weight->w_q_sqrt_inv);CHKERRQ(ierr);
+		ierr = VecCopy(Weight->w_q_sqrt,Weight->w_q_sqrt_inv);CHKERRQ(ierr);
+		ierr = VecReciprocal(Weight->w_q_sqrt_inv);CHKERRQ(ierr);
+		rowqi = row1;
+	}
+
 	if (Weight->OutputMatrixFlg) {
-		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->OutputMatrixDir);CHKERRQ(ierr);
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,Weight->OutputMatrixDir);CHKERRQ(ierr);
 		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Reading the output matrix                : %s\n", dirs->IO_dir);
-		ierr = MatCreate(PETSC_COMM_WORLD,&Weight->C);CHKERRQ(ierr);
-		ierr = MatSetType(Weight->C,MATMPIAIJ);CHKERRQ(ierr);
-		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_READ,&fd);CHKERRQ(ierr);
-		ierr = MatLoad(Weight->C,fd);CHKERRQ(ierr);
+		ierr = LoadSparseMat(RSVD, dirs->IO_dir, &Weight->C);CHKERRQ(ierr);
 		ierr = MatGetSize(Weight->C,&row2,&col2);CHKERRQ(ierr); 
 		if (col2 != RSVD->N) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Output matrix (C) must have %d columns, current size = %d x %d", (int)RSVD->N, (int)row2, (int)col2);CHKERRQ(ierr);
 		RSVD->Nc = row2;
 		if (row2 != row1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between output matrix (C) and output weight matrix (W_q_sqrt), %d != %d", (int)row2, (int)row1);CHKERRQ(ierr);
 		if (Weight->InvOutputWeightFlg) {
-			ierr = MatGetSize(Weight->W_q_sqrt_inv,&row1,NULL);CHKERRQ(ierr);
-			if (row2 != row1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between output matrix (C) and inverse output weight matrix (W_q_sqrt_inv), %d != %d", (int)row2, (int)row1);CHKERRQ(ierr);
+			if (row2 != rowqi) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between output matrix (C) and inverse output weight matrix (W_q_sqrt_inv), %d != %d", (int)row2, (int)rowqi);CHKERRQ(ierr);
 		}
 	} else {
 		RSVD->Nc = RSVD->N;
 		if (Weight->OutputWeightFlg && RSVD->Nc != row1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between output matrix (C) and output weight matrix (W_q_sqrt)");CHKERRQ(ierr);
-		if (Weight->InvOutputWeightFlg) ierr = MatGetSize(Weight->W_q_sqrt_inv,&row1,NULL);CHKERRQ(ierr);
-		if (Weight->InvOutputWeightFlg && RSVD->Nc != row1) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between output matrix (C) and inverse output weight matrix (W_q_sqrt_inv)");CHKERRQ(ierr);
+		if (Weight->InvOutputWeightFlg && RSVD->Nc != rowqi) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Size mismatch between output matrix (C) and inverse output weight matrix (W_q_sqrt_inv)");CHKERRQ(ierr);
 	}
 
+	/*
+		The random sketch starts from the smaller of the input and output spaces
+	*/
+
+	RSVD->AdjointFirst   = (PetscBool) (RSVD->Nc < RSVD->Nb);
+	Weight->Nb           = RSVD->Nb;
+	Weight->Nc           = RSVD->Nc;
+	Weight->AdjointFirst = RSVD->AdjointFirst;
+	if (RSVD->Display && RSVD->AdjointFirst) ierr = PetscPrintf(PETSC_COMM_WORLD,"Output size (%d) < input size (%d): sketching from the output space (adjoint action first)\n", (int)RSVD->Nc, (int)RSVD->Nb);CHKERRQ(ierr);
+
 	PetscFunctionReturn(0);
 	
 }
 
+PetscErrorCode DestroyWeightMats(Weight_matrices *Weight)
+{
+	/*
+		Destroys the weight and input/output matrices of a configuration
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatDestroy(&Weight->W_f_sqrt_inv);CHKERRQ(ierr);
+	ierr = MatDestroy(&Weight->W_q_sqrt);CHKERRQ(ierr);
+	ierr = MatDestroy(&Weight->W_q_sqrt_inv);CHKERRQ(ierr);
+	ierr = VecDestroy(&Weight->w_f_sqrt_inv);CHKERRQ(ierr);
+	ierr = VecDestroy(&Weight->w_q_sqrt);CHKERRQ(ierr);
+	ierr = VecDestroy(&Weight->w_q_sqrt_inv);CHKERRQ(ierr);
+	if (Weight->InputMatrixFlg) ierr = MatDestroy(&Weight->B);CHKERRQ(ierr);
+	if (Weight->OutputMatrixFlg) ierr = MatDestroy(&Weight->C);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
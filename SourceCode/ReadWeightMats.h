@@ -3,5 +3,6 @@
 #define READWEIGHTMATS_H
 
 PetscErrorCode ReadWeightMats(RSVD_vars*, Weight_matrices*, Directories*);
+PetscErrorCode DestroyWeightMats(Weight_matrices*);
 
 #endif
\ No newline at end of file
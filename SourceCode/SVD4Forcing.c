@@ -1,60 +1,82 @@
 
 #include <slepcsvd.h>
 #include <Variables.h>
+#include <BlockLayout.h>
+#include <StageThreads.h>
+#include <SaveModes.h>
+#include <SaveModesPolicy.h>
+#include <QRDecomposition.h>
 
 PetscErrorCode SVD4Forcing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs, PetscInt iw)
 {
 	/*
 		Performs the economy SVD of a matrix of size N \times k
+		If the sketch starts from the output space, the matrix follows a direct action
+		and gives the response modes U and the gains
+		Low-memory mode: the SVD is computed in place through the QR decomposition (QRSVD) and Y_hat
+		becomes X, so no second N x k matrix is created
 	*/
 	
 	PetscErrorCode        ierr;
-	PetscInt              ik, hh, mm, ss;
-	PetscReal             sigma;
+	PetscInt              ik, bs, hh, mm, ss;
+	PetscReal             sigma, *s = NULL;
 	Vec                   V;
-	Mat                   Y;
-	SVD                   svd;
-	PetscViewer           fd;
+	SVD                   svd = NULL;
+	PetscBool             save, response;
+	Mat                  *X;
 	PetscLogDouble        t1, t2;
 
 
 	PetscFunctionBeginUser;
 
+	response = RSVD->AdjointFirst;
+	X        = response ? &Res->U_hat : &Res->V_hat;
+
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_DENSE);CHKERRQ(ierr);
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
 	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Reduced SVD begins! ***\n");CHKERRQ(ierr);
 
-	ierr = MatCreate(PETSC_COMM_WORLD,&Res->V_hat);CHKERRQ(ierr);
-	ierr = MatSetType(Res->V_hat,MATDENSE);CHKERRQ(ierr);
-	ierr = MatSetSizes(Res->V_hat,PETSC_DECIDE,PETSC_DECIDE,RSVD->N,RSVD->k);CHKERRQ(ierr);
-	ierr = MatSetUp(Res->V_hat);CHKERRQ(ierr);
+	if (RSVD->LowMemory) {
+		ierr = PetscMalloc1(RSVD->k,&s);CHKERRQ(ierr);
+		ierr = QRSVD(RSVD, RSVDM->Y_hat, s);CHKERRQ(ierr);
+		*X           = RSVDM->Y_hat;
+		RSVDM->Y_hat = NULL;
+	} else {
+		ierr = MatCreate(PETSC_COMM_WORLD,X);CHKERRQ(ierr);
+		ierr = MatSetType(*X,MATDENSE);CHKERRQ(ierr);
+		ierr = MatSetSizes(*X,PETSC_DECIDE,PETSC_DECIDE,response ? RSVD->Nc : RSVD->Nb,RSVD->k);CHKERRQ(ierr);
+		ierr = GetBlockSize(RSVD, response ? RSVD->Nc : RSVD->Nb, &bs);CHKERRQ(ierr);
+		ierr = MatSetBlockSizes(*X,bs,1);CHKERRQ(ierr);
+		ierr = MatSetUp(*X);CHKERRQ(ierr);
+	}
 
 	ierr = VecCreate(PETSC_COMM_WORLD,&Res->S_hat);CHKERRQ(ierr);
 	ierr = VecSetSizes(Res->S_hat,PETSC_DECIDE,RSVD->k);CHKERRQ(ierr);
 	ierr = VecSetUp(Res->S_hat);CHKERRQ(ierr);
 
-	ierr = MatConjugate(RSVDM->Y_hat);CHKERRQ(ierr);
-
-	ierr = SVDCreate(PETSC_COMM_WORLD,&svd);CHKERRQ(ierr);
-	ierr = SVDSetOperators(svd,RSVDM->Y_hat,NULL);CHKERRQ(ierr);
-	ierr = SVDSetDimensions(svd,RSVD->k,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
-	ierr = SVDSolve(svd);CHKERRQ(ierr);
-
-	for (ik=0; ik<RSVD->k; ik++) {
-		ierr = MatDenseGetColumnVecWrite(Res->V_hat,ik,&V);CHKERRQ(ierr);
-		ierr = SVDGetSingularTriplet(svd,ik,&sigma,V,NULL);
-		ierr = VecSetValue(Res->S_hat,ik,sigma,INSERT_VALUES);
-		ierr = MatDenseRestoreColumnVecWrite(Res->V_hat,ik,&V);CHKERRQ(ierr);
+	if (RSVD->LowMemory) {
+		for (ik=0; ik<RSVD->k; ik++) {
+			ierr = VecSetValue(Res->S_hat,ik,s[ik],INSERT_VALUES);CHKERRQ(ierr);
+		}
+		ierr = PetscFree(s);CHKERRQ(ierr);
+	} else {
+		ierr = SVDCreate(PETSC_COMM_WORLD,&svd);CHKERRQ(ierr);
+		ierr = SVDSetOperators(svd,RSVDM->Y_hat,NULL);CHKERRQ(ierr);
+		ierr = SVDSetDimensions(svd,RSVD->k,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
+		ierr = SVDSolve(svd);CHKERRQ(ierr);
+
+		for (ik=0; ik<RSVD->k; ik++) {
+			ierr = MatDenseGetColumnVecWrite(*X,ik,&V);CHKERRQ(ierr);
+			ierr = SVDGetSingularTriplet(svd,ik,&sigma,V,NULL);
+			ierr = VecSetValue(Res->S_hat,ik,sigma,INSERT_VALUES);
+			ierr = MatDenseRestoreColumnVecWrite(*X,ik,&V);CHKERRQ(ierr);
+		}
 	}
 	ierr = VecAssemblyBegin(Res->S_hat);CHKERRQ(ierr);
 	ierr = VecAssemblyEnd(Res->S_hat);CHKERRQ(ierr);
-	ierr = MatAssemblyBegin(Res->V_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
-	ierr = MatAssemblyEnd(Res->V_hat,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
-
-	if (Weight->InvInputWeightFlg)  {
-		ierr = MatMatMult(Weight->W_f_sqrt_inv,Res->V_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
-		ierr = MatCopy(Y,Res->V_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
-		ierr = MatDestroy(&Y);CHKERRQ(ierr);
-	}
+	ierr = MatAssemblyBegin(*X,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(*X,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = VecMax(Res->S_hat,NULL,&Res->Gain);CHKERRQ(ierr);
 
 	/*
 		Prints out the elapsed time
@@ -64,7 +86,7 @@ PetscErrorCode SVD4Forcing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrice
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Reduced SVD elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Reduced SVD elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)RSVD->Threads[STAGE_DENSE], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
 	ierr = SVDDestroy(&svd);CHKERRQ(ierr);
 	ierr = MatDestroy(&RSVDM->Y_hat);CHKERRQ(ierr);
@@ -74,19 +96,15 @@ PetscErrorCode SVD4Forcing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrice
 	*/
 
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Saving the forcing modes and gains begins! ***\n");CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Saving the %s modes and gains begins! ***\n", response ? "response" : "forcing");CHKERRQ(ierr);
 
-	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s%d%s",dirs->FolderDir,"S_hat_iw",(int) iw+1,"_allK");CHKERRQ(ierr);
-	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
-	ierr = VecView(Res->S_hat,fd);CHKERRQ(ierr);
+	ierr = SaveGains(RSVD, Res, dirs, iw);CHKERRQ(ierr);
 
-	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s%d%s",dirs->FolderDir,"V_hat_iw",(int) iw+1,"_allK");CHKERRQ(ierr);
-	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
-	ierr = MatView(Res->V_hat,fd);CHKERRQ(ierr);
+	ierr = SaveModesAtFreq(RSVD, iw, &save);CHKERRQ(ierr);
+	if (save) ierr = SaveModes(RSVD, Weight, Res, dirs, *X, response, iw);CHKERRQ(ierr);
 
-	ierr = MatDestroy(&Res->V_hat);CHKERRQ(ierr);
+	if (RSVD->SaveModesOpt != 3) ierr = MatDestroy(X);CHKERRQ(ierr);
 	ierr = VecDestroy(&Res->S_hat);CHKERRQ(ierr);
-	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
 
 	/*
 		Prints out the elapsed time and exits
@@ -96,7 +114,7 @@ PetscErrorCode SVD4Forcing(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrice
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Saving the forcing modes and gains elapsed time = %02d:%02d:%02d ***\n\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Saving the %s modes and gains elapsed time = %02d:%02d:%02d ***\n\n", response ? "response" : "forcing", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
 	PetscFunctionReturn(0);
 
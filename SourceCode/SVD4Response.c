@@ -1,6 +1,11 @@
 
 #include <slepcsvd.h>
 #include <Variables.h>
+#include <BlockLayout.h>
+#include <StageThreads.h>
+#include <SaveModes.h>
+#include <SaveModesPolicy.h>
+#include <QRDecomposition.h>
 
 PetscErrorCode SVD4Response(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs, PetscInt iw)
 {
@@ -8,44 +13,55 @@ PetscErrorCode SVD4Response(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matric
 		Performs the economy SVD of a matrix of size N x k
 		We perform SVD instead of QR to obtain U 
 		This is generally more accurate than performing QR and recovering it later
+		If the sketch starts from the output space, the matrix is of size Nb x k and gives the forcing modes V
+		Low-memory mode: the SVD is computed in place through the QR decomposition (QRSVD)
 	*/
 	
 	PetscErrorCode        ierr;
-	PetscInt              ik, hh, mm, ss;
+	PetscInt              ik, bs, hh, mm, ss;
 	Mat                   Y;
 	Vec                   U;
+	PetscBool             save, response;
 	SVD                   svd;
-	PetscViewer           fd;
 	PetscLogDouble        t1, t2;
 
 
 	PetscFunctionBeginUser;
 
+	response = (PetscBool) !RSVD->AdjointFirst;
+
+	ierr = SetStageThreads(RSVDM, RSVD, STAGE_DENSE);CHKERRQ(ierr);
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
 	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Reduced SVD begins! ***\n");CHKERRQ(ierr);
 
-	ierr = MatCreate(PETSC_COMM_WORLD,&Y);CHKERRQ(ierr);
-	ierr = MatSetType(Y,MATDENSE);CHKERRQ(ierr);
-	ierr = MatSetSizes(Y,PETSC_DECIDE,PETSC_DECIDE,RSVD->Nc,RSVD->k);CHKERRQ(ierr);
-	ierr = MatSetUp(Y);CHKERRQ(ierr);
-
-	ierr = SVDCreate(PETSC_COMM_WORLD,&svd);CHKERRQ(ierr);
-	ierr = SVDSetOperators(svd,RSVDM->Y_hat,NULL);CHKERRQ(ierr);
-	ierr = SVDSetDimensions(svd,RSVD->k,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
-	ierr = SVDSolve(svd);CHKERRQ(ierr);
-
-	for (ik=0; ik<RSVD->k; ik++) {
-		ierr = MatDenseGetColumnVecWrite(Y,ik,&U);CHKERRQ(ierr);
-		ierr = SVDGetSingularTriplet(svd,ik,NULL,U,NULL);
-		ierr = MatDenseRestoreColumnVecWrite(Y,ik,&U);CHKERRQ(ierr);
+	if (RSVD->LowMemory) {
+		ierr = QRSVD(RSVD, RSVDM->Y_hat, NULL);CHKERRQ(ierr);
+	} else {
+		ierr = MatCreate(PETSC_COMM_WORLD,&Y);CHKERRQ(ierr);
+		ierr = MatSetType(Y,MATDENSE);CHKERRQ(ierr);
+		ierr = MatSetSizes(Y,PETSC_DECIDE,PETSC_DECIDE,response ? RSVD->Nc : RSVD->Nb,RSVD->k);CHKERRQ(ierr);
+		ierr = GetBlockSize(RSVD, response ? RSVD->Nc : RSVD->Nb, &bs);CHKERRQ(ierr);
+		ierr = MatSetBlockSizes(Y,bs,1);CHKERRQ(ierr);
+		ierr = MatSetUp(Y);CHKERRQ(ierr);
+
+		ierr = SVDCreate(PETSC_COMM_WORLD,&svd);CHKERRQ(ierr);
+		ierr = SVDSetOperators(svd,RSVDM->Y_hat,NULL);CHKERRQ(ierr);
+		ierr = SVDSetDimensions(svd,RSVD->k,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
+		ierr = SVDSolve(svd);CHKERRQ(ierr);
+
+		for (ik=0; ik<RSVD->k; ik++) {
+			ierr = MatDenseGetColumnVecWrite(Y,ik,&U);CHKERRQ(ierr);
+			ierr = SVDGetSingularTriplet(svd,ik,NULL,U,NULL);
+			ierr = MatDenseRestoreColumnVecWrite(Y,ik,&U);CHKERRQ(ierr);
+		}
+		
+		ierr = SVDDestroy(&svd);CHKERRQ(ierr);
+
+		ierr = MatAssemblyBegin(Y,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+		ierr = MatAssemblyEnd(Y,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+		ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
+		ierr = MatDestroy(&Y);CHKERRQ(ierr);
 	}
-	
-	ierr = SVDDestroy(&svd);CHKERRQ(ierr);
-
-	ierr = MatAssemblyBegin(Y,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
-	ierr = MatAssemblyEnd(Y,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
-	ierr = MatCopy(Y,RSVDM->Y_hat,SAME_NONZERO_PATTERN);CHKERRQ(ierr);
-	ierr = MatDestroy(&Y);CHKERRQ(ierr);
 
 	/*
 		Prints out the elapsed time
@@ -55,20 +71,22 @@ PetscErrorCode SVD4Response(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matric
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Reduced SVD elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Reduced SVD elapsed time (%d threads) = %02d:%02d:%02d ***\n", (int)RSVD->Threads[STAGE_DENSE], (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
 	/*
-		Saves the response modes
+		Saves the response (forcing) modes (if selected), or keeps the weighted ones for the peak test
 	*/
 
+	ierr = SaveModesAtFreq(RSVD, iw, &save);CHKERRQ(ierr);
+	if (RSVD->SaveModesOpt == 3) {
+		ierr = MatDuplicate(RSVDM->Y_hat,MAT_COPY_VALUES,response ? &Res->U_hat : &Res->V_hat);CHKERRQ(ierr);
+	}
+	if (!save) PetscFunctionReturn(0);
+
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Saving the response modes begins! ***\n");CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*** Saving the %s modes begins! ***\n", response ? "response" : "forcing");CHKERRQ(ierr);
 
-	if (Weight->InvOutputWeightFlg) ierr = MatMatMult(Weight->W_q_sqrt_inv,RSVDM->Y_hat,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Res->U_hat);CHKERRQ(ierr);
-	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s%d%s",dirs->FolderDir,"U_hat_iw",(int) iw+1,"_allK");CHKERRQ(ierr);
-	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
-	ierr = MatView(Res->U_hat,fd);CHKERRQ(ierr);
-	ierr = MatDestroy(&Res->U_hat);CHKERRQ(ierr);
+	ierr = SaveModes(RSVD, Weight, Res, dirs, RSVDM->Y_hat, response, iw);CHKERRQ(ierr);
 
 	/*
 		Prints out the elapsed time and exits
@@ -78,7 +96,7 @@ PetscErrorCode SVD4Response(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matric
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Saving the response modes elapsed time = %02d:%02d:%02d ***\n\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Saving the %s modes elapsed time = %02d:%02d:%02d ***\n\n", response ? "response" : "forcing", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
 	PetscFunctionReturn(0);
 
@@ -1,5 +1,5 @@
 
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
 
 PetscErrorCode SaveInputVarsCopy(Directories *dirs)
@@ -17,13 +17,13 @@ PetscErrorCode SaveInputVarsCopy(Directories *dirs)
 	FILE                 *src_file;
 	FILE                 *dst_file;
 	size_t                bytes_read;
-	PetscInt              rank;
+	PetscMPIInt           rank;
 
 	PetscFunctionBeginUser;
 
-	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,(int*)&rank);CHKERRMPI(ierr);
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
 
-	if ((int)rank == 0) {
+	if (!rank) {
 		ierr = PetscOptionsGetString(NULL, NULL,"-inputs",(char*)&filename,PETSC_MAX_PATH_LEN,NULL);CHKERRQ(ierr);
 		ierr = PetscGetWorkingDirectory(pwd, PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
 		ierr = PetscSNPrintf((char*)&src,PETSC_MAX_PATH_LEN,"%s/%s",pwd,filename);CHKERRQ(ierr);
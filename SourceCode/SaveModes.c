@@ -0,0 +1,82 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <WriteMat.h>
+#include <WriteModesPerMode.h>
+#include <SetupFreqGrid.h>
+
+PetscErrorCode SaveModes(RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs, Mat X, PetscBool response, PetscInt iw)
+{
+	/*
+		Recovers the response (U = W_q_sqrt_inv * U_tilde) or forcing (V = W_f_sqrt_inv * V_tilde) modes
+		from the weighted ones and saves them for the iw-th frequency, either as one N x k matrix for this
+		frequency (SaveResultsOpt = 2) or as row iw of the per-mode Nw x N matrices (SaveResultsOpt = 1)
+		The back-transformation is only performed here, i.e., for the modes that are actually saved
+		A diagonal weight is applied by row scaling of a copy, as X is still used by the caller
+		The modes are also handed to the callback of the library API (if any), and only to it if InMemory
+	*/
+
+	PetscErrorCode        ierr;
+	Mat                   Y, W;
+	Vec                   w;
+	PetscBool             flg;
+	PetscReal             omega;
+
+	PetscFunctionBeginUser;
+
+	W   = response ? Weight->W_q_sqrt_inv : Weight->W_f_sqrt_inv;
+	w   = response ? Weight->w_q_sqrt_inv : Weight->w_f_sqrt_inv;
+	flg = response ? Weight->InvOutputWeightFlg : Weight->InvInputWeightFlg;
+
+	if (flg && w) {
+		ierr = MatDuplicate(X,MAT_COPY_VALUES,&Y);CHKERRQ(ierr);
+		ierr = MatDiagonalScale(Y,w,NULL);CHKERRQ(ierr);
+	} else if (flg) {
+		ierr = MatMatMult(W,X,MAT_INITIAL_MATRIX,PETSC_DEFAULT,&Y);CHKERRQ(ierr);
+	} else {
+		ierr = PetscObjectReference((PetscObject)X);CHKERRQ(ierr);
+		Y    = X;
+	}
+	if (Res->ModesFn) {
+		ierr = GetFrequency(RSVD, iw, &omega);CHKERRQ(ierr);
+		ierr = (*Res->ModesFn)(iw, omega, response, Y, Res->MonitorCtx);CHKERRQ(ierr);
+	}
+	if (!RSVD->InMemory && RSVD->SaveResultsOpt == 1) {
+		ierr = WriteModesPerMode(RSVD, dirs, Y, response, iw);CHKERRQ(ierr);
+	} else if (!RSVD->InMemory) {
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s%d%s",dirs->FolderDir,response ? "U_hat_iw" : "V_hat_iw",(int) iw+1,"_allK");CHKERRQ(ierr);
+		ierr = WriteMat(RSVD, Res, Y, dirs->IO_dir);CHKERRQ(ierr);
+	}
+	ierr = MatDestroy(&Y);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SaveGains(RSVD_vars *RSVD, Resolvent_matrices *Res, Directories *dirs, PetscInt iw)
+{
+	/*
+		Saves the k gains of the iw-th frequency, and hands them to the callback of the library API (if any)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscViewer           fd;
+	PetscReal             omega;
+
+	PetscFunctionBeginUser;
+
+	if (Res->GainsFn) {
+		ierr = GetFrequency(RSVD, iw, &omega);CHKERRQ(ierr);
+		ierr = (*Res->GainsFn)(iw, omega, Res->S_hat, Res->MonitorCtx);CHKERRQ(ierr);
+	}
+	if (RSVD->InMemory) PetscFunctionReturn(0);
+
+	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s%d%s",dirs->FolderDir,"S_hat_iw",(int) iw+1,"_allK");CHKERRQ(ierr);
+	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,dirs->IO_dir,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
+	ierr = VecView(Res->S_hat,fd);CHKERRQ(ierr);
+	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
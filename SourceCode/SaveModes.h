@@ -0,0 +1,8 @@
+
+#ifndef SAVEMODES_H
+#define SAVEMODES_H
+
+PetscErrorCode SaveModes(RSVD_vars*, Weight_matrices*, Resolvent_matrices*, Directories*, Mat, PetscBool, PetscInt);
+PetscErrorCode SaveGains(RSVD_vars*, Resolvent_matrices*, Directories*, PetscInt);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,69 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <SaveModes.h>
+
+PetscErrorCode SaveModesAtFreq(RSVD_vars *RSVD, PetscInt iw, PetscBool *save)
+{
+	/*
+		Decides whether the modes of the iw-th frequency are saved right after they are computed
+		SaveModesOpt = 0: gains only
+		SaveModesOpt = 1: all frequencies
+		SaveModesOpt = 2: frequencies in SaveModesList (1-based indices)
+		SaveModesOpt = 3: local maxima of the leading gain, decided afterwards by SavePeakModes
+	*/
+
+	PetscInt              i;
+
+	PetscFunctionBeginUser;
+
+	*save = PETSC_FALSE;
+	if (RSVD->SaveModesOpt == 1) *save = PETSC_TRUE;
+	if (RSVD->SaveModesOpt == 2) {
+		for (i=0; i<RSVD->NumSaveModesList; i++) if (RSVD->SaveModesList[i] == iw+1) *save = PETSC_TRUE;
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SavePeakModes(RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs, PetscInt iw)
+{
+	/*
+		Saves the modes of the frequencies where the leading gain is a local maximum over the grid
+		The weighted modes (U_hat, V_hat) of a rising frequency are kept until the gain of the next
+		frequency is known; all others are discarded without back-transformation
+	*/
+
+	PetscErrorCode        ierr=0;
+
+	PetscFunctionBeginUser;
+
+	if (Res->U_peak && Res->GainPrev > Res->Gain) {
+		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Leading gain peak at iw = %d, saving its modes\n", (int)iw);CHKERRQ(ierr);
+		ierr = SaveModes(RSVD, Weight, Res, dirs, Res->U_peak, 1, iw-1);CHKERRQ(ierr);
+		ierr = SaveModes(RSVD, Weight, Res, dirs, Res->V_peak, 0, iw-1);CHKERRQ(ierr);
+	}
+	ierr = MatDestroy(&Res->U_peak);CHKERRQ(ierr);
+	ierr = MatDestroy(&Res->V_peak);CHKERRQ(ierr);
+
+	if (iw == 0 || Res->Gain >= Res->GainPrev) {
+		if (iw == RSVD->Nw-1) {
+			if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Leading gain peak at iw = %d, saving its modes\n", (int)iw+1);CHKERRQ(ierr);
+			ierr = SaveModes(RSVD, Weight, Res, dirs, Res->U_hat, 1, iw);CHKERRQ(ierr);
+			ierr = SaveModes(RSVD, Weight, Res, dirs, Res->V_hat, 0, iw);CHKERRQ(ierr);
+		} else {
+			Res->U_peak = Res->U_hat;
+			Res->V_peak = Res->V_hat;
+			Res->U_hat  = NULL;
+			Res->V_hat  = NULL;
+		}
+	}
+	ierr = MatDestroy(&Res->U_hat);CHKERRQ(ierr);
+	ierr = MatDestroy(&Res->V_hat);CHKERRQ(ierr);
+	Res->GainPrev = Res->Gain;
+
+	PetscFunctionReturn(0);
+
+}
+
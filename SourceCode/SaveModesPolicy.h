@@ -0,0 +1,8 @@
+
+#ifndef SAVEMODESPOLICY_H
+#define SAVEMODESPOLICY_H
+
+PetscErrorCode SaveModesAtFreq(RSVD_vars*, PetscInt, PetscBool*);
+PetscErrorCode SavePeakModes(RSVD_vars*, Weight_matrices*, Resolvent_matrices*, Directories*, PetscInt);
+
+#endif
\ No newline at end of file
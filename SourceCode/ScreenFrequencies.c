@@ -0,0 +1,322 @@
+
+#include <slepceps.h>
+#include <slepcbv.h>
+#include <petscblaslapack.h>
+#include <Variables.h>
+#include <ApplyWeightMats.h>
+#include <SaveModes.h>
+#include <SaveModesPolicy.h>
+
+static PetscErrorCode ReducedResolvent(PetscInt m, const PetscScalar *r1, const PetscScalar *r2, const PetscScalar *lam, PetscScalar z, PetscBool vectors, PetscScalar *M, PetscScalar *D, PetscReal *s, PetscScalar *U, PetscScalar *VT, PetscScalar *work, PetscReal *rwork)
+{
+	/*
+		SVD of the m x m reduced resolvent M = R1 diag(1/(z - lambda)) R2' (LAPACK), z = i w - beta,, with the
+		singular vectors U and VT = V' if requested
+	*/
+
+	PetscInt              i, j;
+	PetscScalar           d, one = 1, zero = 0;
+	PetscBLASInt          bm, lwork, info, ld1 = 1;
+
+	PetscFunctionBeginUser;
+
+	bm    = (PetscBLASInt)m;
+	lwork = 5*bm;
+	for (j=0; j<m; j++) {
+		d = 1./(z - lam[j]);
+		for (i=0; i<m; i++) D[i+j*m] = r1[i+j*m]*d;
+	}
+	BLASgemm_("N","C",&bm,&bm,&bm,&one,D,&bm,(PetscScalar*)r2,&bm,&zero,M,&bm);
+	LAPACKgesvd_(vectors ? "A" : "N",vectors ? "A" : "N",&bm,&bm,M,&bm,s,U,vectors ? &bm : &ld1,VT,vectors ? &bm : &ld1,work,&lwork,rwork,&info);
+	if (info) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_LIB,"LAPACK gesvd failed with info = %d", (int)info);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode ScreenFrequencies(RSVD_matrices *RSVDM, RSVD_vars *RSVD, Weight_matrices *Weight, Resolvent_matrices *Res, Directories *dirs)
+{
+	/*
+		Screens [w_min, w_max] with a reduced resolvent built from eigenpairs of A_org near the imaginary axis
+		For ScreenShifts targets i w_s, the ScreenNev eigenvalues closest to i w_s are computed by shift-and-invert
+		Krylov-Schur (one LU each), with their left eigenvectors, so that R(w) ~ V diag(1/(i w - lambda)) W'
+		with W' V = I. With the weighted projections W_q_sqrt C V = Q1 R1 and W_f_sqrt_inv' B' W = Q2 R2,
+		the gains at any w are the singular values of the m x m matrix R1 diag(1/(i w - lambda)) R2' (m eigenpairs)
+		The gains are estimated on a grid ScreenRefine times finer than dw and saved in Screening.csv
+		An estimate is reliable if w lies in a disk |i w - i w_s| < rho_s within which all eigenvalues were
+		captured (rho_s: distance to the farthest computed eigenvalue of the target), and if the leading gain
+		exceeds ScreenFactor times c_max / (rho_s - |w - w_s|), a bound on the truncated part of the modal
+		expansion for a normal operator, c_max being the largest coupling |W_q_sqrt C v_j| |W_f_sqrt_inv' B' w_j|
+		Frequencies of the regular grid with an unreliable estimate within dw/2 are left to RSVD-LU (Full), the
+		others get the screened gains and modes, saved as the ones of RSVD-LU
+		With discounting, the targets and the disks are shifted by -beta as the resolvent
+		Eigensolver options can be given with the prefix -screen_ (e.g., -screen_eps_tol)
+	*/
+
+	PetscErrorCode        ierr;
+	EPS                   eps;
+	ST                    st;
+	KSP                   ksp;
+	PC                    pc;
+	Vec                   vr, wl, *vv, *ww, x;
+	Mat                   V, W, Cq, Bf, R1, R2, Um, Vm, X;
+	BV                    bq1, bq2, bx;
+	PetscScalar           lambda, s, *lam, *r1, *r2, *M, *D, *U, *VT, *work, *a;
+	PetscReal            *center, *radius, *n1, *n2, *gains, *sv, *rwork, cmax = 0, w, margin, beta;
+	PetscInt              is, i, j, m = 0, nconv, take, nloc, Nf, iw, f, f1, f2, nfull = 0, hh, mm, ss;
+	PetscMPIInt           rank, size;
+	PetscBool             dup, save, *reliable;
+	PetscLogDouble        t1, t2;
+	FILE                 *fp;
+	char                  filename[PETSC_MAX_PATH_LEN];
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
+	ierr = MPI_Comm_size(PETSC_COMM_WORLD,&size);CHKERRMPI(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\n*******************************************\n"
+			"**************** Screening ****************\n*******************************************\n\n");CHKERRQ(ierr);
+
+	RSVD->Nb           = Weight[0].Nb;
+	RSVD->Nc           = Weight[0].Nc;
+	RSVD->AdjointFirst = Weight[0].AdjointFirst;
+	beta               = RSVD->Disc.DiscFlg ? RSVD->Disc.beta : 0;
+
+	/*
+		Eigenpairs closest to every target, without the duplicates found by neighbouring targets
+	*/
+
+	ierr = PetscMalloc4(RSVD->Screen.Shifts,&center,RSVD->Screen.Shifts,&radius,RSVD->Screen.Shifts*RSVD->Screen.Nev,&lam,RSVD->Screen.Shifts*RSVD->Screen.Nev,&vv);CHKERRQ(ierr);
+	ierr = PetscMalloc1(RSVD->Screen.Shifts*RSVD->Screen.Nev,&ww);CHKERRQ(ierr);
+	ierr = MatCreateVecs(RSVDM->A_org,&vr,&wl);CHKERRQ(ierr);
+
+	for (is=0; is<RSVD->Screen.Shifts; is++) {
+
+		center[is] = RSVD->w_min + (is + 0.5)*(RSVD->w_max - RSVD->w_min)/RSVD->Screen.Shifts;
+
+		ierr = EPSCreate(PETSC_COMM_WORLD,&eps);CHKERRQ(ierr);
+		ierr = EPSSetOperators(eps,RSVDM->A_org,NULL);CHKERRQ(ierr);
+		ierr = EPSSetProblemType(eps,EPS_NHEP);CHKERRQ(ierr);
+		ierr = EPSSetType(eps,EPSKRYLOVSCHUR);CHKERRQ(ierr);
+		ierr = EPSSetTwoSided(eps,PETSC_TRUE);CHKERRQ(ierr);
+		ierr = EPSSetDimensions(eps,RSVD->Screen.Nev,PETSC_DEFAULT,PETSC_DEFAULT);CHKERRQ(ierr);
+		ierr = EPSSetTarget(eps,PETSC_i*center[is] - beta);CHKERRQ(ierr);
+		ierr = EPSSetWhichEigenpairs(eps,EPS_TARGET_MAGNITUDE);CHKERRQ(ierr);
+		ierr = EPSGetST(eps,&st);CHKERRQ(ierr);
+		ierr = STSetType(st,STSINVERT);CHKERRQ(ierr);
+		ierr = STGetKSP(st,&ksp);CHKERRQ(ierr);
+		ierr = KSPSetType(ksp,KSPPREONLY);CHKERRQ(ierr);
+		ierr = KSPGetPC(ksp,&pc);CHKERRQ(ierr);
+		ierr = PCSetType(pc,PCLU);CHKERRQ(ierr);
+		ierr = PCFactorSetMatSolverType(pc,MATSOLVERMUMPS);CHKERRQ(ierr);
+		ierr = EPSSetOptionsPrefix(eps,"screen_");CHKERRQ(ierr);
+		ierr = EPSSetFromOptions(eps);CHKERRQ(ierr);
+		ierr = EPSSolve(eps);CHKERRQ(ierr);
+		ierr = EPSGetConverged(eps,&nconv);CHKERRQ(ierr);
+
+		take       = PetscMin(nconv,RSVD->Screen.Nev);
+		radius[is] = 0;
+		for (i=0; i<take; i++) {
+			ierr = EPSGetEigenpair(eps,i,&lambda,NULL,vr,NULL);CHKERRQ(ierr);
+			radius[is] = PetscMax(radius[is],PetscAbsScalar(lambda + beta - PETSC_i*center[is]));
+			for (j=0, dup=PETSC_FALSE; j<m; j++) dup = (PetscBool) (dup || PetscAbsScalar(lambda - lam[j]) <= 1e-8*PetscMax(1.,PetscAbsScalar(lambda)));
+			if (dup) continue;
+			ierr = EPSGetLeftEigenvector(eps,i,wl,NULL);CHKERRQ(ierr);
+			ierr = VecDuplicate(vr,&vv[m]);CHKERRQ(ierr);
+			ierr = VecCopy(vr,vv[m]);CHKERRQ(ierr);
+			ierr = VecDuplicate(wl,&ww[m]);CHKERRQ(ierr);
+			ierr = VecCopy(wl,ww[m]);CHKERRQ(ierr);
+			ierr = VecDot(vv[m],ww[m],&s);CHKERRQ(ierr);
+			ierr = VecScale(ww[m],1./PetscConj(s));CHKERRQ(ierr);
+			lam[m++] = lambda;
+		}
+		ierr = EPSDestroy(&eps);CHKERRQ(ierr);
+
+		if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Target w = %g: %d eigenvalues converged, captured within |lambda - i w| < %g\n", center[is], (int)nconv, radius[is]);CHKERRQ(ierr);
+	}
+	if (m < RSVD->k) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"Only %d distinct eigenpairs converged, fewer than k = %d. Increase 'ScreenNev' or 'ScreenShifts'", (int)m, (int)RSVD->k);
+
+	/*
+		Right and (biorthonormal) left eigenvectors, projected on the weighted output and input spaces
+	*/
+
+	ierr = VecGetLocalSize(vr,&nloc);CHKERRQ(ierr);
+	ierr = MatCreateDense(PETSC_COMM_WORLD,nloc,PETSC_DECIDE,RSVD->N,m,NULL,&V);CHKERRQ(ierr);
+	ierr = MatCreateDense(PETSC_COMM_WORLD,nloc,PETSC_DECIDE,RSVD->N,m,NULL,&W);CHKERRQ(ierr);
+	for (j=0; j<m; j++) {
+		ierr = MatDenseGetColumnVecWrite(V,j,&x);CHKERRQ(ierr);
+		ierr = VecCopy(vv[j],x);CHKERRQ(ierr);
+		ierr = MatDenseRestoreColumnVecWrite(V,j,&x);CHKERRQ(ierr);
+		ierr = MatDenseGetColumnVecWrite(W,j,&x);CHKERRQ(ierr);
+		ierr = VecCopy(ww[j],x);CHKERRQ(ierr);
+		ierr = MatDenseRestoreColumnVecWrite(W,j,&x);CHKERRQ(ierr);
+		ierr = VecDestroy(&vv[j]);CHKERRQ(ierr);
+		ierr = VecDestroy(&ww[j]);CHKERRQ(ierr);
+	}
+	ierr = VecDestroy(&vr);CHKERRQ(ierr);
+	ierr = VecDestroy(&wl);CHKERRQ(ierr);
+	ierr = MatAssemblyBegin(V,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(V,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyBegin(W,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(W,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+
+	RSVDM->Y_hat = V;
+	ierr = ApplyWeightMats(RSVDM, RSVD, &Weight[0], PETSC_TRUE, PETSC_FALSE);CHKERRQ(ierr);
+	Cq   = RSVDM->Y_hat;
+	ierr = MatConjugate(W);CHKERRQ(ierr);
+	RSVDM->Y_hat = W;
+	ierr = ApplyWeightMats(RSVDM, RSVD, &Weight[0], PETSC_FALSE, PETSC_FALSE);CHKERRQ(ierr);
+	Bf   = RSVDM->Y_hat;
+	RSVDM->Y_hat = NULL;
+
+	ierr = PetscMalloc2(m,&n1,m,&n2);CHKERRQ(ierr);
+	ierr = MatGetColumnNorms(Cq,NORM_2,n1);CHKERRQ(ierr);
+	ierr = MatGetColumnNorms(Bf,NORM_2,n2);CHKERRQ(ierr);
+	for (j=0; j<m; j++) cmax = PetscMax(cmax,n1[j]*n2[j]);
+	ierr = PetscFree2(n1,n2);CHKERRQ(ierr);
+
+	ierr = MatCreateSeqDense(PETSC_COMM_SELF,m,m,NULL,&R1);CHKERRQ(ierr);
+	ierr = MatCreateSeqDense(PETSC_COMM_SELF,m,m,NULL,&R2);CHKERRQ(ierr);
+	ierr = BVCreateFromMat(Cq,&bq1);CHKERRQ(ierr);
+	ierr = BVSetType(bq1,BVVECS);CHKERRQ(ierr);
+	ierr = BVOrthogonalize(bq1,R1);CHKERRQ(ierr);
+	ierr = BVCreateFromMat(Bf,&bq2);CHKERRQ(ierr);
+	ierr = BVSetType(bq2,BVVECS);CHKERRQ(ierr);
+	ierr = BVOrthogonalize(bq2,R2);CHKERRQ(ierr);
+	ierr = MatDestroy(&Cq);CHKERRQ(ierr);
+	ierr = MatDestroy(&Bf);CHKERRQ(ierr);
+
+	/*
+		Gains on the fine grid, shared out among the ranks
+	*/
+
+	Nf   = (RSVD->Nw - 1)*RSVD->Screen.Refine + 1;
+	ierr = PetscCalloc2(Nf*RSVD->k,&gains,Nf,&reliable);CHKERRQ(ierr);
+	ierr = PetscMalloc6(m*m,&M,m*m,&D,m*m,&U,m*m,&VT,5*m,&work,5*m,&rwork);CHKERRQ(ierr);
+	ierr = PetscMalloc1(m,&sv);CHKERRQ(ierr);
+	ierr = MatDenseGetArray(R1,&r1);CHKERRQ(ierr);
+	ierr = MatDenseGetArray(R2,&r2);CHKERRQ(ierr);
+
+	for (f=rank; f<Nf; f+=size) {
+		w    = RSVD->w_min + f*RSVD->dw/RSVD->Screen.Refine;
+		ierr = ReducedResolvent(m, r1, r2, lam, PETSC_i*w - beta, PETSC_FALSE, M, D, sv, U, VT, work, rwork);CHKERRQ(ierr);
+		for (i=0; i<RSVD->k; i++) gains[f*RSVD->k+i] = sv[i];
+	}
+	ierr = MPI_Allreduce(MPI_IN_PLACE,gains,Nf*RSVD->k,MPIU_REAL,MPIU_SUM,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
+	for (f=0; f<Nf; f++) {
+		w      = RSVD->w_min + f*RSVD->dw/RSVD->Screen.Refine;
+		margin = -1;
+		for (is=0; is<RSVD->Screen.Shifts; is++) margin = PetscMax(margin,radius[is] - PetscAbsReal(w - center[is]));
+		reliable[f] = (PetscBool) (margin > 0 && gains[f*RSVD->k] >= RSVD->Screen.Factor*cmax/margin);
+	}
+
+	ierr = PetscSNPrintf(filename,PETSC_MAX_PATH_LEN,"%sScreening.csv",dirs->MainFolderDir);CHKERRQ(ierr);
+	ierr = PetscFOpen(PETSC_COMM_WORLD,filename,"w",&fp);CHKERRQ(ierr);
+	ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"w,reliable");CHKERRQ(ierr);
+	for (i=0; i<RSVD->k; i++) ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,",gain_%d",(int)i+1);CHKERRQ(ierr);
+	ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"\n");CHKERRQ(ierr);
+	for (f=0; f<Nf; f++) {
+		ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"%.10g,%d",(double)(RSVD->w_min + f*RSVD->dw/RSVD->Screen.Refine),(int)reliable[f]);CHKERRQ(ierr);
+		for (i=0; i<RSVD->k; i++) ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,",%.10g",(double)gains[f*RSVD->k+i]);CHKERRQ(ierr);
+		ierr = PetscFPrintf(PETSC_COMM_WORLD,fp,"\n");CHKERRQ(ierr);
+	}
+	ierr = PetscFClose(PETSC_COMM_WORLD,fp);CHKERRQ(ierr);
+
+	/*
+		Frequencies of the grid left to RSVD-LU: an unreliable estimate within dw/2
+	*/
+
+	ierr = PetscMalloc1(RSVD->Nw,&RSVD->Screen.Full);CHKERRQ(ierr);
+	for (iw=0; iw<RSVD->Nw; iw++) {
+		f1 = PetscMax(0,iw*RSVD->Screen.Refine - RSVD->Screen.Refine/2);
+		f2 = PetscMin(Nf-1,iw*RSVD->Screen.Refine + RSVD->Screen.Refine/2);
+		RSVD->Screen.Full[iw] = PETSC_FALSE;
+		for (f=f1; f<=f2; f++) if (!reliable[f]) RSVD->Screen.Full[iw] = PETSC_TRUE;
+		if (RSVD->Screen.Full[iw]) nfull++;
+	}
+
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"\nScreening: %d distinct eigenpairs, %d frequencies estimated (Screening.csv), %d of %d left to RSVD-LU\n", (int)m, (int)Nf, (int)nfull, (int)RSVD->Nw);CHKERRQ(ierr);
+	for (iw=0; iw<RSVD->Nw; iw++) {
+		if (!RSVD->Screen.Full[iw] || (iw > 0 && RSVD->Screen.Full[iw-1])) continue;
+		for (j=iw; j+1<RSVD->Nw && RSVD->Screen.Full[j+1]; j++);
+		ierr = PetscPrintf(PETSC_COMM_WORLD,"    unreliable band: w = %g to %g (iw = %d to %d)\n", RSVD->w_min + iw*RSVD->dw, RSVD->w_min + j*RSVD->dw, (int)iw+1, (int)j+1);CHKERRQ(ierr);
+	}
+
+	/*
+		Screened gains and modes of the other frequencies of the grid
+		The weighted response and forcing modes are Q1 U and Q2 V, with M = U S V'
+	*/
+
+	ierr = MatCreateSeqDense(PETSC_COMM_SELF,m,m,NULL,&Um);CHKERRQ(ierr);
+	ierr = MatCreateSeqDense(PETSC_COMM_SELF,m,m,NULL,&Vm);CHKERRQ(ierr);
+	for (iw=0; iw<RSVD->Nw; iw++) {
+
+		if (RSVD->Screen.Full[iw]) continue;
+
+		ierr = SaveModesAtFreq(RSVD, iw, &save);CHKERRQ(ierr);
+		ierr = ReducedResolvent(m, r1, r2, lam, PETSC_i*(RSVD->w_min + iw*RSVD->dw) - beta, save, M, D, sv, U, VT, work, rwork);CHKERRQ(ierr);
+
+		ierr = VecCreate(PETSC_COMM_WORLD,&Res->S_hat);CHKERRQ(ierr);
+		ierr = VecSetSizes(Res->S_hat,PETSC_DECIDE,RSVD->k);CHKERRQ(ierr);
+		ierr = VecSetUp(Res->S_hat);CHKERRQ(ierr);
+		if (!rank) {
+			for (i=0; i<RSVD->k; i++) ierr = VecSetValue(Res->S_hat,i,sv[i],INSERT_VALUES);CHKERRQ(ierr);
+		}
+		ierr = VecAssemblyBegin(Res->S_hat);CHKERRQ(ierr);
+		ierr = VecAssemblyEnd(Res->S_hat);CHKERRQ(ierr);
+		Res->Gain = sv[0];
+		ierr = SaveGains(RSVD, Res, dirs, iw);CHKERRQ(ierr);
+		ierr = VecDestroy(&Res->S_hat);CHKERRQ(ierr);
+
+		if (!save) continue;
+
+		ierr = MatDenseGetArray(Um,&a);CHKERRQ(ierr);
+		ierr = PetscArraycpy(a,U,m*m);CHKERRQ(ierr);
+		ierr = MatDenseRestoreArray(Um,&a);CHKERRQ(ierr);
+		ierr = MatDenseGetArray(Vm,&a);CHKERRQ(ierr);
+		for (j=0; j<m; j++) {
+			for (i=0; i<m; i++) a[i+j*m] = PetscConj(VT[j+i*m]);
+		}
+		ierr = MatDenseRestoreArray(Vm,&a);CHKERRQ(ierr);
+
+		for (is=0; is<2; is++) {
+			ierr = BVDuplicate(is ? bq2 : bq1,&bx);CHKERRQ(ierr);
+			ierr = BVCopy(is ? bq2 : bq1,bx);CHKERRQ(ierr);
+			ierr = BVMultInPlace(bx,is ? Vm : Um,0,RSVD->k);CHKERRQ(ierr);
+			ierr = BVSetActiveColumns(bx,0,RSVD->k);CHKERRQ(ierr);
+			ierr = BVCreateMat(bx,&X);CHKERRQ(ierr);
+			ierr = SaveModes(RSVD, &Weight[0], Res, dirs, X, (PetscBool) !is, iw);CHKERRQ(ierr);
+			ierr = MatDestroy(&X);CHKERRQ(ierr);
+			ierr = BVDestroy(&bx);CHKERRQ(ierr);
+		}
+	}
+
+	ierr = MatDenseRestoreArray(R1,&r1);CHKERRQ(ierr);
+	ierr = MatDenseRestoreArray(R2,&r2);CHKERRQ(ierr);
+	ierr = MatDestroy(&R1);CHKERRQ(ierr);
+	ierr = MatDestroy(&R2);CHKERRQ(ierr);
+	ierr = MatDestroy(&Um);CHKERRQ(ierr);
+	ierr = MatDestroy(&Vm);CHKERRQ(ierr);
+	ierr = BVDestroy(&bq1);CHKERRQ(ierr);
+	ierr = BVDestroy(&bq2);CHKERRQ(ierr);
+	ierr = PetscFree6(M,D,U,VT,work,rwork);CHKERRQ(ierr);
+	ierr = PetscFree(sv);CHKERRQ(ierr);
+	ierr = PetscFree2(gains,reliable);CHKERRQ(ierr);
+	ierr = PetscFree4(center,radius,lam,vv);CHKERRQ(ierr);
+	ierr = PetscFree(ww);CHKERRQ(ierr);
+
+	/*
+		Prints out the elapsed time
+	*/
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	hh   = (t2-t1)/3600;
+	mm   = (t2-t1-3600*hh)/60;
+	ss   = t2-t1-3600*hh-mm*60;
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"*** Screening elapsed time = %02d:%02d:%02d ***\n\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
@@ -0,0 +1,7 @@
+
+#ifndef SCREENFREQUENCIES_H
+#define SCREENFREQUENCIES_H
+
+PetscErrorCode ScreenFrequencies(RSVD_matrices*, RSVD_vars*, Weight_matrices*, Resolvent_matrices*, Directories*);
+
+#endif
\ No newline at end of file
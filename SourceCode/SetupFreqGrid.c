@@ -1,5 +1,5 @@
 
-#include <petscmat.h>
+#include <petscksp.h>
 #include <Variables.h>
 
 PetscErrorCode SetupFreqGrid(RSVD_vars *RSVD)
@@ -27,6 +27,20 @@ PetscErrorCode SetupFreqGrid(RSVD_vars *RSVD)
 	
 }
 
+PetscErrorCode GetFrequency(RSVD_vars *RSVD, PetscInt iw, PetscReal *w)
+{
+	/*
+		Frequency of index iw, from the list given through the library API if any, otherwise from the grid
+	*/
+
+	PetscFunctionBeginUser;
+
+	*w = RSVD->w_list ? RSVD->w_list[iw] : RSVD->w_min + iw * RSVD->dw;
+
+	PetscFunctionReturn(0);
+
+}
+
 
 
 
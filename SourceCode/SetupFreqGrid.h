@@ -3,5 +3,6 @@
 #define SETUPFREQGRID_H
 
 PetscErrorCode SetupFreqGrid(RSVD_vars*);
+PetscErrorCode GetFrequency(RSVD_vars*, PetscInt, PetscReal*);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,376 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <BlockLayout.h>
+#include <ReadWeightMats.h>
+
+#define SHARED_NONE     0
+#define SHARED_AIJ      1
+#define SHARED_BAIJ     2
+#define SHARED_VEC      3
+#define SHARED_HEAD     6                                 /* kind, owner, rows, columns, block size, nonzeros (blocks) */
+#define SHARED_WEIGHTS  5                                 /* W_f_sqrt_inv, B, W_q_sqrt_inv, W_q_sqrt, C of a configuration */
+#define SHARED_ALIGN(b) ((((b) + 15)/16)*16)
+
+/*
+	Read-only matrices of the batch mode placed once per node in an MPI-3 shared-memory window
+
+	With groups of one rank, every rank otherwise holds its own copy of the operator and of the weight and
+	input/output matrices. Here, the operators processed by the ranks of a node are loaded once, by
+	different ranks of the node, and the weight matrices once, by its first rank. Their CSR (block CSR)
+	arrays are copied into the segments of a window allocated with MPI_Win_allocate_shared, and every rank
+	wraps them into sequential matrices (MatCreateSeqAIJWithArrays) that do not own the arrays. A_org, B, C
+	and the weights are only read by the pipeline; the shifted operator and its factors remain private.
+	The operators stay private (loaded by every rank) if a node processes more operators than it has ranks.
+*/
+
+struct _p_SharedMats {
+	MPI_Comm              node;                           /* ranks of the node */
+	MPI_Win               win;                            /* shared-memory window, one segment per rank of the node */
+	PetscMPIInt           rank, size;
+	PetscInt              oplo, nops;                     /* operators oplo, ..., oplo+nops-1 are shared (nops = 0: none) */
+	PetscInt              nitems;                         /* nops operators, then SHARED_WEIGHTS matrices per configuration */
+	PetscInt             *head;                           /* SHARED_HEAD integers per item */
+	MPI_Aint             *offset;                         /* byte offset of every item in the segment of its owner */
+	PetscInt             *sizes;                          /* Nb, Nc and AdjointFirst of every configuration */
+};
+
+static size_t ItemBytes(const PetscInt *h)
+{
+	/*
+		Bytes of the arrays of an item: row pointers, column indices and values (aligned), or vector entries
+	*/
+
+	PetscInt              nr;
+
+	if (h[0] == SHARED_NONE) return 0;
+	if (h[0] == SHARED_VEC) return SHARED_ALIGN((size_t)h[5]*sizeof(PetscScalar));
+	nr = h[2]/h[4];
+	return SHARED_ALIGN((size_t)(nr+1)*sizeof(PetscInt)) + SHARED_ALIGN((size_t)h[5]*sizeof(PetscInt)) + SHARED_ALIGN((size_t)h[5]*h[4]*h[4]*sizeof(PetscScalar));
+}
+
+static PetscErrorCode ItemDescribe(Mat A, Vec v, PetscInt *h)
+{
+	/*
+		Kind, sizes, block size and number of stored nonzeros (blocks for BAIJ) of a matrix or vector
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              nr;
+	const PetscInt       *ia, *ja;
+	PetscBool             baij, done;
+
+	PetscFunctionBeginUser;
+
+	if (v) {
+		h[0] = SHARED_VEC;
+		ierr = VecGetSize(v,&h[2]);CHKERRQ(ierr);
+		ierr = VecGetBlockSize(v,&h[4]);CHKERRQ(ierr);
+		h[3] = 1;
+		h[5] = h[2];
+	} else if (A) {
+		ierr = PetscObjectTypeCompare((PetscObject)A,MATSEQBAIJ,&baij);CHKERRQ(ierr);
+		ierr = MatGetSize(A,&h[2],&h[3]);CHKERRQ(ierr);
+		h[0] = baij ? SHARED_BAIJ : SHARED_AIJ;
+		h[4] = 1;
+		if (baij) ierr = MatGetBlockSize(A,&h[4]);CHKERRQ(ierr);
+		ierr = MatGetRowIJ(A,0,PETSC_FALSE,baij,&nr,&ia,&ja,&done);CHKERRQ(ierr);
+		if (!done) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_SUP,"Cannot access the CSR arrays of the matrix");
+		h[5] = ia[nr];
+		ierr = MatRestoreRowIJ(A,0,PETSC_FALSE,baij,&nr,&ia,&ja,&done);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode ItemStore(Mat A, Vec v, const PetscInt *h, char *dst)
+{
+	/*
+		Copies the arrays of a matrix or vector to its place in the shared segment
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              nr;
+	const PetscInt       *ia, *ja;
+	const PetscScalar    *va;
+	PetscScalar          *ba;
+	PetscBool             baij = (PetscBool) (h[0] == SHARED_BAIJ), done;
+	size_t                oj, oa;
+
+	PetscFunctionBeginUser;
+
+	if (h[0] == SHARED_NONE) PetscFunctionReturn(0);
+	if (h[0] == SHARED_VEC) {
+		ierr = VecGetArrayRead(v,&va);CHKERRQ(ierr);
+		ierr = PetscArraycpy((PetscScalar*)dst,va,h[5]);CHKERRQ(ierr);
+		ierr = VecRestoreArrayRead(v,&va);CHKERRQ(ierr);
+		PetscFunctionReturn(0);
+	}
+
+	ierr = MatGetRowIJ(A,0,PETSC_FALSE,baij,&nr,&ia,&ja,&done);CHKERRQ(ierr);
+	oj   = SHARED_ALIGN((size_t)(nr+1)*sizeof(PetscInt));
+	oa   = oj + SHARED_ALIGN((size_t)h[5]*sizeof(PetscInt));
+	ierr = PetscArraycpy((PetscInt*)dst,ia,nr+1);CHKERRQ(ierr);
+	ierr = PetscArraycpy((PetscInt*)(dst+oj),ja,h[5]);CHKERRQ(ierr);
+	ierr = MatRestoreRowIJ(A,0,PETSC_FALSE,baij,&nr,&ia,&ja,&done);CHKERRQ(ierr);
+	if (baij) {
+		ierr = MatSeqBAIJGetArray(A,&ba);CHKERRQ(ierr);
+		ierr = PetscArraycpy((PetscScalar*)(dst+oa),ba,h[5]*h[4]*h[4]);CHKERRQ(ierr);
+		ierr = MatSeqBAIJRestoreArray(A,&ba);CHKERRQ(ierr);
+	} else {
+		ierr = MatSeqAIJGetArrayRead(A,&va);CHKERRQ(ierr);
+		ierr = PetscArraycpy((PetscScalar*)(dst+oa),va,h[5]);CHKERRQ(ierr);
+		ierr = MatSeqAIJRestoreArrayRead(A,&va);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode ItemCreate(SharedMats s, PetscInt t, Mat *A, Vec *v)
+{
+	/*
+		Sequential matrix (or vector) on the arrays of the t-th item in the segment of its owner, NULL if none
+	*/
+
+	PetscErrorCode        ierr;
+	const PetscInt       *h = &s->head[SHARED_HEAD*t];
+	MPI_Aint              bytes;
+	PetscMPIInt           unit;
+	char                 *base;
+	PetscInt              nr;
+	size_t                oj, oa;
+
+	PetscFunctionBeginUser;
+
+	if (A) *A = NULL;
+	if (v) *v = NULL;
+	if (h[0] == SHARED_NONE) PetscFunctionReturn(0);
+
+	ierr = MPI_Win_shared_query(s->win,(PetscMPIInt)h[1],&bytes,&unit,&base);CHKERRMPI(ierr);
+	base += s->offset[t];
+	if (h[0] == SHARED_VEC) {
+		ierr = VecCreateSeqWithArray(PETSC_COMM_WORLD,h[4],h[2],(PetscScalar*)base,v);CHKERRQ(ierr);
+		PetscFunctionReturn(0);
+	}
+	nr = h[2]/h[4];
+	oj = SHARED_ALIGN((size_t)(nr+1)*sizeof(PetscInt));
+	oa = oj + SHARED_ALIGN((size_t)h[5]*sizeof(PetscInt));
+	if (h[0] == SHARED_BAIJ) {
+		ierr = MatCreateSeqBAIJWithArrays(PETSC_COMM_WORLD,h[4],h[2],h[3],(PetscInt*)base,(PetscInt*)(base+oj),(PetscScalar*)(base+oa),A);CHKERRQ(ierr);
+	} else {
+		ierr = MatCreateSeqAIJWithArrays(PETSC_COMM_WORLD,h[2],h[3],(PetscInt*)base,(PetscInt*)(base+oj),(PetscScalar*)(base+oa),A);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SharedMatsCreate(MPI_Comm world, RSVD_vars *RSVD, Weight_matrices *Weight, Directories *dirs, PetscInt lo, PetscInt hi, SharedMats *shm)
+{
+	/*
+		Loads the operators lo..hi of this rank (union over the node) and the weight matrices of every
+		configuration once per node into shared memory (collective on world, PETSC_COMM_WORLD being the
+		group of one rank). Sets RSVD->N
+	*/
+
+	PetscErrorCode        ierr;
+	SharedMats            s;
+	PetscInt              t, ic, b, N = 0, Nmin, Nmax, nmine, ntot;
+	Mat                  *mats;
+	Vec                  *vecs;
+	size_t                bytes = 0;
+	MPI_Aint              total;
+	char                 *base, filename[PETSC_MAX_PATH_LEN];
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscNew(&s);CHKERRQ(ierr);
+	ierr = MPI_Comm_split_type(world,MPI_COMM_TYPE_SHARED,0,MPI_INFO_NULL,&s->node);CHKERRMPI(ierr);
+	ierr = MPI_Comm_rank(s->node,&s->rank);CHKERRMPI(ierr);
+	ierr = MPI_Comm_size(s->node,&s->size);CHKERRMPI(ierr);
+
+	/*
+		Operators of the node, shared unless they outnumber its ranks
+	*/
+
+	if (hi < lo) {
+		lo = PETSC_MAX_INT;
+		hi = -1;
+	}
+	ierr    = MPI_Allreduce(MPI_IN_PLACE,&lo,1,MPIU_INT,MPI_MIN,s->node);CHKERRMPI(ierr);
+	ierr    = MPI_Allreduce(MPI_IN_PLACE,&hi,1,MPIU_INT,MPI_MAX,s->node);CHKERRMPI(ierr);
+	s->oplo = lo;
+	s->nops = hi >= lo ? hi - lo + 1 : 0;
+	if (s->nops > s->size) {
+		ierr    = PetscPrintf(world,"Warning: a node processes %d operators with %d ranks, the operators are not shared\n", (int)s->nops, (int)s->size);CHKERRQ(ierr);
+		s->nops = 0;
+	}
+	s->nitems = s->nops + SHARED_WEIGHTS*RSVD->NumConfigs;
+	ierr = PetscCalloc1(SHARED_HEAD*s->nitems,&s->head);CHKERRQ(ierr);
+	ierr = PetscCalloc1(s->nitems,&s->offset);CHKERRQ(ierr);
+	ierr = PetscCalloc1(3*RSVD->NumConfigs,&s->sizes);CHKERRQ(ierr);
+	ierr = PetscCalloc2(s->nitems,&mats,s->nitems,&vecs);CHKERRQ(ierr);
+
+	for (t=s->rank; t<s->nops; t+=s->size) {
+		ierr = PetscSNPrintf(filename,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->OperatorList[s->oplo+t]);CHKERRQ(ierr);
+		ierr = LoadSparseMat(RSVD, filename, &mats[t]);CHKERRQ(ierr);
+		ierr = MatGetSize(mats[t],&N,NULL);CHKERRQ(ierr);
+	}
+	if (!s->nops && !s->rank && hi >= lo) {
+		ierr = PetscSNPrintf(filename,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,dirs->OperatorList[lo]);CHKERRQ(ierr);
+		ierr = LoadSparseMat(RSVD, filename, &mats[0]);CHKERRQ(ierr);
+		ierr = MatGetSize(mats[0],&N,NULL);CHKERRQ(ierr);
+		ierr = MatDestroy(&mats[0]);CHKERRQ(ierr);
+	}
+	Nmin = N ? N : PETSC_MAX_INT;
+	ierr = MPI_Allreduce(MPI_IN_PLACE,&Nmin,1,MPIU_INT,MPI_MIN,s->node);CHKERRMPI(ierr);
+	ierr = MPI_Allreduce(&N,&Nmax,1,MPIU_INT,MPI_MAX,s->node);CHKERRMPI(ierr);
+	if (Nmax && Nmin != Nmax) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_USER,"The operators must have the same size (%d != %d)", (int)Nmin, (int)Nmax);
+	RSVD->N = Nmax;
+
+	/*
+		Weight and input/output matrices, read by the first rank of the node
+	*/
+
+	if (!s->rank && Nmax) {
+		for (ic=0; ic<RSVD->NumConfigs; ic++) {
+			ierr = ReadWeightMats(RSVD, &Weight[ic], dirs);CHKERRQ(ierr);
+			b    = s->nops + SHARED_WEIGHTS*ic;
+			mats[b]   = Weight[ic].W_f_sqrt_inv;
+			vecs[b]   = Weight[ic].w_f_sqrt_inv;
+			mats[b+1] = Weight[ic].InputMatrixFlg ? Weight[ic].B : NULL;
+			mats[b+2] = Weight[ic].W_q_sqrt_inv;
+			vecs[b+2] = Weight[ic].w_q_sqrt_inv;
+			mats[b+3] = Weight[ic].W_q_sqrt;
+			vecs[b+3] = Weight[ic].w_q_sqrt;
+			mats[b+4] = Weight[ic].OutputMatrixFlg ? Weight[ic].C : NULL;
+			s->sizes[3*ic]   = Weight[ic].Nb;
+			s->sizes[3*ic+1] = Weight[ic].Nc;
+			s->sizes[3*ic+2] = Weight[ic].AdjointFirst;
+		}
+	}
+	ierr = MPI_Bcast(s->sizes,3*RSVD->NumConfigs,MPIU_INT,0,s->node);CHKERRMPI(ierr);
+
+	/*
+		Segment of this rank, filled with its items, then the headers are summed over the node (one owner per item)
+	*/
+
+	for (t=0, nmine=0; t<s->nitems; t++) {
+		if (!mats[t] && !vecs[t]) continue;
+		ierr = ItemDescribe(mats[t], vecs[t], &s->head[SHARED_HEAD*t]);CHKERRQ(ierr);
+		s->head[SHARED_HEAD*t+1] = s->rank;
+		s->offset[t] = (MPI_Aint)bytes;
+		bytes += ItemBytes(&s->head[SHARED_HEAD*t]);
+		nmine++;
+	}
+	ierr = MPI_Win_allocate_shared((MPI_Aint)bytes,1,MPI_INFO_NULL,s->node,&base,&s->win);CHKERRMPI(ierr);
+	ierr = MPI_Win_lock_all(MPI_MODE_NOCHECK,s->win);CHKERRMPI(ierr);
+	for (t=0; t<s->nitems; t++) {
+		if (!mats[t] && !vecs[t]) continue;
+		ierr = ItemStore(mats[t], vecs[t], &s->head[SHARED_HEAD*t], base + s->offset[t]);CHKERRQ(ierr);
+	}
+	ierr = MPI_Win_sync(s->win);CHKERRMPI(ierr);
+	ierr = MPI_Allreduce(MPI_IN_PLACE,s->head,SHARED_HEAD*s->nitems,MPIU_INT,MPI_SUM,s->node);CHKERRMPI(ierr);
+	ierr = MPI_Allreduce(MPI_IN_PLACE,s->offset,(PetscMPIInt)s->nitems,MPI_AINT,MPI_SUM,s->node);CHKERRMPI(ierr);
+	ierr = MPI_Win_sync(s->win);CHKERRMPI(ierr);
+	ierr = MPI_Win_unlock_all(s->win);CHKERRMPI(ierr);
+
+	/*
+		The private copies are no longer needed (the weights are wrapped again by SharedMatsGetWeights())
+	*/
+
+	for (t=0; t<s->nitems; t++) {
+		ierr = MatDestroy(&mats[t]);CHKERRQ(ierr);
+		ierr = VecDestroy(&vecs[t]);CHKERRQ(ierr);
+	}
+	ierr = PetscFree2(mats,vecs);CHKERRQ(ierr);
+	for (ic=0; ic<RSVD->NumConfigs && !s->rank; ic++) {
+		Weight[ic].W_f_sqrt_inv = Weight[ic].W_q_sqrt_inv = Weight[ic].W_q_sqrt = NULL;
+		Weight[ic].w_f_sqrt_inv = Weight[ic].w_q_sqrt_inv = Weight[ic].w_q_sqrt = NULL;
+		if (Weight[ic].InputMatrixFlg) Weight[ic].B = NULL;
+		if (Weight[ic].OutputMatrixFlg) Weight[ic].C = NULL;
+	}
+
+	total = (MPI_Aint)bytes;
+	ntot  = nmine;
+	ierr  = MPI_Allreduce(MPI_IN_PLACE,&total,1,MPI_AINT,MPI_SUM,s->node);CHKERRMPI(ierr);
+	ierr  = MPI_Allreduce(MPI_IN_PLACE,&ntot,1,MPIU_INT,MPI_SUM,s->node);CHKERRMPI(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(world,"Shared read-only matrices: %d matrices (%d operators), %.1f MB per node for %d ranks\n\n",
+			(int)ntot, (int)s->nops, (double)total/1048576, (int)s->size);CHKERRQ(ierr);
+
+	*shm = s;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SharedMatsGetOperator(SharedMats s, PetscInt iop, Mat *A)
+{
+	/*
+		Sequential operator on the shared arrays, NULL if the iop-th operator is not shared
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	*A = NULL;
+	if (!s || iop < s->oplo || iop >= s->oplo + s->nops) PetscFunctionReturn(0);
+	ierr = ItemCreate(s, iop - s->oplo, A, NULL);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SharedMatsGetWeights(SharedMats s, RSVD_vars *RSVD, Weight_matrices *Weight, PetscInt ic)
+{
+	/*
+		Weight and input/output matrices of the ic-th configuration on the shared arrays (replaces ReadWeightMats)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              b = s->nops + SHARED_WEIGHTS*ic;
+
+	PetscFunctionBeginUser;
+
+	ierr = ItemCreate(s, b, &Weight->W_f_sqrt_inv, &Weight->w_f_sqrt_inv);CHKERRQ(ierr);
+	if (Weight->InputMatrixFlg) ierr = ItemCreate(s, b+1, &Weight->B, NULL);CHKERRQ(ierr);
+	ierr = ItemCreate(s, b+2, &Weight->W_q_sqrt_inv, &Weight->w_q_sqrt_inv);CHKERRQ(ierr);
+	ierr = ItemCreate(s, b+3, &Weight->W_q_sqrt, &Weight->w_q_sqrt);CHKERRQ(ierr);
+	if (Weight->OutputMatrixFlg) ierr = ItemCreate(s, b+4, &Weight->C, NULL);CHKERRQ(ierr);
+
+	Weight->Nb           = s->sizes[3*ic];
+	Weight->Nc           = s->sizes[3*ic+1];
+	Weight->AdjointFirst = (PetscBool) s->sizes[3*ic+2];
+	RSVD->Nb             = Weight->Nb;
+	RSVD->Nc             = Weight->Nc;
+	RSVD->AdjointFirst   = Weight->AdjointFirst;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SharedMatsDestroy(SharedMats *shm)
+{
+	/*
+		Frees the window (collective on the node), after every matrix on it was destroyed
+	*/
+
+	PetscErrorCode        ierr;
+	SharedMats            s = *shm;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	ierr = MPI_Win_free(&s->win);CHKERRMPI(ierr);
+	ierr = MPI_Comm_free(&s->node);CHKERRMPI(ierr);
+	ierr = PetscFree(s->head);CHKERRQ(ierr);
+	ierr = PetscFree(s->offset);CHKERRQ(ierr);
+	ierr = PetscFree(s->sizes);CHKERRQ(ierr);
+	ierr = PetscFree(*shm);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
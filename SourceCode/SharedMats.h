@@ -0,0 +1,10 @@
+
+#ifndef SHAREDMATS_H
+#define SHAREDMATS_H
+
+PetscErrorCode SharedMatsCreate(MPI_Comm, RSVD_vars*, Weight_matrices*, Directories*, PetscInt, PetscInt, SharedMats*);
+PetscErrorCode SharedMatsGetOperator(SharedMats, PetscInt, Mat*);
+PetscErrorCode SharedMatsGetWeights(SharedMats, RSVD_vars*, Weight_matrices*, PetscInt);
+PetscErrorCode SharedMatsDestroy(SharedMats*);
+
+#endif
\ No newline at end of file
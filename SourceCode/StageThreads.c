@@ -0,0 +1,54 @@
+
+#include <petscksp.h>
+#include <petscpkg_version.h>
+#include <Variables.h>
+#include <FactorCache.h>
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+PetscErrorCode SetStageThreads(RSVD_matrices *RSVDM, RSVD_vars *RSVD, PetscInt stage)
+{
+	/*
+		Sets the number of OpenMP threads per rank for the given stage (STAGE_LU, STAGE_SOLVE or STAGE_DENSE)
+		In the dense stage, the count applies to the OpenMP loops of ApplyWeightMats and, only if PETSc's
+		BLAS/LAPACK is OpenMP-threaded (OpenBLAS, MKL, ...), to the QR and SVDs (the sparse products are
+		sequential); for the LU and solve stages, MUMPS (>= 5.2) gets the count through ICNTL(16), either
+		in the PETSc factor or in the factor cache instance
+		RSVDM may be NULL for the dense stage
+	*/
+
+	PetscErrorCode        ierr;
+	PC                    pc;
+	Mat                   F;
+	MatSolverType         type;
+	PetscBool             set, islu, ismumps;
+
+	PetscFunctionBeginUser;
+
+#if defined(_OPENMP)
+	omp_set_num_threads((int)RSVD->Threads[stage]);
+#endif
+
+	if (stage == STAGE_DENSE || !RSVDM->ksp) PetscFunctionReturn(0);
+
+#if PETSC_PKG_MUMPS_VERSION_GE(5,2,0)
+	if (RSVDM->Cache) {
+		ierr = FactorCacheSetThreads(RSVDM->Cache, RSVD->Threads[stage]);CHKERRQ(ierr);
+	} else {
+		ierr = KSPGetOperatorsSet(RSVDM->ksp,NULL,&set);CHKERRQ(ierr);
+		ierr = KSPGetPC(RSVDM->ksp,&pc);CHKERRQ(ierr);
+		ierr = PetscObjectTypeCompare((PetscObject)pc,PCLU,&islu);CHKERRQ(ierr);
+		if (!set || !islu) PetscFunctionReturn(0);
+		ierr = PCFactorSetUpMatSolverType(pc);CHKERRQ(ierr);
+		ierr = PCFactorGetMatrix(pc,&F);CHKERRQ(ierr);
+		ierr = MatFactorGetSolverType(F,&type);CHKERRQ(ierr);
+		ierr = PetscStrcmp(type,MATSOLVERMUMPS,&ismumps);CHKERRQ(ierr);
+		if (ismumps) ierr = MatMumpsSetIcntl(F,16,RSVD->Threads[stage]);CHKERRQ(ierr);
+	}
+#endif
+
+	PetscFunctionReturn(0);
+
+}
+
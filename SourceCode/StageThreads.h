@@ -0,0 +1,7 @@
+
+#ifndef STAGETHREADS_H
+#define STAGETHREADS_H
+
+PetscErrorCode SetStageThreads(RSVD_matrices*, RSVD_vars*, PetscInt);
+
+#endif
\ No newline at end of file
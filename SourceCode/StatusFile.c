@@ -0,0 +1,208 @@
+
+#include <stdio.h>
+#include <time.h>
+#include <petscksp.h>
+#include <Variables.h>
+#include <SetupFreqGrid.h>
+
+#define STATUS_WINDOW 8                                   /* number of last occurrences in the mean stage times */
+
+/*
+	Status file of the frequency sweep (MainFolderDir/status.json)
+
+	Rewritten by the first rank after every stage of RSVDLU() as a small JSON object with the current
+	operator, frequency and stage, the number of completed frequencies, the mean time of every stage
+	over its last STATUS_WINDOW occurrences, the ETA extrapolated from the completed frequencies and the
+	current/peak memory of every rank. The file is written to status.json.tmp and renamed, so that a
+	reader (e.g., a workflow manager polling the results folder) never sees a partial file.
+*/
+
+struct _p_StatusFile {
+	char                  file[PETSC_MAX_PATH_LEN];       /* status file */
+	char                  tmp[PETSC_MAX_PATH_LEN];        /* file written first, then renamed */
+	PetscInt              NumOps, Nw;                     /* number of operators and frequencies */
+	PetscInt              iop, iw;                        /* current operator and frequency */
+	PetscReal             w;                              /* current frequency */
+	PetscInt              stage;                          /* last completed stage (-1: frequency started) */
+	PetscInt              completed;                      /* completed frequencies (over all operators) */
+	PetscLogDouble        t0, tstage;                     /* start of the sweep and of the current stage */
+	PetscReal             times[NUM_STATUS][STATUS_WINDOW];
+	PetscInt              count[NUM_STATUS];
+	PetscMPIInt           rank, size;
+	PetscLogDouble       *mem;                            /* current and peak memory of every rank (first rank) */
+};
+
+static const char *StatusNames[NUM_STATUS] = {"LU", "FirstAction", "PowerIteration", "SVD4Response", "SecondAction", "SVD4Forcing", "ExactResolvent"};
+
+static PetscErrorCode StatusFileWrite(StatusFile s, const char *state)
+{
+	/*
+		Gathers the memory of every rank and rewrites the status file
+	*/
+
+	PetscErrorCode        ierr;
+	PetscLogDouble        mem[2], t, cur = 0, peak = 0;
+	PetscReal             mean, eta = -1;
+	PetscInt              is, j, n, total;
+	FILE                 *fp;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscMemoryGetCurrentUsage(&mem[0]);CHKERRQ(ierr);
+	ierr = PetscMemoryGetMaximumUsage(&mem[1]);CHKERRQ(ierr);
+	ierr = MPI_Gather(mem,2,MPI_DOUBLE,s->mem,2,MPI_DOUBLE,0,PETSC_COMM_WORLD);CHKERRMPI(ierr);
+	if (s->rank) PetscFunctionReturn(0);
+
+	ierr  = PetscTime(&t);CHKERRQ(ierr);
+	total = s->NumOps*s->Nw;
+	if (s->completed) eta = (t - s->t0)/s->completed*(total - s->completed);
+	for (j=0; j<s->size; j++) {
+		cur  = PetscMax(cur,s->mem[2*j]);
+		peak = PetscMax(peak,s->mem[2*j+1]);
+	}
+
+	fp = fopen(s->tmp,"w");
+	if (!fp) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_OPEN,"Cannot write the status file %s", s->tmp);
+	fprintf(fp,"{\n  \"state\": \"%s\",\n  \"stage\": \"%s\",\n", state, s->stage < 0 ? "Start" : StatusNames[s->stage]);
+	fprintf(fp,"  \"operator\": %d,\n  \"num_operators\": %d,\n  \"iw\": %d,\n  \"Nw\": %d,\n  \"w\": %.10g,\n",
+			(int)s->iop+1, (int)s->NumOps, (int)s->iw+1, (int)s->Nw, (double)s->w);
+	fprintf(fp,"  \"completed\": %d,\n  \"total\": %d,\n  \"elapsed_s\": %.3f,\n  \"eta_s\": %.3f,\n",
+			(int)s->completed, (int)total, t - s->t0, (double)eta);
+	fprintf(fp,"  \"stage_mean_s\": {");
+	for (is=0; is<NUM_STATUS; is++) {
+		n    = PetscMin(s->count[is],STATUS_WINDOW);
+		mean = 0;
+		for (j=0; j<n; j++) mean += s->times[is][j]/n;
+		if (n) fprintf(fp,"\"%s\": %.4f%s", StatusNames[is], (double)mean, ", ");
+	}
+	fprintf(fp,"\"window\": %d},\n", STATUS_WINDOW);
+	fprintf(fp,"  \"memory_mb\": {\"current_max\": %.1f, \"peak_max\": %.1f, \"ranks\": [", cur/1048576, peak/1048576);
+	for (j=0; j<s->size; j++) fprintf(fp,"[%.1f, %.1f]%s", s->mem[2*j]/1048576, s->mem[2*j+1]/1048576, j < s->size-1 ? ", " : "");
+	fprintf(fp,"]},\n  \"time\": %ld\n}\n", (long)time(NULL));
+	fclose(fp);
+	if (rename(s->tmp,s->file)) SETERRQ(PETSC_COMM_SELF,PETSC_ERR_FILE_WRITE,"Cannot rename %s to %s", s->tmp, s->file);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode StatusFileCreate(RSVD_vars *RSVD, Directories *dirs, StatusFile *status)
+{
+	/*
+		Creates the status file of the sweep (NumOps x Nw frequencies, or the ones left by the screening)
+		The peak memory is tracked from here on (PetscMemorySetGetMaximumUsage)
+	*/
+
+	PetscErrorCode        ierr;
+	StatusFile            s;
+	PetscInt              j;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscNew(&s);CHKERRQ(ierr);
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&s->rank);CHKERRMPI(ierr);
+	ierr = MPI_Comm_size(PETSC_COMM_WORLD,&s->size);CHKERRMPI(ierr);
+	if (!s->rank) ierr = PetscMalloc1(2*s->size,&s->mem);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(s->file,PETSC_MAX_PATH_LEN,"%sstatus.json",dirs->MainFolderDir);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(s->tmp,PETSC_MAX_PATH_LEN,"%s.tmp",s->file);CHKERRQ(ierr);
+	ierr = PetscMemorySetGetMaximumUsage();CHKERRQ(ierr);
+	ierr = PetscTime(&s->t0);CHKERRQ(ierr);
+	s->NumOps = RSVD->NumOps;
+	s->Nw     = RSVD->Nw;
+	if (RSVD->Screen.Full) {
+		for (j=0, s->Nw=0; j<RSVD->Nw; j++) s->Nw += RSVD->Screen.Full[j];
+	}
+	s->stage  = -1;
+	s->tstage = s->t0;
+
+	ierr = StatusFileWrite(s, "running");CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Status file: %s\n\n", s->file);CHKERRQ(ierr);
+
+	*status = s;
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode StatusFileBegin(StatusFile s, RSVD_vars *RSVD, PetscInt iop, PetscInt iw)
+{
+	/*
+		Starts the iw-th frequency of the iop-th operator
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	s->iop   = iop;
+	s->iw    = iw;
+	s->stage = -1;
+	ierr = GetFrequency(RSVD, iw, &s->w);CHKERRQ(ierr);
+	ierr = PetscTime(&s->tstage);CHKERRQ(ierr);
+	ierr = StatusFileWrite(s, "running");CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode StatusFileStage(StatusFile s, PetscInt stage)
+{
+	/*
+		Records the time of a completed stage (since the previous one) and rewrites the status file
+	*/
+
+	PetscErrorCode        ierr;
+	PetscLogDouble        t;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	ierr = PetscTime(&t);CHKERRQ(ierr);
+	s->times[stage][s->count[stage]%STATUS_WINDOW] = t - s->tstage;
+	s->count[stage]++;
+	s->stage  = stage;
+	s->tstage = t;
+	ierr = StatusFileWrite(s, "running");CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode StatusFileEnd(StatusFile s)
+{
+	/*
+		Completes the current frequency
+	*/
+
+	PetscErrorCode        ierr;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	s->completed++;
+	ierr = StatusFileWrite(s, "running");CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode StatusFileDestroy(StatusFile *status)
+{
+	/*
+		Marks the sweep as done and frees the status
+	*/
+
+	PetscErrorCode        ierr;
+	StatusFile            s = *status;
+
+	PetscFunctionBeginUser;
+
+	if (!s) PetscFunctionReturn(0);
+	ierr = StatusFileWrite(s, "done");CHKERRQ(ierr);
+	ierr = PetscFree(s->mem);CHKERRQ(ierr);
+	ierr = PetscFree(*status);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
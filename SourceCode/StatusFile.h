@@ -0,0 +1,11 @@
+
+#ifndef STATUSFILE_H
+#define STATUSFILE_H
+
+PetscErrorCode StatusFileCreate(RSVD_vars*, Directories*, StatusFile*);
+PetscErrorCode StatusFileBegin(StatusFile, RSVD_vars*, PetscInt, PetscInt);
+PetscErrorCode StatusFileStage(StatusFile, PetscInt);
+PetscErrorCode StatusFileEnd(StatusFile);
+PetscErrorCode StatusFileDestroy(StatusFile*);
+
+#endif
\ No newline at end of file
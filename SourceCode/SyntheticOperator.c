@@ -0,0 +1,264 @@
+
+#include <string.h>
+#include <petscksp.h>
+#include <Variables.h>
+
+static PetscErrorCode SyntheticSizes(RSVD_vars *RSVD, PetscInt *nv, PetscInt *nxb, PetscReal *vol)
+{
+	/*
+		Components per grid point, number of grid points in x of the input region (upstream half, the
+		output region being the downstream half) and cell volume of the synthetic operator
+	*/
+
+	PetscInt             *g = RSVD->Bench.Grid;
+
+	PetscFunctionBeginUser;
+
+	*nv  = RSVD->BlockSize > 1 ? RSVD->BlockSize : 1;
+	*nxb = (g[0]+1)/2;
+	*vol = 1./((g[0]+1)*(g[1]+1)*(RSVD->Bench.NumGrid == 3 ? g[2]+1 : 1));
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SyntheticPath(Directories *dirs, char *path)
+{
+	/*
+		Moves a generated file (path relative to RootDir, as given in the input) into BenchDir, creates its
+		folder and sets IO_dir to its full path, so that the user's operator and matrices are never overwritten
+	*/
+
+	PetscErrorCode        ierr;
+	PetscMPIInt           rank;
+	char                  rel[PETSC_MAX_PATH_LEN], *slash;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscSNPrintf(rel,PETSC_MAX_PATH_LEN,"%s%s",dirs->BenchDir,path);CHKERRQ(ierr);
+	ierr = PetscStrncpy(path,rel,PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+	ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s",dirs->RootDir,rel);CHKERRQ(ierr);
+
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
+	if (!rank) {
+		ierr = PetscSNPrintf(rel,PETSC_MAX_PATH_LEN,"mkdir -p %s",dirs->IO_dir);CHKERRQ(ierr);
+		slash = strrchr(rel,'/');
+		if (slash) *slash = 0;
+		ierr = system(rel);CHKERRQ(ierr);
+	}
+	ierr = MPI_Barrier(PETSC_COMM_WORLD);CHKERRMPI(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SaveSyntheticMat(Mat M, const char *filename)
+{
+	/*
+		Assembles and saves a matrix in binary format (with the .info file holding its block size)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscViewer           fd;
+
+	PetscFunctionBeginUser;
+
+	ierr = MatAssemblyBegin(M,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = MatAssemblyEnd(M,MAT_FINAL_ASSEMBLY);CHKERRQ(ierr);
+	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
+	ierr = MatView(M,fd);CHKERRQ(ierr);
+	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+static PetscErrorCode SaveSyntheticVec(PetscInt n, PetscInt nv, PetscScalar value, const char *filename)
+{
+	/*
+		Saves a constant vector of size n (the diagonal of a weight) in binary format
+	*/
+
+	PetscErrorCode        ierr;
+	Vec                   v;
+	PetscViewer           fd;
+
+	PetscFunctionBeginUser;
+
+	ierr = VecCreate(PETSC_COMM_WORLD,&v);CHKERRQ(ierr);
+	ierr = VecSetSizes(v,PETSC_DECIDE,n);CHKERRQ(ierr);
+	if (n % nv == 0) ierr = VecSetBlockSize(v,nv);CHKERRQ(ierr);
+	ierr = VecSetUp(v);CHKERRQ(ierr);
+	ierr = VecSet(v,value);CHKERRQ(ierr);
+	ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
+	ierr = VecView(v,fd);CHKERRQ(ierr);
+	ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+	ierr = VecDestroy(&v);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SyntheticOperator(RSVD_vars *RSVD, Directories *dirs)
+{
+	/*
+		Generates a synthetic operator of any size for benchmarking and saves it to OperatorDir within BenchDir,
+		i.e., Synthetic/ in the results folder (OperatorList[0] then points to it)
+		Convection-diffusion on the unit square (cube) with a grid of nx x ny (x nz) interior points,
+		homogeneous Dirichlet boundaries, second-order diffusion (1/Pe) and first-order upwind convection
+		with unit velocity along x, i.e., a streamwise-developing flow with the stencil of a 2D (3D) solver
+		With BlockSize > 1, every grid point holds BlockSize components, each component c being forced by
+		the component c+1 at the same point (lift-up-like coupling), which makes the operator non-normal
+		as in channel flows; the grid points are numbered with x fastest, the components being contiguous
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt             *g = RSVD->Bench.Grid;
+	PetscInt              nv, nxb, N, row, node, c, i, j, l, rstart, rend, ncols, cols[8];
+	PetscReal             vol, nu, hx, hy, hz;
+	PetscScalar           vals[8];
+	PetscLogDouble        t1, t2;
+	size_t                len;
+	char                  path[PETSC_MAX_PATH_LEN];
+	Mat                   A;
+
+	PetscFunctionBeginUser;
+
+	ierr = PetscTime(&t1);CHKERRQ(ierr);
+	ierr = SyntheticSizes(RSVD, &nv, &nxb, &vol);CHKERRQ(ierr);
+	N    = g[0]*g[1]*g[2]*nv;
+	nu   = 1./RSVD->Bench.Peclet;
+	hx   = 1./(g[0]+1);
+	hy   = 1./(g[1]+1);
+	hz   = 1./(g[2]+1);
+
+	ierr = MatCreate(PETSC_COMM_WORLD,&A);CHKERRQ(ierr);
+	ierr = MatSetType(A,MATAIJ);CHKERRQ(ierr);
+	ierr = MatSetSizes(A,PETSC_DECIDE,PETSC_DECIDE,N,N);CHKERRQ(ierr);
+	ierr = MatSetBlockSize(A,nv);CHKERRQ(ierr);
+	ierr = MatSeqAIJSetPreallocation(A,8,NULL);CHKERRQ(ierr);
+	ierr = MatMPIAIJSetPreallocation(A,8,NULL,8,NULL);CHKERRQ(ierr);
+	ierr = MatGetOwnershipRange(A,&rstart,&rend);CHKERRQ(ierr);
+
+	for (row=rstart; row<rend; row++) {
+		c     = row % nv;
+		node  = row / nv;
+		i     = node % g[0];
+		j     = (node / g[0]) % g[1];
+		l     = node / (g[0]*g[1]);
+		ncols = 0;
+		cols[ncols] = row;
+		vals[ncols++] = -2*nu/(hx*hx) - 2*nu/(hy*hy) - (RSVD->Bench.NumGrid == 3 ? 2*nu/(hz*hz) : 0) - 1./hx;
+		if (i > 0)         {cols[ncols] = row - nv;           vals[ncols++] = nu/(hx*hx) + 1./hx;}
+		if (i < g[0]-1)    {cols[ncols] = row + nv;           vals[ncols++] = nu/(hx*hx);}
+		if (j > 0)         {cols[ncols] = row - nv*g[0];      vals[ncols++] = nu/(hy*hy);}
+		if (j < g[1]-1)    {cols[ncols] = row + nv*g[0];      vals[ncols++] = nu/(hy*hy);}
+		if (l > 0)         {cols[ncols] = row - nv*g[0]*g[1]; vals[ncols++] = nu/(hz*hz);}
+		if (l < g[2]-1)    {cols[ncols] = row + nv*g[0]*g[1]; vals[ncols++] = nu/(hz*hz);}
+		if (c < nv-1)      {cols[ncols] = row + 1;            vals[ncols++] = 1.;}
+		ierr = MatSetValues(A,1,&row,ncols,cols,vals,INSERT_VALUES);CHKERRQ(ierr);
+	}
+
+	ierr = PetscStrlen(dirs->RootDir,&len);CHKERRQ(ierr);
+	ierr = PetscSNPrintf(dirs->BenchDir,PETSC_MAX_PATH_LEN,"%sSynthetic/",dirs->MainFolderDir+len);CHKERRQ(ierr);
+	ierr = PetscStrncpy(path,dirs->OperatorList[0],PETSC_MAX_PATH_LEN);CHKERRQ(ierr);
+	ierr = SyntheticPath(dirs, path);CHKERRQ(ierr);
+	ierr = PetscFree(dirs->OperatorList[0]);CHKERRQ(ierr);
+	ierr = PetscStrallocpy(path,&dirs->OperatorList[0]);CHKERRQ(ierr);
+	ierr = SaveSyntheticMat(A, dirs->IO_dir);CHKERRQ(ierr);
+	ierr = MatDestroy(&A);CHKERRQ(ierr);
+
+	ierr = PetscTime(&t2);CHKERRQ(ierr);
+	if (RSVD->Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Synthetic %dD convection-diffusion operator (%d x %d x %d points, %d components, Pe = %g, N = %d) saved to %s (%g s)\n",
+			(int)RSVD->Bench.NumGrid, (int)g[0], (int)g[1], (int)g[2], (int)nv, RSVD->Bench.Peclet, (int)N, dirs->IO_dir, t2-t1);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
+PetscErrorCode SyntheticWeights(RSVD_vars *RSVD, Weight_matrices *Weight, Directories *dirs)
+{
+	/*
+		Generates the input/output matrices and weights requested by the flags of a configuration for the
+		synthetic operator and saves them to their directories within BenchDir (before they are read by ReadWeightMats())
+		B (N x Nb) restricts the forcing to the upstream half of the domain and C (Nc x N) observes the
+		downstream half; the weights are the square root of the cell volume (diagonal, saved as vectors)
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt             *g = RSVD->Bench.Grid;
+	PetscInt              nv, nxb, N, Nb, Nc, row, col, node, c, i, jl, rstart, rend;
+	PetscReal             vol;
+	Mat                   M;
+
+	PetscFunctionBeginUser;
+
+	ierr = SyntheticSizes(RSVD, &nv, &nxb, &vol);CHKERRQ(ierr);
+	N    = RSVD->N;
+	Nb   = Weight->InputMatrixFlg ? nxb*g[1]*g[2]*nv : N;
+	Nc   = Weight->OutputMatrixFlg ? (g[0]-nxb)*g[1]*g[2]*nv : N;
+	if (Nc == 0) SETERRQ(PETSC_COMM_WORLD,PETSC_ERR_USER,"The synthetic output matrix requires at least 2 points along x");
+
+	if (Weight->InputMatrixFlg) {
+		ierr = MatCreate(PETSC_COMM_WORLD,&M);CHKERRQ(ierr);
+		ierr = MatSetType(M,MATAIJ);CHKERRQ(ierr);
+		ierr = MatSetSizes(M,PETSC_DECIDE,PETSC_DECIDE,N,Nb);CHKERRQ(ierr);
+		ierr = MatSetBlockSizes(M,nv,nv);CHKERRQ(ierr);
+		ierr = MatSeqAIJSetPreallocation(M,1,NULL);CHKERRQ(ierr);
+		ierr = MatMPIAIJSetPreallocation(M,1,NULL,1,NULL);CHKERRQ(ierr);
+		ierr = MatSetOption(M,MAT_NEW_NONZERO_ALLOCATION_ERR,PETSC_FALSE);CHKERRQ(ierr);
+		ierr = MatGetOwnershipRange(M,&rstart,&rend);CHKERRQ(ierr);
+		for (row=rstart; row<rend; row++) {
+			c    = row % nv;
+			node = row / nv;
+			i    = node % g[0];
+			jl   = node / g[0];
+			if (i >= nxb) continue;
+			col  = (jl*nxb + i)*nv + c;
+			ierr = MatSetValue(M,row,col,1.,INSERT_VALUES);CHKERRQ(ierr);
+		}
+		ierr = SyntheticPath(dirs, Weight->InputMatrixDir);CHKERRQ(ierr);
+		ierr = SaveSyntheticMat(M, dirs->IO_dir);CHKERRQ(ierr);
+		ierr = MatDestroy(&M);CHKERRQ(ierr);
+	}
+
+	if (Weight->OutputMatrixFlg) {
+		ierr = MatCreate(PETSC_COMM_WORLD,&M);CHKERRQ(ierr);
+		ierr = MatSetType(M,MATAIJ);CHKERRQ(ierr);
+		ierr = MatSetSizes(M,PETSC_DECIDE,PETSC_DECIDE,Nc,N);CHKERRQ(ierr);
+		ierr = MatSetBlockSizes(M,nv,nv);CHKERRQ(ierr);
+		ierr = MatSeqAIJSetPreallocation(M,1,NULL);CHKERRQ(ierr);
+		ierr = MatMPIAIJSetPreallocation(M,1,NULL,1,NULL);CHKERRQ(ierr);
+		ierr = MatSetOption(M,MAT_NEW_NONZERO_ALLOCATION_ERR,PETSC_FALSE);CHKERRQ(ierr);
+		ierr = MatGetOwnershipRange(M,&rstart,&rend);CHKERRQ(ierr);
+		for (row=rstart; row<rend; row++) {
+			c    = row % nv;
+			node = row / nv;
+			i    = node % (g[0]-nxb);
+			jl   = node / (g[0]-nxb);
+			col  = (jl*g[0] + nxb + i)*nv + c;
+			ierr = MatSetValue(M,row,col,1.,INSERT_VALUES);CHKERRQ(ierr);
+		}
+		ierr = SyntheticPath(dirs, Weight->OutputMatrixDir);CHKERRQ(ierr);
+		ierr = SaveSyntheticMat(M, dirs->IO_dir);CHKERRQ(ierr);
+		ierr = MatDestroy(&M);CHKERRQ(ierr);
+	}
+
+	if (Weight->InvInputWeightFlg) {
+		ierr = SyntheticPath(dirs, Weight->InvInputWeightDir);CHKERRQ(ierr);
+		ierr = SaveSyntheticVec(Nb, nv, 1./PetscSqrtReal(vol), dirs->IO_dir);CHKERRQ(ierr);
+	}
+	if (Weight->OutputWeightFlg) {
+		ierr = SyntheticPath(dirs, Weight->OutputWeightDir);CHKERRQ(ierr);
+		ierr = SaveSyntheticVec(Nc, nv, PetscSqrtReal(vol), dirs->IO_dir);CHKERRQ(ierr);
+	}
+	if (Weight->InvOutputWeightFlg && Weight->InvOutputWeightDir[0]) {
+		ierr = SyntheticPath(dirs, Weight->InvOutputWeightDir);CHKERRQ(ierr);
+		ierr = SaveSyntheticVec(Nc, nv, 1./PetscSqrtReal(vol), dirs->IO_dir);CHKERRQ(ierr);
+	}
+
+	if (RSVD->Display && (Weight->InputMatrixFlg || Weight->OutputMatrixFlg || Weight->InvInputWeightFlg || Weight->OutputWeightFlg)) ierr = PetscPrintf(PETSC_COMM_WORLD,"Synthetic input/output matrices and weights saved (Nb = %d, Nc = %d)\n", (int)Nb, (int)Nc);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
@@ -0,0 +1,8 @@
+
+#ifndef SYNTHETICOPERATOR_H
+#define SYNTHETICOPERATOR_H
+
+PetscErrorCode SyntheticOperator(RSVD_vars*, Directories*);
+PetscErrorCode SyntheticWeights(RSVD_vars*, Weight_matrices*, Directories*);
+
+#endif
\ No newline at end of file
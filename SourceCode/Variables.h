@@ -2,32 +2,127 @@
 #ifndef VARIABLES_H
 #define VARIABLES_H
 
+#define MAX_NUM_OPS     1024                                    /* max number of operators in a parametric sweep */
+#define MAX_NUM_SAVED   1024                                    /* max number of frequencies listed in SaveModesList */
+#define MAX_NUM_CONFIGS 32                                      /* max number of input/output configurations */
+
+#define STAGE_LU        0                                       /* LU factorization (MUMPS) */
+#define STAGE_SOLVE     1                                       /* triangular solves of the direct/adjoint actions (MUMPS) */
+#define STAGE_DENSE     2                                       /* dense N x k kernels: weights, QR, SVDs */
+#define NUM_STAGES      3
+
+#define STATUS_LU              0                                /* stages reported in the status file */
+#define STATUS_FIRST_ACTION    1
+#define STATUS_POWER_ITERATION 2
+#define STATUS_SVD_RESPONSE    3
+#define STATUS_SECOND_ACTION   4
+#define STATUS_SVD_FORCING     5
+#define STATUS_EXACT           6
+#define NUM_STATUS             7
+
+#define SKETCH_GAUSSIAN   0                                     /* Gaussian test matrix */
+#define SKETCH_RADEMACHER 1                                     /* random signs */
+#define SKETCH_SPARSESIGN 2                                     /* sparse sign, min(k, 8) random signs per row */
+#define SKETCH_SRFT       3                                     /* subsampled randomized Fourier transform */
+
 typedef struct {
 	PetscBool       DiscFlg;                                /* discounting flag */
 	PetscReal       beta;                                   /* discounting parameter */
 } Discounting;
 
+typedef struct {
+	PetscBool       DryRun;                                 /* capacity planning only (no factorization) if true */
+	PetscInt        NumFreqs;                               /* number of sample frequencies analyzed */
+	PetscInt        RanksPerNode;                           /* MPI ranks per node */
+	PetscReal       NodeMem;                                /* memory per node in GB */
+	PetscReal       Gflops;                                 /* sustained rate per rank in Gflop/s */
+	PetscReal       Walltime;                               /* wall time per run in hours */
+} Planning;
+
+typedef struct {
+	PetscBool       Flg;                                    /* benchmarks the stages of the pipeline instead of the frequency sweep if true */
+	PetscInt        Grid[3];                                /* grid of the synthetic operator (nx, ny, nz; nz = 1 in 2D) */
+	PetscInt        NumGrid;                                /* 0: operator from OperatorDir, 2 or 3: synthetic operator saved to OperatorDir */
+	PetscReal       Peclet;                                 /* Peclet number of the synthetic convection-diffusion operator */
+	PetscInt        Reps;                                   /* repetitions of every stage */
+	PetscInt        ExactMaxN;                              /* max N for which the gains are checked against the exact resolvent */
+} Benchmarking;
+
+typedef struct {
+	PetscBool       Flg;                                    /* screens the frequency range with a reduced resolvent from eigenpairs of A if true */
+	PetscInt        Nev;                                    /* eigenpairs computed per shift */
+	PetscInt        Shifts;                                 /* number of shift-and-invert targets i w_s spread over [w_min, w_max] */
+	PetscInt        Refine;                                 /* screened frequencies per dw */
+	PetscReal       Factor;                                 /* min ratio of the estimated leading gain to the truncation bound */
+	PetscBool      *Full;                                   /* Nw flags: frequency left to RSVD-LU if true (NULL: all) */
+} Screening;
+
+typedef struct {
+	PetscBool       Flg;                                    /* solves windows of frequencies by multi-shift GMRES preconditioned by one LU if true */
+	PetscInt        Window;                                 /* frequencies per window, the LU is performed at its central frequency */
+	PetscReal       Tol;                                    /* relative tolerance of the preconditioned residual of every frequency */
+	PetscInt        MaxIt;                                  /* max dimension of the Krylov basis */
+} MultiShifting;
+
+typedef struct {
+	PetscBool       Flg;                                    /* runs the (operator, frequency) tasks on independent groups of ranks if true */
+	PetscInt        GroupSize;                              /* MPI ranks per group (1: sequential LU on every rank) */
+	PetscInt        DenseMaxN;                              /* max N of the dense LU (LAPACK) for groups of one rank (0: sparse LU only) */
+	PetscBool       Shared;                                 /* read-only matrices placed once per node in MPI-3 shared memory if true */
+} Batching;
+
 typedef struct {
 	PetscInt        N;                                      /* problem size (state dimension) */
 	PetscInt        Nb;                                     /* input size */
 	PetscInt        Nc;                                     /* output size */
 	PetscInt        k;                                      /* number of test vectors */
-	PetscInt        q;                                      /* number of power iterations */
+	PetscInt        q;                                      /* number of power iterations (max number if PowerTol > 0) */
+	PetscReal       PowerTol;                               /* relative change of the leading gains that stops the power iteration (0: q rounds) */
 	PetscInt        Nw;                                     /* number of input/output frequencies to resolve */
+	PetscInt        NumOps;                                 /* number of operators sharing the same nonzero pattern */
+	PetscInt        BlockSize;                              /* block size of the block CSR (MATMPIBAIJ) storage (1: CSR, 0: from the .info file) */
+	PetscInt        NumConfigs;                             /* number of input/output configurations sharing one factorization */
+	PetscBool       AdjointFirst;                           /* sketches from the output space (random Nc x k, adjoint action first) if Nc < Nb */
+	PetscInt        ExactOpt;                               /* 0: randomized, 1: exact resolvent if min(Nb, Nc) <= k(q+1), 2: exact resolvent */
 	PetscInt        RandSeed;                               /* seeding random number to replicate data if desired */
+	PetscInt        SketchOpt;                              /* test matrix (SKETCH_GAUSSIAN, SKETCH_RADEMACHER, SKETCH_SPARSESIGN, SKETCH_SRFT) */
 	PetscReal       w_min;                                  /* min frequency */
 	PetscReal       w_max;                                  /* max frequency */
 	PetscReal       dw;                                     /* frequency resolution */
+	PetscReal      *w_list;                                 /* Nw frequencies given through the library API (NULL: w_min:dw:w_max) */
 	PetscBool       TwoPI;                                  /* base frequency multiplies by 2*pi if true */
 	PetscBool       RealOperator;                           /* real-valued matrix if true, otherwise complex-valued */
 	Discounting     Disc;                                   /* discounting variables */
+	Planning        Plan;                                   /* capacity planner variables */
+	Benchmarking    Bench;                                  /* benchmark variables */
+	Batching        Batch;                                  /* batch mode variables */
+	Screening       Screen;                                 /* eigenvalue-based screening variables */
+	MultiShifting   MShift;                                 /* multi-shift Krylov variables */
 	PetscInt        Display;                                /* 0: None, 1: Partial, 2: Full progress display */
+	PetscBool       StatusFlg;                              /* keeps a status file (progress, ETA, memory) in the results folder if true */
+	PetscBool       InMemory;                               /* results only through the callbacks of the library API (no files) if true */
+	PetscBool       AsyncIO;                                /* saves the modes with a background writer if true */
+	PetscInt        IOBuffers;                              /* max number of mode matrices buffered per rank by the background writer */
+	PetscInt        SaveResultsOpt;                         /* 1: SaveModesNum matrices of size Nw x N, 2: Nw matrices of size N x k */
+	PetscInt        SaveModesNum;                           /* number of leading modes saved (<= k) */
+	PetscInt        SaveModesOpt;                           /* 0: gains only, 1: all frequencies, 2: listed frequencies, 3: leading gain peaks */
+	PetscInt        SaveModesList[MAX_NUM_SAVED];           /* frequency indices (1-based) whose modes are saved if SaveModesOpt = 2 */
+	PetscInt        NumSaveModesList;                       /* number of frequencies in SaveModesList */
+	PetscBool       SinglePrec;                             /* saves the modes in single precision if true */
+	PetscReal       CompressTol;                            /* error bound of the lossy mode compression relative to max |mode| (0: off) */
+	PetscInt        CompressBits;                           /* bits per quantized component (8, 16 or 32; 0: off) */
+	PetscReal       FactorCacheSize;                        /* max size of the LU factor cache in GB (0: unbounded) */
+	PetscBool       LowMemory;                              /* shifts A_org in place and frees the LU before the last SVD if true */
+	PetscInt        Threads[NUM_STAGES];                    /* OpenMP threads per rank of each stage (STAGE_LU, STAGE_SOLVE, STAGE_DENSE) */
 } RSVD_vars;
 
 typedef struct {
 	Mat             W_q_sqrt;                               /* output weight matrix */
 	Mat             W_q_sqrt_inv;                           /* inverse output weight matrix */
 	Mat             W_f_sqrt_inv;                           /* inverse input weight matrix */
+	Vec             w_q_sqrt;                               /* diagonal of W_q_sqrt if diagonal (replaces the matrix), otherwise NULL */
+	Vec             w_q_sqrt_inv;                           /* diagonal of W_q_sqrt_inv if diagonal (replaces the matrix), otherwise NULL */
+	Vec             w_f_sqrt_inv;                           /* diagonal of W_f_sqrt_inv if diagonal (replaces the matrix), otherwise NULL */
 	Mat             B;                                      /* input matrix */
 	Mat             C;                                      /* output matrix */
 	PetscBool       InvInputWeightFlg;                      /* inverse input weight matrix from the specified directory if true, otherwise identity matrix */
@@ -35,31 +130,65 @@ typedef struct {
 	PetscBool       InvOutputWeightFlg;                     /* inverse output weight matrix from the specified directory if true, otherwise identity matrix */
 	PetscBool       InputMatrixFlg;                         /* input matrix from the specified directory if true, otherwise identity matrix */
 	PetscBool       OutputMatrixFlg;                        /* output matrix from the specified directory if true, otherwise identity matrix */
+	PetscInt        Nb;                                     /* input size of this configuration */
+	PetscInt        Nc;                                     /* output size of this configuration */
+	PetscBool       AdjointFirst;                           /* sketch direction of this configuration */
+	char            InvInputWeightDir[PETSC_MAX_PATH_LEN];  /* inverse input weight directory of this configuration */
+	char            OutputWeightDir[PETSC_MAX_PATH_LEN];    /* output weight directory of this configuration */
+	char            InvOutputWeightDir[PETSC_MAX_PATH_LEN]; /* inverse output weight directory of this configuration */
+	char            InputMatrixDir[PETSC_MAX_PATH_LEN];     /* input matrix directory of this configuration */
+	char            OutputMatrixDir[PETSC_MAX_PATH_LEN];    /* output matrix directory of this configuration */
 } Weight_matrices;
 
+typedef struct _p_FactorCache *FactorCache;
+
+typedef struct _p_MultiShift *MultiShift;
+
+typedef struct _p_SharedMats *SharedMats;
+
 typedef struct {
 	Mat             A_org;                                  /* LNS operator */
+	Mat             A;                                      /* shifted operator (i w I - A_org), reused across frequencies */
+	KSP             ksp;                                    /* LU solver, symbolic factorization reused across frequencies/operators */
+	FactorCache     Cache;                                  /* LU factors saved to/restored from disk (NULL if not used) */
+	MultiShift      MS;                                     /* multi-shift solver of the current window of frequencies (NULL if not used) */
+	SharedMats      Shared;                                 /* read-only matrices shared on the node in batch mode (NULL if not used) */
+	Vec             Diag;                                   /* diagonal of A_org while it is shifted in place (low-memory mode) */
 	Mat             Y_hat;                                  /* RSVD matrix */
 } RSVD_matrices;
 
+typedef struct _p_AsyncWriter *AsyncWriter;
+
+typedef struct _p_StatusFile *StatusFile;
+
 typedef struct {
 	Mat             U_hat;                                  /* response resolvent modes */
 	Mat             V_hat;                                  /* forcing resolvent modes */
 	Vec             S_hat;                                  /* resolvent gains */
+	AsyncWriter     Writer;                                 /* background writer of the modes */
+	StatusFile      Status;                                 /* status file of the frequency sweep (NULL if not kept) */
+	Mat             U_peak;                                 /* weighted response modes kept for the peak test */
+	Mat             V_peak;                                 /* weighted forcing modes kept for the peak test */
+	PetscReal       Gain;                                   /* leading gain of the current frequency */
+	PetscReal       GainPrev;                               /* leading gain of the previous frequency */
+	PetscErrorCode (*GainsFn)(PetscInt, PetscReal, Vec, void*);            /* called with the gains of every frequency (library API) */
+	PetscErrorCode (*ModesFn)(PetscInt, PetscReal, PetscBool, Mat, void*); /* called with every saved block of modes (library API) */
+	void           *MonitorCtx;                             /* context of GainsFn and ModesFn */
 } Resolvent_matrices;
 
 typedef struct {
 	char            RootDir[PETSC_MAX_PATH_LEN];            /* root directory */
 	char            ResultsDir[PETSC_MAX_PATH_LEN];         /* results folder */
 	char            OperatorDir[PETSC_MAX_PATH_LEN];        /* LNS operator directory */
+	char           *OperatorList[MAX_NUM_OPS];              /* LNS operator directories (parametric sweep) */
+	char            FactorCacheDir[PETSC_MAX_PATH_LEN];     /* LU factor cache directory (empty if not used) */
+	char            BenchCSV[PETSC_MAX_PATH_LEN];           /* benchmark results file (CSV, rows appended by every run) */
+	char            BenchDir[PETSC_MAX_PATH_LEN];           /* folder of the synthetic operator and matrices (relative to RootDir) */
+	char           *ConfigList[MAX_NUM_CONFIGS];            /* names of the input/output configurations (NULL for a single unnamed one) */
 	char            filename[PETSC_MAX_PATH_LEN];           /* filename */
 	char            IO_dir[PETSC_MAX_PATH_LEN];             /* I/O directory */
 	char            FolderDir[PETSC_MAX_PATH_LEN];          /* results folder directory */
-	char            InvInputWeightDir[PETSC_MAX_PATH_LEN];  /* inverse input weight directory */ 
-	char            OutputWeightDir[PETSC_MAX_PATH_LEN];    /* output weight directory */ 
-	char            InvOutputWeightDir[PETSC_MAX_PATH_LEN]; /* inverse output weight directory */
-	char            InputMatrixDir[PETSC_MAX_PATH_LEN];     /* input matrix directory */
-	char            OutputMatrixDir[PETSC_MAX_PATH_LEN];    /* output matrix directory */
+	char            MainFolderDir[PETSC_MAX_PATH_LEN];      /* results folder directory of the entire run */
 } Directories;
 
 #endif
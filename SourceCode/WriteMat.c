@@ -0,0 +1,34 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+#include <AsyncWriter.h>
+
+PetscErrorCode WriteMat(RSVD_vars *RSVD, Resolvent_matrices *Res, Mat M, const char *filename)
+{
+	/*
+		Saves a dense matrix of modes in binary format
+		With AsyncIO, the local rows are handed off to the background writer and this returns immediately
+		Reduced-precision, compressed or truncated outputs always go through the writer; without AsyncIO
+		they are flushed before returning
+	*/
+
+	PetscErrorCode        ierr;
+	PetscViewer           fd;
+
+	PetscFunctionBeginUser;
+
+	if (RSVD->AsyncIO) {
+		ierr = AsyncWriterPush(Res->Writer, RSVD, M, filename);CHKERRQ(ierr);
+	} else if (Res->Writer) {
+		ierr = AsyncWriterPush(Res->Writer, RSVD, M, filename);CHKERRQ(ierr);
+		ierr = AsyncWriterFlush(Res->Writer, NULL);CHKERRQ(ierr);
+	} else {
+		ierr = PetscViewerBinaryOpen(PETSC_COMM_WORLD,filename,FILE_MODE_WRITE,&fd);CHKERRQ(ierr);
+		ierr = MatView(M,fd);CHKERRQ(ierr);
+		ierr = PetscViewerDestroy(&fd);CHKERRQ(ierr);
+	}
+
+	PetscFunctionReturn(0);
+
+}
+
@@ -0,0 +1,7 @@
+
+#ifndef WRITEMAT_H
+#define WRITEMAT_H
+
+PetscErrorCode WriteMat(RSVD_vars*, Resolvent_matrices*, Mat, const char*);
+
+#endif
\ No newline at end of file
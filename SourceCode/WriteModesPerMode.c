@@ -0,0 +1,71 @@
+
+#include <petscksp.h>
+#include <Variables.h>
+
+PetscErrorCode WriteModesPerMode(RSVD_vars *RSVD, Directories *dirs, Mat Y, PetscBool response, PetscInt iw)
+{
+	/*
+		Saves the modes of the iw-th frequency for SaveResultsOpt = 1, i.e., as SaveModesNum matrices
+		U_hat_k<j>_allW (V_hat_k<j>_allW) of size Nw x N in PETSc's native dense binary format
+		The matrices are frequency-major, so row iw of every file is one contiguous region, written in
+		place by a collective MPI-IO write of the contiguous local rows of every rank: only the current
+		frequency is held in memory, no other frequency is touched, and each mode is read back in one go
+	*/
+
+	PetscErrorCode        ierr;
+	PetscInt              N, rstart, rend, m, lda, j, hdr[4];
+	PetscMPIInt           rank;
+	const PetscScalar    *a;
+	PetscScalar          *col;
+	MPI_File              fh;
+	MPI_Offset            hbytes, disp;
+
+	PetscFunctionBeginUser;
+
+	ierr = MPI_Comm_rank(PETSC_COMM_WORLD,&rank);CHKERRMPI(ierr);
+	ierr = MatGetSize(Y,&N,NULL);CHKERRQ(ierr);
+	ierr = MatGetOwnershipRange(Y,&rstart,&rend);CHKERRQ(ierr);
+	ierr = MatDenseGetLDA(Y,&lda);CHKERRQ(ierr);
+	m      = rend - rstart;
+	hbytes = 4*sizeof(PetscInt);
+	disp   = hbytes + ((MPI_Offset)iw*N + rstart)*sizeof(PetscScalar);
+
+	hdr[0] = MAT_FILE_CLASSID;
+	hdr[1] = RSVD->Nw;
+	hdr[2] = N;
+	hdr[3] = -1;                                          /* MATRIX_BINARY_FORMAT_DENSE */
+#if !defined(PETSC_WORDS_BIGENDIAN)
+	ierr   = PetscByteSwap(hdr,PETSC_INT,4);CHKERRQ(ierr);
+#endif
+
+	ierr = PetscMalloc1(PetscMax(m,1),&col);CHKERRQ(ierr);
+	ierr = MatDenseGetArrayRead(Y,&a);CHKERRQ(ierr);
+
+	for (j=0; j<PetscMin(RSVD->SaveModesNum,RSVD->k); j++) {
+
+		ierr = PetscSNPrintf((char*)&dirs->IO_dir,PETSC_MAX_PATH_LEN,"%s%s%d%s",dirs->FolderDir,response ? "U_hat_k" : "V_hat_k",(int) j+1,"_allW");CHKERRQ(ierr);
+		ierr = MPI_File_open(PETSC_COMM_WORLD,dirs->IO_dir,MPI_MODE_CREATE | MPI_MODE_WRONLY,MPI_INFO_NULL,&fh);CHKERRMPI(ierr);
+		ierr = MPI_File_set_size(fh,hbytes + (MPI_Offset)N*RSVD->Nw*sizeof(PetscScalar));CHKERRMPI(ierr);
+		if (!rank) ierr = MPI_File_write_at(fh,0,hdr,4*sizeof(PetscInt),MPI_BYTE,MPI_STATUS_IGNORE);CHKERRMPI(ierr);
+
+		/*
+			Big-endian copy of the local part of mode j
+		*/
+
+		ierr = PetscArraycpy(col,a+j*lda,m);CHKERRQ(ierr);
+#if !defined(PETSC_WORDS_BIGENDIAN)
+		ierr = PetscByteSwap(col,PETSC_SCALAR,m);CHKERRQ(ierr);
+#endif
+
+		ierr = MPI_File_write_at_all(fh,disp,col,(int)m,MPIU_SCALAR,MPI_STATUS_IGNORE);CHKERRMPI(ierr);
+		ierr = MPI_File_close(&fh);CHKERRMPI(ierr);
+
+	}
+
+	ierr = MatDenseRestoreArrayRead(Y,&a);CHKERRQ(ierr);
+	ierr = PetscFree(col);CHKERRQ(ierr);
+
+	PetscFunctionReturn(0);
+
+}
+
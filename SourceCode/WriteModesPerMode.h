@@ -0,0 +1,7 @@
+
+#ifndef WRITEMODESPERMODE_H
+#define WRITEMODESPERMODE_H
+
+PetscErrorCode WriteModesPerMode(RSVD_vars*, Directories*, Mat, PetscBool, PetscInt);
+
+#endif
\ No newline at end of file
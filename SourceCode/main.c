@@ -22,6 +22,8 @@
 	W_f_sqrt_inv       W_f^(-1/2) as defined in the reference paper 1    matrix
 	k                  number of test vectors                            integer
 	q                  number of power iterations                        integer
+	PowerTol           stops the power iteration when the gains converge real >= 0
+	                   (q is then the max number of rounds, rounds used in PowerRounds_iw<int>.csv)
 	w_min              min frequency                                     real 
 	w_max              max frequency                                     real 
 	dw                 frequency reolution                               real > 0
@@ -30,18 +32,79 @@
 	ResultsDir         results directory (RootDir/ResultsDir)            string
 	beta               beta value for discounting (A <-- A - beta I)     real > 0
 	RandSeed           seeding random number                             integer
+	SketchOpt          random test matrix                                integer
+	    case 1) SketchOpt = 0: Gaussian
+	    case 2) SketchOpt = 1: Rademacher (random signs)
+	    case 3) SketchOpt = 2: sparse sign
+	    case 4) SketchOpt = 3: subsampled randomized Fourier transform
+	ExactOpt           exact (non-randomized) resolvent for small Nb/Nc  integer
+	    case 1) ExactOpt = 0: randomized only
+	    case 2) ExactOpt = 1: exact if min(Nb, Nc) <= k(q+1) (default)
+	    case 3) ExactOpt = 2: exact
 	DiscFlg            applies discounting for unstable linear systems   boolean
 	InputMatrixFlg     applies input matrix                              boolean 
 	OutputMatrixFlg    applies output matrix                             boolean 
+	OperatorList       operators with identical nonzero patterns         list of strings
+	                   (parametric sweep sharing one symbolic factorization, results in Operator<int>/)
+	BlockSize          block size of the block CSR storage (0: .info)    integer >= 0
+	ConfigList         names of input/output configurations (optional)   list of strings
+	                   (each reads its weight/input/output options from the block <name>, results in <name>/)
 	InputWeightFlg     applies input weight matrix                       boolean
 	InvInputWeightFlg  applies inverse input weight matrix               boolean 
 	InvOutputWeightFlg applies inverse output weight matrix              boolean 
+	DryRun             capacity planning only (MUMPS analysis)           boolean
+	PlanNumFreqs       number of sample frequencies of the dry run       integer
+	PlanRanksPerNode   MPI ranks per node for the recommendation         integer
+	PlanNodeMem        memory per node in GB for the recommendation      real > 0
+	PlanGflops         sustained rate per rank in Gflop/s                real > 0
+	PlanWalltime       wall time per run in hours                        real > 0
+	Benchmark          times the stages of the pipeline (CSV output)     boolean
+	BenchGrid          grid of the synthetic operator (nx,ny[,nz])       list of integers
+	                   (convection-diffusion operator, B/C/weights saved under Synthetic/ in the results folder)
+	BenchPeclet        Peclet number of the synthetic operator           real > 0
+	BenchReps          repetitions of every stage                        integer
+	BenchExactMaxN     max N of the check against the exact gains        integer >= 0
+	                   (leading SaveModesNum gains)
+	BenchCSV           benchmark results file (RootDir/ResultsDir)       string
+	Screening          screens the frequencies with eigenpairs of A      boolean
+	                   (RSVD-LU only where the reduced-resolvent estimate is unreliable, Screening.csv)
+	ScreenNev          eigenpairs computed per shift                     integer
+	ScreenShifts       number of shift-and-invert targets                integer
+	ScreenRefine       screened frequencies per dw                       integer
+	ScreenFactor       reliability factor of the screened gains          real > 0
+	MultiShift         multi-shift GMRES for windows of frequencies      boolean
+	                   (one LU at the central frequency of every window as preconditioner)
+	MultiShiftWindow   frequencies per window                            integer
+	MultiShiftTol      relative tolerance of every frequency             real > 0
+	MultiShiftMaxIt    max dimension of the Krylov basis                 integer
+	Batch              independent (operator, frequency) tasks per group boolean
+	BatchGroupSize     MPI ranks per group of the batch mode             integer
+	BatchDenseMaxN     max N of the dense LU on groups of one rank       integer >= 0
+	BatchShared        read-only matrices once per node (shared memory)  boolean
+	FactorCacheDir     LU factor cache directory (RootDir/FactorCacheDir) string
+	FactorCacheSize    max size of the LU factor cache in GB (0: no bound) real >= 0
+	LowMemory          lowers the memory high-water mark per frequency   boolean
+	ThreadsLU          OpenMP threads per rank of the LU factorization   integer
+	ThreadsSolve       OpenMP threads per rank of the solves             integer
+	ThreadsDense       OpenMP threads per rank of the dense kernels      integer
+	StatusFlg          keeps MainFolderDir/status.json (progress, ETA)   boolean
+	AsyncIO            saves the modes with a background writer thread   boolean
+	IOBuffers          max number of buffered mode matrices per rank     integer
+	SaveModesNum       number of leading modes saved (<= k)              integer
+	SaveModesOpt       frequencies whose modes are saved                 integer
+	    case 1) SaveModesOpt = 0: gains only
+	    case 2) SaveModesOpt = 1: all frequencies
+	    case 3) SaveModesOpt = 2: frequencies listed in SaveModesList (1-based indices)
+	    case 4) SaveModesOpt = 3: local maxima of the leading gain
+	SaveModesList      frequency indices for SaveModesOpt = 2            list of integers
+	SinglePrec         saves the modes in single precision               boolean
+	CompressTol        error bound of the lossy mode compression         real >= 0
 	Display            display options                                   integer
 	    case 1) Display = 0: nothing
 	    case 2) Display = 1: problem information + elapsed time of the LU decomposition at each frequency
 	    case 3) Display = 2: "Display = 1" information + elapsed time of solving LU-decomposed system for all test vectors
 	SaveResultsOpt     saving resolvent modes options                   integer
-	    case 1) SaveResultsOpt = 1: saves resolvent modes as k  matrices of size N x Nw
+	    case 1) SaveResultsOpt = 1: saves resolvent modes as k  matrices of size Nw x N
 	    case 2) SaveResultsOpt = 2: saves resolvent modes as Nw matrices of size N x k
 
 	List of outputs ** Description ************************************  Format
@@ -56,10 +119,21 @@
 	List of input libraries and functions
 */
 
+#include <petscksp.h>
 #include <slepcsys.h>
 #include <Variables.h>
 #include <PreProcessing.h>
+#include <LoadOperator.h>
 #include <RSVDLU.h>
+#include <AsyncWriter.h>
+#include <FactorCache.h>
+#include <CapacityPlanner.h>
+#include <ReadWeightMats.h>
+#include <Benchmark.h>
+#include <BatchSweep.h>
+#include <StatusFile.h>
+#include <ScreenFrequencies.h>
+#include <MultiShift.h>
 
 /* 	
 	Beginning of the simulation
@@ -75,11 +149,14 @@ int main(int argc,char **args)
 	PetscErrorCode        ierr;                             /* Petsc error code */
 	Directories           dirs;                             /* I/O directories */
 	RSVD_vars             RSVD;                             /* RSVD variables */
-	Weight_matrices       Weight;                           /* weight and input/output matrices */
+	Weight_matrices      *Weight;                           /* weight and input/output matrices of each configuration */
 	RSVD_matrices         RSVDM;                            /* RSVD matrices */
 	Resolvent_matrices    Res;                              /* resolvent modes and gains */
 	PetscLogDouble        t1, t2;                           /* timing variables */
 	PetscInt              hh, mm, ss;                       /* timing variables */
+	PetscInt              iop;                              /* operator index */
+	PetscInt              ic;                               /* configuration index */
+	PetscInt              nfiles;                           /* number of files saved by the background writer */
 
 	/*
 		Initializes the SLEPc
@@ -92,6 +169,26 @@ int main(int argc,char **args)
 	*/
 
 	ierr = PreProcessing(&RSVDM, &RSVD, &Weight, &dirs);CHKERRQ(ierr);
+
+	/*
+		Dry run: predicts the memory and time, then exits
+	*/
+
+	if (RSVD.Plan.DryRun) {
+		ierr = CapacityPlanner(&RSVDM, &RSVD, Weight);CHKERRQ(ierr);
+		ierr = MatDestroy(&RSVDM.A_org);CHKERRQ(ierr);
+		for (iop=0; iop<RSVD.NumOps; iop++) {
+			ierr = PetscFree(dirs.OperatorList[iop]);CHKERRQ(ierr);
+		}
+		for (ic=0; ic<RSVD.NumConfigs; ic++) {
+			ierr = DestroyWeightMats(&Weight[ic]);CHKERRQ(ierr);
+			ierr = PetscFree(dirs.ConfigList[ic]);CHKERRQ(ierr);
+		}
+		ierr = PetscFree(Weight);CHKERRQ(ierr);
+		ierr = PetscOptionsClear(NULL);CHKERRQ(ierr);
+		ierr = SlepcFinalize();
+		return ierr;
+	}
 	
 	/*************************************************************************
 		******************     RSVD - LU algorithm     *******************
@@ -102,13 +199,61 @@ int main(int argc,char **args)
 			"***************** RSVD-LU *****************\n*******************************************\n\n");CHKERRQ(ierr);
 
 	ierr = PetscTime(&t1);CHKERRQ(ierr);
+
+	Res.Writer = NULL;
+	Res.U_peak = NULL;
+	Res.V_peak = NULL;
+	Res.GainsFn = NULL;
+	Res.ModesFn = NULL;
+	Res.Status  = NULL;
+	if (RSVD.SaveResultsOpt == 2 && (RSVD.AsyncIO || RSVD.SinglePrec || RSVD.CompressBits || RSVD.SaveModesNum < RSVD.k)) {
+		ierr = AsyncWriterCreate(RSVD.IOBuffers, &Res.Writer);CHKERRQ(ierr);
+	}
 	
-	for (PetscInt iw=0; iw<RSVD.Nw; iw++) {
+	/*
+		Benchmark: times the stages of the pipeline at the first frequency instead of the sweep
+		Batch: shares out the (operator, frequency) tasks among independent groups of ranks
+	*/
+
+	if (RSVD.Bench.Flg) {
+		ierr = Benchmark(&RSVDM, &RSVD, Weight, &Res, &dirs);CHKERRQ(ierr);
+	} else if (RSVD.Batch.Flg) {
+		ierr = BatchSweep(&RSVDM, &RSVD, Weight, &Res, &dirs);CHKERRQ(ierr);
+	} else {
+		if (RSVD.Screen.Flg) ierr = ScreenFrequencies(&RSVDM, &RSVD, Weight, &Res, &dirs);CHKERRQ(ierr);
+		if (RSVD.StatusFlg) ierr = StatusFileCreate(&RSVD, &dirs, &Res.Status);CHKERRQ(ierr);
+		if (RSVD.MShift.Flg) ierr = MultiShiftCreate(&RSVD, &RSVDM.MS);CHKERRQ(ierr);
+
+		for (iop=0; iop<RSVD.NumOps; iop++) {
+
+			if (iop > 0) ierr = LoadOperator(&RSVDM, &RSVD, &dirs, iop);CHKERRQ(ierr);
 
-		ierr = RSVDLU(&RSVDM, &RSVD, &Weight, &Res, &dirs, iw);CHKERRQ(ierr);
+			for (PetscInt iw=0; iw<RSVD.Nw; iw++) {
 
+				if (RSVD.Screen.Full && !RSVD.Screen.Full[iw]) continue;
+				ierr = StatusFileBegin(Res.Status, &RSVD, iop, iw);CHKERRQ(ierr);
+				ierr = RSVDLU(&RSVDM, &RSVD, Weight, &Res, &dirs, iw);CHKERRQ(ierr);
+				ierr = StatusFileEnd(Res.Status);CHKERRQ(ierr);
+
+			}
+
+		}
+
+		ierr = StatusFileDestroy(&Res.Status);CHKERRQ(ierr);
+		ierr = MultiShiftDestroy(&RSVD, &RSVDM.MS);CHKERRQ(ierr);
+		ierr = PetscFree(RSVD.Screen.Full);CHKERRQ(ierr);
 	}
 
+	/*
+		Waits for the background writer and verifies the saved modes
+	*/
+
+	if (Res.Writer && RSVD.AsyncIO) {
+		ierr = AsyncWriterFlush(Res.Writer, &nfiles);CHKERRQ(ierr);
+		if (RSVD.Display) ierr = PetscPrintf(PETSC_COMM_WORLD,"Background writer: %d files written and verified\n\n",(int)nfiles);CHKERRQ(ierr);
+	}
+	ierr = AsyncWriterDestroy(&Res.Writer);CHKERRQ(ierr);
+
 	/*
 		Prints out the elapsed time and exits
 	*/
@@ -117,9 +262,22 @@ int main(int argc,char **args)
 	hh   = (t2-t1)/3600;
 	mm   = (t2-t1-3600*hh)/60;
 	ss   = t2-t1-3600*hh-mm*60;
-	ierr = PetscPrintf(PETSC_COMM_WORLD,"The results directory: %s\n\n",dirs.FolderDir);CHKERRQ(ierr);
+	ierr = PetscPrintf(PETSC_COMM_WORLD,"The results directory: %s\n\n",dirs.MainFolderDir);CHKERRQ(ierr);
 	ierr = PetscPrintf(PETSC_COMM_WORLD,"DONE :))\n\n*** Entire simulation elapsed time = %02d:%02d:%02d ***\n", (int)hh, (int)mm, (int)ss);CHKERRQ(ierr);
 
+	ierr = KSPDestroy(&RSVDM.ksp);CHKERRQ(ierr);
+	ierr = FactorCacheDestroy(&RSVDM.Cache);CHKERRQ(ierr);
+	ierr = MatDestroy(&RSVDM.A);CHKERRQ(ierr);
+	ierr = MatDestroy(&RSVDM.A_org);CHKERRQ(ierr);
+	ierr = VecDestroy(&RSVDM.Diag);CHKERRQ(ierr);
+	for (iop=0; iop<RSVD.NumOps; iop++) {
+		ierr = PetscFree(dirs.OperatorList[iop]);CHKERRQ(ierr);
+	}
+	for (ic=0; ic<RSVD.NumConfigs; ic++) {
+		ierr = PetscFree(dirs.ConfigList[ic]);CHKERRQ(ierr);
+	}
+	ierr = PetscFree(Weight);CHKERRQ(ierr);
+
 	ierr = PetscOptionsClear(NULL);CHKERRQ(ierr);
 	ierr = SlepcFinalize();
 	return ierr;
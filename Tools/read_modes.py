@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""
+Reader of the RSVD-LU mode files (U_hat_iw<int>_allK, V_hat_iw<int>_allK, ...)
+
+Reads the three formats written by RSVD-LU into a NumPy array of shape (N, r):
+- PETSc dense binary format {1211216, N, r, -1} (double precision, also readable by PetscBinaryRead)
+- single precision {1211290, N, r, 0}: N x r entries stored as floats
+- lossy compression {1211290, N, r, b}: r per-mode scales (double), then N x r entries stored as
+  b-bit integers q, with x = scale * q / (2^(b-1) - 1)
+All values are big-endian and row-major. The size of the header integers (4 or 8 bytes, PETSc built
+with 64-bit indices) and the scalar type (real or complex) are detected from the file.
+
+Usage:
+    python3 read_modes.py <file> [<output.npy>]
+or, from Python:
+    from read_modes import read_modes
+    U = read_modes('U_hat_iw1_allK')
+"""
+
+import os
+import sys
+
+import numpy as np
+
+MAT_FILE_CLASSID = 1211216
+MODE_FILE_CLASSID = 1211290
+
+
+def read_header(f):
+    """Returns the header (classid, N, r, b) and the size of its integers"""
+    raw = f.read(32)
+    for isize, dtype in ((4, '>i4'), (8, '>i8')):
+        hdr = np.frombuffer(raw[:4*isize], dtype=dtype)
+        if hdr[0] in (MAT_FILE_CLASSID, MODE_FILE_CLASSID):
+            return [int(h) for h in hdr], isize
+    raise ValueError('not a RSVD-LU mode file (unknown class id)')
+
+
+def read_modes(filename):
+    """Reads a mode file into an (N, r) array (complex if written by a complex build)"""
+    size = os.path.getsize(filename)
+    with open(filename, 'rb') as f:
+        (classid, N, r, b), isize = read_header(f)
+        f.seek(4*isize)
+        scale = None
+        if classid == MAT_FILE_CLASSID:
+            dtype = '>f8'
+        elif b == 0:
+            dtype = '>f4'
+        elif b in (8, 16, 32):
+            dtype = '>i%d' % (b//8)
+            scale = np.fromfile(f, dtype='>f8', count=r)
+        else:
+            raise ValueError('unsupported number of bits: %d' % b)
+        es = np.dtype(dtype).itemsize
+        nvals = N*r
+        nc = (size - f.tell())//(nvals*es) if nvals else 1
+        if nc not in (1, 2):
+            raise ValueError('file size does not match the header {%d, %d, %d, %d}' % (classid, N, r, b))
+        x = np.fromfile(f, dtype=dtype, count=nvals*nc).astype(np.float64)
+    if scale is not None:
+        x = x.reshape(N, r, nc)*(scale/float(2**(b-1) - 1))[None, :, None]
+    x = x.reshape(N, r, nc)
+    return x[..., 0] + 1j*x[..., 1] if nc == 2 else x[..., 0]
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__)
+    modes = read_modes(sys.argv[1])
+    print('%s: %d x %d %s modes' % (sys.argv[1], modes.shape[0], modes.shape[1], modes.dtype))
+    if len(sys.argv) == 3:
+        np.save(sys.argv[2], modes)
+
+
+if __name__ == '__main__':
+    main()